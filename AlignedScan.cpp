@@ -0,0 +1,192 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "AlignedScan.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace pacpus;
+using namespace std;
+
+/// Values of a plane filling kAlignment bytes
+static const std::size_t kAlignedValues = AlignedScan::kAlignment / sizeof(float);
+
+AlignedScan::AlignedScan()
+    : mBlock(NULL)
+    , mPlanes(NULL)
+    , mSize(0)
+    , mCapacity(0)
+{
+}
+
+AlignedScan::AlignedScan(AlignedScan const& other)
+    : mBlock(NULL)
+    , mPlanes(NULL)
+    , mSize(0)
+    , mCapacity(0)
+{
+    *this = other;
+}
+
+AlignedScan& AlignedScan::operator=(AlignedScan const& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+    resize(other.mSize);
+    for (int p = 0; p < SP_Count; ++p) {
+        memcpy(plane(static_cast<Plane>(p)), other.plane(static_cast<Plane>(p)), mSize * sizeof(float));
+    }
+    mLayers = other.mLayers;
+    return *this;
+}
+
+AlignedScan::~AlignedScan()
+{
+    free(mBlock);
+}
+
+void AlignedScan::resize(std::size_t pointCount)
+{
+    reserve(pointCount);
+    mLayers.clear();
+    mSize = pointCount;
+}
+
+void AlignedScan::reserve(std::size_t pointCount)
+{
+    if (pointCount <= mCapacity) {
+        return;
+    }
+    // some slack, consecutive sweeps differ by a few points
+    std::size_t capacity = pointCount + pointCount / 8;
+    capacity = (capacity + kAlignedValues - 1) / kAlignedValues * kAlignedValues;
+
+    free(mBlock);
+    mBlock = malloc(SP_Count * capacity * sizeof(float) + kAlignment - 1);
+    if (!mBlock) {
+        mPlanes = NULL;
+        mSize = 0;
+        mCapacity = 0;
+        throw bad_alloc();
+    }
+    std::size_t const address = reinterpret_cast<std::size_t>(mBlock);
+    mPlanes = static_cast<unsigned char*>(mBlock) + (kAlignment - address % kAlignment) % kAlignment;
+    mCapacity = capacity;
+}
+
+void AlignedScan::addLayer(int id, float angle, std::size_t begin, std::size_t end)
+{
+    Layer const layer = { id, angle, begin, end };
+    mLayers.push_back(layer);
+}
+
+LidarPoint AlignedScan::point(std::size_t i) const
+{
+    LidarPoint point;
+    point.x = x()[i];
+    point.y = y()[i];
+    point.z = z()[i];
+    point.intensity = intensity()[i];
+    return point;
+}
+
+AlignedScan::Buffer AlignedScan::buffer() const
+{
+    Buffer buffer;
+    buffer.data = mPlanes;
+    buffer.size = mSize ? ((SP_Count - 1) * planeBytes() + mSize * sizeof(float)) : 0;
+    for (int p = 0; p < SP_Count; ++p) {
+        buffer.offset[p] = p * planeBytes();
+    }
+    return buffer;
+}
+
+void AlignedScan::fromScan(LidarScan const& scan)
+{
+    std::size_t pointCount = 0;
+    for (std::size_t l = 0; l < scan.layers.size(); ++l) {
+        pointCount += scan.layers[l].points.size();
+    }
+    resize(pointCount);
+
+    float* x = this->x();
+    float* y = this->y();
+    float* z = this->z();
+    float* intensity = this->intensity();
+    boost::int32_t* layer = this->layer();
+    std::size_t i = 0;
+    for (std::size_t l = 0; l < scan.layers.size(); ++l) {
+        LidarLayer const& source = scan.layers[l];
+        std::size_t const begin = i;
+        for (std::size_t p = 0; p < source.points.size(); ++p, ++i) {
+            LidarPoint const& point = source.points[p];
+            x[i] = point.x;
+            y[i] = point.y;
+            z[i] = point.z;
+            intensity[i] = point.intensity;
+        }
+        fill(layer + begin, layer + i, source.id);
+        addLayer(source.id, source.angle, begin, i);
+    }
+}
+
+void AlignedScan::fromImage(VelodyneRangeImage const& image)
+{
+    // the cell after the last point is written too
+    std::size_t const pointCount = image.validCount();
+    reserve(pointCount + 1);
+    resize(pointCount);
+
+    float* x = this->x();
+    float* y = this->y();
+    float* z = this->z();
+    float* intensity = this->intensity();
+    boost::int32_t* layer = this->layer();
+    std::size_t i = 0;
+    for (int row = 0; row < image.rows(); ++row) {
+        float const* rowX = image.xRow(row);
+        float const* rowY = image.yRow(row);
+        float const* rowZ = image.zRow(row);
+        float const* rowIntensity = image.intensityRow(row);
+        unsigned char const* valid = image.validRow(row);
+        std::size_t const begin = i;
+        for (int col = 0; col < image.cols(); ++col) {
+            // always written, kept only when valid
+            x[i] = rowX[col];
+            y[i] = rowY[col];
+            z[i] = rowZ[col];
+            intensity[i] = rowIntensity[col];
+            i += valid[col];
+        }
+        fill(layer + begin, layer + i, row);
+        addLayer(row, image.rowAngle(row), begin, i);
+    }
+}
+
+int AlignedScan::toScan(LidarScan& scan) const
+{
+    int reallocations = 0;
+    scan.layers.resize(mLayers.size());
+    for (std::size_t l = 0; l < mLayers.size(); ++l) {
+        Layer const& source = mLayers[l];
+        LidarLayer& layer = scan.layers[l];
+        layer.id = source.id;
+        layer.angle = source.angle;
+
+        std::size_t const pointCount = source.end - source.begin;
+        if (layer.points.capacity() < pointCount) {
+            ++reallocations;
+        }
+        layer.points.resize(pointCount);
+        for (std::size_t p = 0; p < pointCount; ++p) {
+            layer.points[p] = point(source.begin + p);
+        }
+    }
+    return reallocations;
+}
@@ -0,0 +1,136 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief The points of a scan stored by planes: x, y, z, intensity and
+/// layer id each in its own array.
+///
+/// The planes are cut from a single block, each starting on a 64 byte
+/// boundary, so that loops over one field read contiguous aligned memory
+/// and the whole block can be uploaded to a vertex buffer as is (buffer()).
+/// The layers follow each other in the planes, the layer table gives the
+/// range of points of each one.
+///
+/// Like the range image, the storage only grows: refilling a recycled
+/// scan costs no allocation in steady state.
+
+#ifndef ALIGNEDSCAN_H
+#define ALIGNEDSCAN_H
+
+#include "VelodyneRangeImage.h"
+
+#include <structure/GenericLidar.h>
+
+#include <boost/cstdint.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace pacpus
+{
+
+class AlignedScan
+{
+public:
+    /// Alignment of each plane [bytes], a cache line
+    static const std::size_t kAlignment = 64;
+
+    enum Plane {
+        SP_X,
+        SP_Y,
+        SP_Z,
+        SP_Intensity,
+        SP_Layer,
+        SP_Count
+    };
+
+    struct Layer
+    {
+        int id;
+        /// elevation [rad], as LidarLayer::angle
+        float angle;
+        /// points [begin, end) of the planes
+        std::size_t begin, end;
+    };
+
+    /// The planes as one block, 4 bytes per value, for a vertex buffer
+    struct Buffer
+    {
+        void const* data;
+        /// bytes up to the end of the last plane
+        std::size_t size;
+        /// start of each plane in the block [bytes]
+        std::size_t offset[SP_Count];
+    };
+
+    AlignedScan();
+    AlignedScan(AlignedScan const& other);
+    AlignedScan& operator=(AlignedScan const& other);
+    ~AlignedScan();
+
+    /// Sizes the planes for a number of points and empties the layer table.
+    /// The values are undefined afterwards, the storage is kept if large enough.
+    void resize(std::size_t pointCount);
+    void clear() { resize(0); }
+    /// Grows the storage for a number of points, the values are then undefined
+    void reserve(std::size_t pointCount);
+
+    std::size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    /// Points the planes hold without reallocation
+    std::size_t capacity() const { return mCapacity; }
+
+    // whole planes
+    float* x() { return floatPlane(SP_X); }
+    float* y() { return floatPlane(SP_Y); }
+    float* z() { return floatPlane(SP_Z); }
+    float* intensity() { return floatPlane(SP_Intensity); }
+    /// LidarLayer::id of each point
+    boost::int32_t* layer() { return reinterpret_cast<boost::int32_t*>(plane(SP_Layer)); }
+    float const* x() const { return floatPlane(SP_X); }
+    float const* y() const { return floatPlane(SP_Y); }
+    float const* z() const { return floatPlane(SP_Z); }
+    float const* intensity() const { return floatPlane(SP_Intensity); }
+    boost::int32_t const* layer() const { return reinterpret_cast<boost::int32_t const*>(plane(SP_Layer)); }
+
+    std::vector<Layer> const& layers() const { return mLayers; }
+    /// Appends a layer made of the points [begin, end) of the planes,
+    /// following the last one
+    void addLayer(int id, float angle, std::size_t begin, std::size_t end);
+
+    LidarPoint point(std::size_t i) const;
+
+    /// Zero-copy view of the planes, valid until the next resize()
+    Buffer buffer() const;
+
+    /// Takes the points of a scan, layer after layer
+    void fromScan(LidarScan const& scan);
+    /// Takes the valid cells of a range image, one layer per row as
+    /// VelodyneRangeImage::toScan() does
+    void fromImage(VelodyneRangeImage const& image);
+
+    /// Fills a scan with the points, one LidarLayer per layer.
+    /// Layer vectors are cleared and reserved to their exact size, so a
+    /// recycled scan keeps its storage.
+    /// @returns the number of layer vectors that had to grow
+    int toScan(LidarScan& scan) const;
+
+private:
+    unsigned char* plane(Plane p) { return mPlanes + p * planeBytes(); }
+    unsigned char const* plane(Plane p) const { return mPlanes + p * planeBytes(); }
+    float* floatPlane(Plane p) { return reinterpret_cast<float*>(plane(p)); }
+    float const* floatPlane(Plane p) const { return reinterpret_cast<float const*>(plane(p)); }
+    std::size_t planeBytes() const { return mCapacity * sizeof(float); }
+
+    /// as returned by malloc, mPlanes is the first aligned byte in it
+    void* mBlock;
+    unsigned char* mPlanes;
+    std::size_t mSize;
+    /// points per plane, a multiple of kAlignment / sizeof(float)
+    std::size_t mCapacity;
+    std::vector<Layer> mLayers;
+};
+
+} // namespace pacpus
+
+#endif // ALIGNEDSCAN_H
@@ -0,0 +1,163 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "BirdEyeGrid.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace pacpus;
+using namespace std;
+
+static const float kDefaultCellSize = 0.2f;
+static const float kDefaultHalfExtent = 50;
+/// Smaller scans are not worth another worker
+static const int kMinPointsPerWorker = 8192;
+static const int kMinRowsPerWorker = 64;
+
+//////////////////////////////////////////////////////////////////////////
+class BirdEyeGrid::ScatterTask
+{
+public:
+    ScatterTask(BirdEyeGrid& grid, AlignedScan const& scan)
+        : mGrid(grid)
+        , mScan(scan)
+    {
+    }
+
+    /// Bins the points [first, last) of the scan
+    void operator()(int first, int last, int worker)
+    {
+        Partial& partial = mGrid.mPartials[worker];
+        int const size = mGrid.mSize;
+        float const scale = 1 / mGrid.mCellSize;
+        float const center = 0.5f * size;
+        float const* x = mScan.x();
+        float const* y = mScan.y();
+        float const* z = mScan.z();
+        float const* intensity = mScan.intensity();
+
+        for (int i = first; i < last; ++i) {
+            float const col = x[i] * scale + center;
+            float const row = y[i] * scale + center;
+            // also rejects NaN coordinates
+            if (!((col >= 0) && (col < size) && (row >= 0) && (row < size))) {
+                continue;
+            }
+            int const cell = static_cast<int>(row) * size + static_cast<int>(col);
+            if (partial.count[cell] == 0) {
+                partial.touched.push_back(cell);
+            }
+            ++partial.count[cell];
+            partial.maxZ[cell] = max(partial.maxZ[cell], z[i]);
+            partial.minZ[cell] = min(partial.minZ[cell], z[i]);
+            partial.intensitySum[cell] += intensity[i];
+        }
+    }
+
+private:
+    BirdEyeGrid& mGrid;
+    AlignedScan const& mScan;
+};
+
+/// Turns the merged intensity sums into means
+class BirdEyeGrid::FinishTask
+{
+public:
+    FinishTask(cv::Mat& result)
+        : mResult(result)
+    {
+    }
+
+    void operator()(int firstRow, int lastRow, int /*worker*/)
+    {
+        for (int row = firstRow; row < lastRow; ++row) {
+            float* cell = mResult.ptr<float>(row);
+            for (int col = 0; col < mResult.cols; ++col, cell += 4) {
+                if (cell[BC_Density] > 0) {
+                    cell[BC_MeanIntensity] /= cell[BC_Density];
+                }
+            }
+        }
+    }
+
+private:
+    cv::Mat& mResult;
+};
+
+//////////////////////////////////////////////////////////////////////////
+BirdEyeGrid::BirdEyeGrid()
+    : mCellSize(0)
+    , mSize(0)
+{
+    configure(kDefaultCellSize, kDefaultHalfExtent);
+}
+
+void BirdEyeGrid::configure(float cellSize, float halfExtent)
+{
+    mCellSize = cellSize;
+    mSize = max(1, static_cast<int>(ceil(2 * halfExtent / cellSize)));
+    // reallocated on the next scan
+    mPartials.clear();
+}
+
+void BirdEyeGrid::resizePartials(int workerCount)
+{
+    size_t const cells = static_cast<size_t>(mSize) * mSize;
+    while (static_cast<int>(mPartials.size()) < workerCount) {
+        mPartials.push_back(Partial());
+        Partial& partial = mPartials.back();
+        partial.maxZ.assign(cells, -FLT_MAX);
+        partial.minZ.assign(cells, FLT_MAX);
+        partial.intensitySum.assign(cells, 0.0f);
+        partial.count.assign(cells, 0);
+    }
+}
+
+void BirdEyeGrid::compute(AlignedScan const& scan, cv::Mat& result)
+{
+    int const pointCount = static_cast<int>(scan.size());
+
+    int const workerCount = parallelWorkerCount(pointCount, kMinPointsPerWorker);
+    resizePartials(workerCount);
+    ScatterTask scatter(*this, scan);
+    parallelFor(0, pointCount, workerCount, scatter);
+
+    result.create(mSize, mSize, CV_32FC4);
+    result.setTo(cv::Scalar::all(0));
+    for (int i = 0; i < workerCount; ++i) {
+        merge(mPartials[i], result);
+    }
+
+    FinishTask finish(result);
+    parallelFor(0, mSize, parallelWorkerCount(mSize, kMinRowsPerWorker), finish);
+}
+
+/// Adds the touched cells of a partial grid to the result and resets them
+void BirdEyeGrid::merge(Partial& partial, cv::Mat& result) const
+{
+    float* const cells = result.ptr<float>(0);
+    for (size_t i = 0; i < partial.touched.size(); ++i) {
+        int const cell = partial.touched[i];
+        float* out = cells + 4 * static_cast<size_t>(cell);
+        if (out[BC_Density] == 0) {
+            out[BC_MaxZ] = partial.maxZ[cell];
+            out[BC_MinZ] = partial.minZ[cell];
+        } else {
+            out[BC_MaxZ] = max(out[BC_MaxZ], partial.maxZ[cell]);
+            out[BC_MinZ] = min(out[BC_MinZ], partial.minZ[cell]);
+        }
+        out[BC_Density] += partial.count[cell];
+        out[BC_MeanIntensity] += partial.intensitySum[cell];
+
+        partial.maxZ[cell] = -FLT_MAX;
+        partial.minZ[cell] = FLT_MAX;
+        partial.intensitySum[cell] = 0;
+        partial.count[cell] = 0;
+    }
+    partial.touched.clear();
+}
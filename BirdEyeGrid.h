@@ -0,0 +1,87 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Bird's-eye grid of a scan: max height, min height, density and
+/// mean intensity per XY cell.
+///
+/// The points are scattered in parallel, each worker into its own partial
+/// grid, and the partial grids are merged at the end. A worker remembers the
+/// cells it touched, so resetting and merging a partial grid costs in the
+/// number of points, not in the size of the grid.
+///
+/// The result is a square CV_32FC4 image centered on the sensor, column
+/// along X and row along Y, the first row at the smallest Y. Its channels
+/// are the max Z, the min Z, the number of points and the mean intensity of
+/// each cell, empty cells are all zero.
+
+#ifndef BIRDEYEGRID_H
+#define BIRDEYEGRID_H
+
+#include "AlignedScan.h"
+
+#include "opencv2/core/core.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace pacpus
+{
+
+class BirdEyeGrid
+{
+public:
+    enum Channel {
+        BC_MaxZ,
+        BC_MinZ,
+        BC_Density,
+        BC_MeanIntensity
+    };
+
+    BirdEyeGrid();
+
+    /// @param cellSize side of a cell [m]
+    /// @param halfExtent the grid covers [-halfExtent, halfExtent] in X and Y [m]
+    void configure(float cellSize, float halfExtent);
+
+    float cellSize() const
+    {
+        return mCellSize;
+    }
+
+    /// Number of cells along each side
+    int size() const
+    {
+        return mSize;
+    }
+
+    /// Bins all points of the scan, points outside of the grid are ignored.
+    /// @param result reallocated only when the grid size changed
+    void compute(AlignedScan const& scan, cv::Mat& result);
+
+private:
+    class ScatterTask;
+    class FinishTask;
+    friend class ScatterTask;
+
+    struct Partial
+    {
+        std::vector<float> maxZ, minZ;
+        std::vector<float> intensitySum;
+        std::vector<int> count;
+        /// cells with count > 0
+        std::vector<int> touched;
+    };
+
+    void resizePartials(int workerCount);
+    void merge(Partial& partial, cv::Mat& result) const;
+
+    float mCellSize;
+    int mSize;
+    std::vector<Partial> mPartials;
+};
+
+} // namespace pacpus
+
+#endif // BIRDEYEGRID_H
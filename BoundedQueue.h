@@ -0,0 +1,180 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Bounded FIFO queue between two pipeline stages.
+///
+/// When the queue is full, push() applies the overflow policy: drop the
+/// oldest queued item, drop the pushed item, or block until the consumer
+/// makes room. close() wakes up every waiting producer and consumer, which
+/// is how the stages are shut down.
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+namespace pacpus
+{
+
+enum QueueOverflowPolicy {
+    QOP_DropOldest,
+    QOP_DropNewest,
+    QOP_Block
+};
+
+/// Parses "drop-oldest", "drop-newest" or "block".
+inline bool parseQueueOverflowPolicy(std::string const& name, QueueOverflowPolicy& policy)
+{
+    if (name == "drop-oldest") {
+        policy = QOP_DropOldest;
+    } else if (name == "drop-newest") {
+        policy = QOP_DropNewest;
+    } else if (name == "block") {
+        policy = QOP_Block;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(std::size_t capacity = 2, QueueOverflowPolicy policy = QOP_DropOldest)
+        : mCapacity(capacity)
+        , mPolicy(policy)
+        , mClosed(false)
+        , mPushCount(0)
+        , mDropCount(0)
+    {
+    }
+
+    void configure(std::size_t capacity, QueueOverflowPolicy policy)
+    {
+        QMutexLocker lock(&mMutex);
+        mCapacity = (capacity > 0) ? capacity : 1;
+        mPolicy = policy;
+    }
+
+    /// Queues an item.
+    /// @returns false if the item was dropped or the queue is closed
+    bool push(T const& item)
+    {
+        QMutexLocker lock(&mMutex);
+        while (!mClosed && (mItems.size() >= mCapacity)) {
+            if (mPolicy == QOP_DropOldest) {
+                mItems.pop_front();
+                ++mDropCount;
+            } else if (mPolicy == QOP_DropNewest) {
+                ++mDropCount;
+                return false;
+            } else {
+                mNotFull.wait(&mMutex);
+            }
+        }
+        if (mClosed) {
+            return false;
+        }
+        mItems.push_back(item);
+        ++mPushCount;
+        mNotEmpty.wakeOne();
+        return true;
+    }
+
+    /// Waits for an item.
+    /// @returns false once the queue is closed and empty
+    bool pop(T& item)
+    {
+        QMutexLocker lock(&mMutex);
+        while (mItems.empty() && !mClosed) {
+            mNotEmpty.wait(&mMutex);
+        }
+        return takeFront(item);
+    }
+
+    /// Takes an item if one is queued, never waits.
+    bool tryPop(T& item)
+    {
+        QMutexLocker lock(&mMutex);
+        return takeFront(item);
+    }
+
+    /// Wakes up all waiting stages, further pushes are refused.
+    void close()
+    {
+        QMutexLocker lock(&mMutex);
+        mClosed = true;
+        mNotEmpty.wakeAll();
+        mNotFull.wakeAll();
+    }
+
+    /// Empties the queue and accepts pushes again.
+    void reopen()
+    {
+        QMutexLocker lock(&mMutex);
+        mItems.clear();
+        mClosed = false;
+    }
+
+    std::size_t depth() const
+    {
+        QMutexLocker lock(&mMutex);
+        return mItems.size();
+    }
+
+    std::size_t capacity() const
+    {
+        QMutexLocker lock(&mMutex);
+        return mCapacity;
+    }
+
+    /// Number of accepted items
+    unsigned long pushCount() const
+    {
+        QMutexLocker lock(&mMutex);
+        return mPushCount;
+    }
+
+    /// Number of items lost to the overflow policy
+    unsigned long dropCount() const
+    {
+        QMutexLocker lock(&mMutex);
+        return mDropCount;
+    }
+
+private:
+    bool takeFront(T& item)
+    {
+        if (mItems.empty()) {
+            return false;
+        }
+        item = mItems.front();
+        mItems.pop_front();
+        mNotFull.wakeOne();
+        return true;
+    }
+
+    mutable QMutex mMutex;
+    QWaitCondition mNotEmpty, mNotFull;
+    std::deque<T> mItems;
+
+    std::size_t mCapacity;
+    QueueOverflowPolicy mPolicy;
+    bool mClosed;
+
+    unsigned long mPushCount;
+    unsigned long mDropCount;
+};
+
+} // namespace pacpus
+
+#endif // BOUNDEDQUEUE_H
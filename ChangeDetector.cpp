@@ -0,0 +1,183 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "ChangeDetector.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace pacpus;
+using namespace std;
+
+static const float kDefaultVoxelSize = 0.3f;
+static const int kDefaultBackgroundSweeps = 5;
+static const std::size_t kMinTableSize = 1024;
+
+/// Voxel coordinates are packed on 21 bits each, offset to stay positive
+static const int kCoordinateBits = 21;
+static const boost::int64_t kCoordinateOffset = 1 << (kCoordinateBits - 1);
+static const boost::uint64_t kStepX = boost::uint64_t(1) << (2 * kCoordinateBits);
+static const boost::uint64_t kStepY = boost::uint64_t(1) << kCoordinateBits;
+static const boost::uint64_t kStepZ = 1;
+
+static std::size_t hashKey(boost::uint64_t key)
+{
+    boost::uint64_t hash = key * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 32;
+    return static_cast<std::size_t>(hash);
+}
+
+//////////////////////////////////////////////////////////////////////////
+ChangeDetector::VoxelTable::VoxelTable()
+    : mMask(0)
+    , mEpoch(0)
+{
+}
+
+void ChangeDetector::VoxelTable::reset(std::size_t capacity)
+{
+    // at most half full
+    std::size_t size = kMinTableSize;
+    while (size < 2 * capacity) {
+        size *= 2;
+    }
+    ++mEpoch;
+    if ((size > mSlots.size()) || (mEpoch == 0)) {
+        Slot const empty = { 0, 0, 0 };
+        mSlots.assign(max(size, mSlots.size()), empty);
+        mEpoch = 1;
+    }
+    mMask = mSlots.size() - 1;
+    mUsed.clear();
+}
+
+ChangeDetector::Slot const* ChangeDetector::VoxelTable::find(boost::uint64_t key) const
+{
+    if (mSlots.empty()) {
+        return NULL;
+    }
+    for (std::size_t index = hashKey(key) & mMask; ; index = (index + 1) & mMask) {
+        Slot const& slot = mSlots[index];
+        if (slot.epoch != mEpoch) {
+            return NULL;
+        }
+        if (slot.key == key) {
+            return &slot;
+        }
+    }
+}
+
+ChangeDetector::Slot& ChangeDetector::VoxelTable::insert(boost::uint64_t key)
+{
+    for (std::size_t index = hashKey(key) & mMask; ; index = (index + 1) & mMask) {
+        Slot& slot = mSlots[index];
+        if (slot.epoch != mEpoch) {
+            slot.key = key;
+            slot.epoch = mEpoch;
+            slot.history = 0;
+            mUsed.push_back(static_cast<boost::uint32_t>(index));
+            return slot;
+        }
+        if (slot.key == key) {
+            return slot;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+ChangeDetector::ChangeDetector()
+    : mInverseVoxelSize(1 / kDefaultVoxelSize)
+    , mBackgroundMask((1u << kDefaultBackgroundSweeps) - 1)
+    , mSweepCount(0)
+    , mPrevious(0)
+{
+}
+
+void ChangeDetector::configure(float voxelSize, int backgroundSweeps)
+{
+    mInverseVoxelSize = 1 / voxelSize;
+    mBackgroundMask = (1u << backgroundSweeps) - 1;
+    reset();
+}
+
+void ChangeDetector::reset()
+{
+    mSweepCount = 0;
+    mTables[mPrevious].reset(0);
+}
+
+boost::uint64_t ChangeDetector::voxelKey(float x, float y, float z) const
+{
+    boost::int64_t const vx = static_cast<boost::int64_t>(floor(x * mInverseVoxelSize)) + kCoordinateOffset;
+    boost::int64_t const vy = static_cast<boost::int64_t>(floor(y * mInverseVoxelSize)) + kCoordinateOffset;
+    boost::int64_t const vz = static_cast<boost::int64_t>(floor(z * mInverseVoxelSize)) + kCoordinateOffset;
+    return static_cast<boost::uint64_t>(vx) * kStepX + static_cast<boost::uint64_t>(vy) * kStepY
+        + static_cast<boost::uint64_t>(vz) * kStepZ;
+}
+
+bool ChangeDetector::inBackground(boost::uint64_t key) const
+{
+    static const boost::uint64_t kNeighbours[] = { 0, kStepX, kStepY, kStepZ };
+    VoxelTable const& background = mTables[mPrevious];
+    for (int i = 0; i < 4; ++i) {
+        Slot const* slot = background.find(key + kNeighbours[i]);
+        if (slot && (slot->history & mBackgroundMask)) {
+            return true;
+        }
+        if (i == 0) {
+            continue;
+        }
+        slot = background.find(key - kNeighbours[i]);
+        if (slot && (slot->history & mBackgroundMask)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int ChangeDetector::process(AlignedScan const& scan, std::vector<unsigned char>& dynamic)
+{
+    std::size_t const pointCount = scan.size();
+    dynamic.resize(pointCount);
+
+    VoxelTable const& previous = mTables[mPrevious];
+    VoxelTable& current = mTables[1 - mPrevious];
+    current.reset(pointCount + previous.used().size());
+
+    // voxels of this sweep, compared to the background
+    int dynamicCount = 0;
+    float const* x = scan.x();
+    float const* y = scan.y();
+    float const* z = scan.z();
+    for (std::size_t i = 0; i < pointCount; ++i) {
+        boost::uint64_t const key = voxelKey(x[i], y[i], z[i]);
+        bool const isDynamic = (mSweepCount > 0) && !inBackground(key);
+        dynamic[i] = isDynamic;
+        dynamicCount += isDynamic;
+
+        Slot& slot = current.insert(key);
+        if (slot.history == 0) {
+            Slot const* old = previous.find(key);
+            slot.history = ((old ? old->history : 0) << 1) | 1;
+        }
+    }
+
+    // background voxels not hit this time, while they are recent enough
+    std::vector<boost::uint32_t> const& used = previous.used();
+    for (std::size_t u = 0; u < used.size(); ++u) {
+        Slot const& old = previous.slot(used[u]);
+        boost::uint32_t const history = old.history << 1;
+        if (history & mBackgroundMask) {
+            Slot& slot = current.insert(old.key);
+            if (slot.history == 0) {
+                slot.history = history;
+            }
+        }
+    }
+
+    mPrevious = 1 - mPrevious;
+    ++mSweepCount;
+    return dynamicCount;
+}
@@ -0,0 +1,100 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Tags the points of a sweep falling into voxels that were free in
+/// the previous sweeps.
+///
+/// The background is the set of voxels occupied during the last few sweeps,
+/// kept in a voxel hash with an occupancy history per voxel (one bit per
+/// sweep). A point is dynamic when neither its voxel nor the six voxels
+/// sharing a face with it were occupied in the background, the neighbours
+/// absorbing the points jittering across voxel borders.
+///
+/// Two hash tables are used in turn, one for the previous sweep and one
+/// being built. A table is emptied by moving to a new epoch, a slot only
+/// counting when it carries the current epoch, so no table is ever cleared
+/// and each sweep costs in its number of points and background voxels.
+///
+/// Sweeps are compared in the sensor frame: without ego-motion compensation
+/// the whole scene looks dynamic as soon as the sensor moves.
+
+#ifndef CHANGEDETECTOR_H
+#define CHANGEDETECTOR_H
+
+#include "AlignedScan.h"
+
+#include <boost/cstdint.hpp>
+#include <vector>
+
+namespace pacpus
+{
+
+class ChangeDetector
+{
+public:
+    ChangeDetector();
+
+    /// @param voxelSize side of a voxel [m]
+    /// @param backgroundSweeps number of previous sweeps forming the background, 1 to 31
+    void configure(float voxelSize, int backgroundSweeps);
+
+    /// Forgets the background, the next sweep has no dynamic point
+    void reset();
+
+    /// Compares the scan to the background, then adds it to the background.
+    /// @param dynamic resized to the number of points, 1 for the dynamic ones
+    /// @returns the number of dynamic points
+    int process(AlignedScan const& scan, std::vector<unsigned char>& dynamic);
+
+private:
+    struct Slot
+    {
+        boost::uint64_t key;
+        /// slot in use only if equal to the epoch of its table
+        boost::uint32_t epoch;
+        /// bit i: occupied i sweeps before the one that built the table
+        boost::uint32_t history;
+    };
+
+    /// Open addressing hash table, emptied in constant time by a new epoch
+    class VoxelTable
+    {
+    public:
+        VoxelTable();
+
+        /// Empties the table, sized for at least `capacity` voxels
+        void reset(std::size_t capacity);
+        /// @returns the slot of the key, NULL if absent
+        Slot const* find(boost::uint64_t key) const;
+        /// @returns the slot of the key, inserted with an empty history if absent
+        Slot& insert(boost::uint64_t key);
+
+        /// slots in use, in insertion order
+        std::vector<boost::uint32_t> const& used() const { return mUsed; }
+        Slot const& slot(boost::uint32_t index) const { return mSlots[index]; }
+
+    private:
+        std::vector<Slot> mSlots;
+        std::size_t mMask;
+        boost::uint32_t mEpoch;
+        std::vector<boost::uint32_t> mUsed;
+    };
+
+    boost::uint64_t voxelKey(float x, float y, float z) const;
+    bool inBackground(boost::uint64_t key) const;
+
+    float mInverseVoxelSize;
+    boost::uint32_t mBackgroundMask;
+    /// sweeps added since the last reset
+    int mSweepCount;
+
+    VoxelTable mTables[2];
+    /// table of the previous sweep, the other one is rebuilt
+    int mPrevious;
+};
+
+} // namespace pacpus
+
+#endif // CHANGEDETECTOR_H
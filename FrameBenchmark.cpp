@@ -0,0 +1,66 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "FrameBenchmark.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <algorithm>
+#include <numeric>
+
+using namespace pacpus;
+using namespace std;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.FrameBenchmark");
+
+FrameBenchmark::FrameBenchmark(QString const& name)
+    : mName(name)
+    , mFrameCount(0)
+    , mFirstFrame(true)
+{
+}
+
+void FrameBenchmark::start(int frameCount)
+{
+    mFrameCount = max(0, frameCount);
+    mFirstFrame = true;
+    mFrameTimes.clear();
+    mFrameTimes.reserve(mFrameCount);
+    if (mFrameCount > 0) {
+        LOG_INFO("benchmarking the " << mName << " render path over " << mFrameCount << " frames");
+    }
+}
+
+bool FrameBenchmark::frameDone()
+{
+    if (!isRunning()) {
+        return false;
+    }
+    // the first frame only starts the clock
+    if (mFirstFrame) {
+        mFirstFrame = false;
+        mTimer.start();
+        return true;
+    }
+    mFrameTimes.push_back(mTimer.nsecsElapsed() / 1e6);
+    mTimer.start();
+    if (static_cast<int>(mFrameTimes.size()) < mFrameCount) {
+        return true;
+    }
+    report();
+    mFrameCount = 0;
+    return false;
+}
+
+void FrameBenchmark::report()
+{
+    size_t const count = mFrameTimes.size();
+    double const mean = accumulate(mFrameTimes.begin(), mFrameTimes.end(), 0.0) / count;
+    sort(mFrameTimes.begin(), mFrameTimes.end());
+    double const median = mFrameTimes[count / 2];
+    double const p95 = mFrameTimes[min(count - 1, count * 95 / 100)];
+    LOG_INFO(mName << " render path: " << count << " frames, mean=" << mean << " ms median=" << median
+        << " ms p95=" << p95 << " ms max=" << mFrameTimes.back() << " ms (" << 1000 / mean << " fps)");
+}
@@ -0,0 +1,57 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Frame time statistics of a view repainting continuously.
+///
+/// While running, the view schedules a new frame as soon as one is done and
+/// reports each completed frame. The frame time is the interval between two
+/// completed frames, so it covers everything the view does for a frame,
+/// buffer swap and widget compositing included. Mean, median, 95th
+/// percentile and max are logged once the requested number of frames has
+/// been measured.
+
+#ifndef FRAMEBENCHMARK_H
+#define FRAMEBENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include <vector>
+
+namespace pacpus
+{
+
+class FrameBenchmark
+{
+public:
+    /// @param name render path, used in the report
+    explicit FrameBenchmark(QString const& name);
+
+    /// Measures the next frameCount frames, 0 does nothing
+    void start(int frameCount);
+
+    bool isRunning() const
+    {
+        return mFrameCount > 0;
+    }
+
+    /// Records a completed frame.
+    /// @returns true while more frames are wanted
+    bool frameDone();
+
+private:
+    void report();
+
+    QString mName;
+    int mFrameCount;
+    bool mFirstFrame;
+    QElapsedTimer mTimer;
+    /// [ms]
+    std::vector<double> mFrameTimes;
+};
+
+} // namespace pacpus
+
+#endif // FRAMEBENCHMARK_H
@@ -0,0 +1,69 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "FrameGovernor.h"
+
+#include <algorithm>
+#include <climits>
+
+using namespace pacpus;
+using namespace std;
+
+/// Weight of the newest frame in the moving averages
+static const double kSmoothing = 0.1;
+/// Frames drawing fewer points say little about the cost of a point
+static const int kMinMeasuredPoints = 1000;
+/// The budget never goes below this number of points
+static const int kMinPointBudget = 10000;
+/// Relative change of the estimated budget needed to apply it
+static const double kHysteresisLow = 0.8;
+static const double kHysteresisHigh = 1.25;
+
+FrameGovernor::FrameGovernor(double targetFrameTime)
+    : mTargetFrameTime(targetFrameTime)
+    , mAverageFrameTime(0)
+    , mPointCost(0)
+    , mPointBudget(INT_MAX)
+{
+}
+
+void FrameGovernor::setTargetFrameTime(double targetFrameTime)
+{
+    mTargetFrameTime = targetFrameTime;
+    mPointBudget = INT_MAX;
+    mPointCost = 0;
+}
+
+void FrameGovernor::addFrame(double frameTime, int pointCount)
+{
+    mAverageFrameTime = (mAverageFrameTime == 0)
+        ? frameTime
+        : (1 - kSmoothing) * mAverageFrameTime + kSmoothing * frameTime;
+    if (pointCount < kMinMeasuredPoints) {
+        return;
+    }
+
+    double const pointCost = frameTime / pointCount;
+    mPointCost = (mPointCost == 0)
+        ? pointCost
+        : (1 - kSmoothing) * mPointCost + kSmoothing * pointCost;
+
+    double const estimate = max(static_cast<double>(kMinPointBudget), mTargetFrameTime / mPointCost);
+    if (estimate >= INT_MAX) {
+        mPointBudget = INT_MAX;
+    } else if ((mPointBudget == INT_MAX)
+               || (estimate < kHysteresisLow * mPointBudget)
+               || (estimate > kHysteresisHigh * mPointBudget)) {
+        mPointBudget = static_cast<int>(estimate);
+    }
+}
+
+int FrameGovernor::stride(int pointCount) const
+{
+    if (pointCount <= mPointBudget) {
+        return 1;
+    }
+    return (pointCount + mPointBudget - 1) / mPointBudget;
+}
@@ -0,0 +1,62 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Point budget holding a target frame time.
+///
+/// The governor keeps a moving average of the cost of one point, measured
+/// on the frames actually drawn, and derives the number of points that fit
+/// in the target frame time. The budget only moves when the estimate leaves
+/// a band around it, so that measurement noise does not make the displayed
+/// density oscillate from frame to frame.
+
+#ifndef FRAMEGOVERNOR_H
+#define FRAMEGOVERNOR_H
+
+namespace pacpus
+{
+
+class FrameGovernor
+{
+public:
+    /// @param targetFrameTime [ms]
+    explicit FrameGovernor(double targetFrameTime = 16);
+
+    void setTargetFrameTime(double targetFrameTime);
+    double targetFrameTime() const
+    {
+        return mTargetFrameTime;
+    }
+
+    /// Records a frame.
+    /// @param frameTime [ms]
+    /// @param pointCount number of points drawn in the frame
+    void addFrame(double frameTime, int pointCount);
+
+    /// Number of points that can be drawn within the target frame time
+    int pointBudget() const
+    {
+        return mPointBudget;
+    }
+
+    /// Decimation stride keeping pointCount points within the budget, at least 1
+    int stride(int pointCount) const;
+
+    /// Moving average of the recorded frame times [ms]
+    double averageFrameTime() const
+    {
+        return mAverageFrameTime;
+    }
+
+private:
+    double mTargetFrameTime;
+    double mAverageFrameTime;
+    /// moving average of the cost of one point [ms], 0 until measured
+    double mPointCost;
+    int mPointBudget;
+};
+
+} // namespace pacpus
+
+#endif // FRAMEGOVERNOR_H
@@ -0,0 +1,83 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "GroundImage.h"
+#include "BirdEyeGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace pacpus;
+using namespace std;
+
+/// Heights mapped to the ends of the bird's-eye color scale [m]
+static const float kGroundMinZ = -3;
+static const float kGroundMaxZ = 3;
+
+/// Jet-like color scale, value in [0, 1]
+static void heightColor(float value, unsigned char* rgba)
+{
+    float const r = 1.5f - fabs(4 * value - 3);
+    float const g = 1.5f - fabs(4 * value - 2);
+    float const b = 1.5f - fabs(4 * value - 1);
+    rgba[0] = static_cast<unsigned char>(255 * min(1.0f, max(0.0f, r)));
+    rgba[1] = static_cast<unsigned char>(255 * min(1.0f, max(0.0f, g)));
+    rgba[2] = static_cast<unsigned char>(255 * min(1.0f, max(0.0f, b)));
+    rgba[3] = 255;
+}
+
+bool pacpus::groundImageToRgba(cv::Mat const& image, vector<unsigned char>& pixels)
+{
+    int const rows = image.rows;
+    int const cols = image.cols;
+    int const type = image.type();
+
+    double minValue = 0, maxValue = 1;
+    if (type == CV_32FC1) {
+        cv::minMaxLoc(image, &minValue, &maxValue);
+    } else if ((type != CV_32FC4) && (type != CV_8UC1) && (type != CV_8UC3)) {
+        return false;
+    }
+    float const valueScale = (maxValue > minValue) ? static_cast<float>(1 / (maxValue - minValue)) : 0.0f;
+    float const heightScale = 1 / (kGroundMaxZ - kGroundMinZ);
+
+    pixels.resize(4 * rows * cols);
+    unsigned char* pixel = &pixels[0];
+    for (int row = 0; row < rows; ++row) {
+        for (int col = 0; col < cols; ++col, pixel += 4) {
+            switch (type) {
+            case CV_32FC4: {
+                float const* cell = image.ptr<float>(row) + 4 * col;
+                if (cell[BirdEyeGrid::BC_Density] > 0) {
+                    heightColor((cell[BirdEyeGrid::BC_MaxZ] - kGroundMinZ) * heightScale, pixel);
+                } else {
+                    pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+                }
+                break;
+            }
+            case CV_8UC1:
+                pixel[0] = pixel[1] = pixel[2] = image.ptr<unsigned char>(row)[col];
+                pixel[3] = 255;
+                break;
+            case CV_8UC3: {
+                // OpenCV images are BGR
+                unsigned char const* bgr = image.ptr<unsigned char>(row) + 3 * col;
+                pixel[0] = bgr[2];
+                pixel[1] = bgr[1];
+                pixel[2] = bgr[0];
+                pixel[3] = 255;
+                break;
+            }
+            default: {
+                float const value = (image.ptr<float>(row)[col] - static_cast<float>(minValue)) * valueScale;
+                pixel[0] = pixel[1] = pixel[2] = static_cast<unsigned char>(255 * min(1.0f, max(0.0f, value)));
+                pixel[3] = 255;
+                break;
+            }
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Coloring of the images laid on the ground plane, shared by the
+/// render paths.
+///
+/// A CV_32FC4 bird's-eye grid (see BirdEyeGrid) is colored by max height,
+/// its empty cells are transparent. CV_8UC1, CV_8UC3 (BGR) and CV_32FC1
+/// grids, such as occupancy grids, are shown as they are, a float grid being
+/// stretched between its min and max.
+
+#ifndef GROUNDIMAGE_H
+#define GROUNDIMAGE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <vector>
+
+namespace pacpus
+{
+
+/// Converts a ground image to RGBA texels, first row first.
+/// @returns false for an unsupported image type
+bool groundImageToRgba(cv::Mat const& image, std::vector<unsigned char>& pixels);
+
+} // namespace pacpus
+
+#endif // GROUNDIMAGE_H
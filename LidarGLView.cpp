@@ -0,0 +1,84 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "LidarGLView.h"
+#include "LidarGLWindow.h"
+#include "LidarTrace.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <QCheckBox>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+using namespace pacpus;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.LidarGLView");
+
+static const int kControlsWidth = 160;
+
+LidarGLView::LidarGLView(QWidget* parent)
+    : QWidget(parent)
+    , mWindow(new LidarGLWindow)
+{
+    PACPUS_LOG_FUNCTION();
+
+    QWidget* container = QWidget::createWindowContainer(mWindow, /*parent=*/ this);
+    container->setFocusPolicy(Qt::StrongFocus);
+
+    QWidget* controls = new QWidget(/*parent=*/ this);
+    controls->setFixedWidth(kControlsWidth);
+    QVBoxLayout* controlsLayout = new QVBoxLayout(controls);
+    {
+        QCheckBox* lidarCheckBox = new QCheckBox(tr("Show lidar"), /*parent=*/ controls);
+        lidarCheckBox->setChecked(true);
+        connect(lidarCheckBox, &QCheckBox::toggled, mWindow, &LidarGLWindow::setLidarEnabled);
+        controlsLayout->addWidget(lidarCheckBox);
+    }
+    {
+        QCheckBox* gridCheckBox = new QCheckBox(tr("Show grid"), /*parent=*/ controls);
+        gridCheckBox->setChecked(true);
+        connect(gridCheckBox, &QCheckBox::toggled, mWindow, &LidarGLWindow::setGridEnabled);
+        controlsLayout->addWidget(gridCheckBox);
+    }
+    {
+        QCheckBox* groundCheckBox = new QCheckBox(tr("Show bird's-eye grid"), /*parent=*/ controls);
+        groundCheckBox->setChecked(true);
+        connect(groundCheckBox, &QCheckBox::toggled, mWindow, &LidarGLWindow::setGroundEnabled);
+        controlsLayout->addWidget(groundCheckBox);
+    }
+    controlsLayout->addStretch();
+
+    QHBoxLayout* layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(container, /*stretch=*/ 1);
+    layout->addWidget(controls);
+    resize(680 + kControlsWidth, 360);
+
+    connect(mWindow, &LidarGLWindow::snapshotRequested, this, &LidarGLView::snapshotRequested);
+    connect(mWindow, &LidarGLWindow::continuousExportToggled, this, &LidarGLView::continuousExportToggled);
+}
+
+LidarGLView::~LidarGLView()
+{
+    PACPUS_LOG_FUNCTION();
+}
+
+void LidarGLView::display(LidarSweepPtr const& sweep)
+{
+    LIDAR_TRACE_SCOPE("LidarGLView::display");
+    mWindow->setSweep(sweep);
+}
+
+void LidarGLView::display(cv::Mat const& grid, float cellSize)
+{
+    LIDAR_TRACE_SCOPE("LidarGLView::display");
+    mWindow->setGroundImage(grid, cellSize);
+}
+
+void LidarGLView::setBenchmarkFrames(int frameCount)
+{
+    mWindow->setBenchmarkFrames(frameCount);
+}
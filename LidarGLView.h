@@ -0,0 +1,52 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Top-level widget of the OpenGL window render path.
+///
+/// The LidarGLWindow is embedded through a window container, the controls
+/// are plain widgets next to it. They are not composited into the 3D frames
+/// and only repaint when they change.
+
+#ifndef LIDARGLVIEW_H
+#define LIDARGLVIEW_H
+
+#include "LidarSweep.h"
+
+#include <QWidget>
+
+namespace pacpus
+{
+
+class LidarGLWindow;
+
+class LidarGLView
+    : public QWidget
+{
+    Q_OBJECT
+
+public:
+    LidarGLView(QWidget* parent = 0);
+    ~LidarGLView();
+
+public Q_SLOTS:
+    void display(LidarSweepPtr const& sweep);
+    /// Grid image laid on the ground plane, centered on the sensor
+    void display(cv::Mat const& grid, float cellSize);
+
+    /// Measures this many frames once the first sweep is shown, 0 disables
+    void setBenchmarkFrames(int frameCount);
+
+Q_SIGNALS:
+    void snapshotRequested();
+    void continuousExportToggled();
+
+private:
+    /// owned by its container
+    LidarGLWindow* mWindow;
+};
+
+} // namespace pacpus
+
+#endif // LIDARGLVIEW_H
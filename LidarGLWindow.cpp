@@ -0,0 +1,678 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "GroundImage.h"
+#include "LidarGLWindow.h"
+#include "LidarTrace.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEvent>
+#include <QExposeEvent>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QResizeEvent>
+#include <QSurfaceFormat>
+#include <QVector4D>
+#include <QWheelEvent>
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#   define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+using namespace pacpus;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.LidarGLWindow");
+
+static const int kGLMajorVersion = 3;
+static const int kGLMinorVersion = 2;
+
+static const float kFOVX = 70;
+static const float kZNear = 0.01f;
+static const float kZFar = 1000;
+
+static const float kPointSize = 2;
+static const int kFrameLength = 5;
+static const GLfloat kAxes[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+static const float kGridLength = 101;
+static const float kGridStep = 10;
+static const int kCircleSegments = 72;
+
+static const int kTranslateStep = 1;
+
+static const char* const kColorVertexShader =
+    "#version 150\n"
+    "uniform mat4 mvp;\n"
+    "uniform float pointSize;\n"
+    "in vec3 position;\n"
+    "in vec4 color;\n"
+    "out vec4 vertexColor;\n"
+    "void main() {\n"
+    "    gl_Position = mvp * vec4(position, 1.0);\n"
+    "    gl_PointSize = pointSize;\n"
+    "    vertexColor = color;\n"
+    "}\n";
+
+/// Reads the planes of an AlignedScan, one attribute per plane
+static const char* const kScanVertexShader =
+    "#version 150\n"
+    "uniform mat4 mvp;\n"
+    "uniform float pointSize;\n"
+    "uniform vec4 layerColors[10];\n"
+    "in float x;\n"
+    "in float y;\n"
+    "in float z;\n"
+    "in float layer;\n"
+    "out vec4 vertexColor;\n"
+    "void main() {\n"
+    "    gl_Position = mvp * vec4(x, y, z, 1.0);\n"
+    "    gl_PointSize = pointSize;\n"
+    "    vertexColor = layerColors[int(layer) % 10];\n"
+    "}\n";
+
+static const char* const kColorFragmentShader =
+    "#version 150\n"
+    "in vec4 vertexColor;\n"
+    "out vec4 fragmentColor;\n"
+    "void main() {\n"
+    "    fragmentColor = vertexColor;\n"
+    "}\n";
+
+static const char* const kTextureVertexShader =
+    "#version 150\n"
+    "uniform mat4 mvp;\n"
+    "in vec2 position;\n"
+    "in vec2 texCoord;\n"
+    "out vec2 vertexTexCoord;\n"
+    "void main() {\n"
+    "    gl_Position = mvp * vec4(position, 0.0, 1.0);\n"
+    "    vertexTexCoord = texCoord;\n"
+    "}\n";
+
+/// empty cells are transparent
+static const char* const kTextureFragmentShader =
+    "#version 150\n"
+    "uniform sampler2D image;\n"
+    "in vec2 vertexTexCoord;\n"
+    "out vec4 fragmentColor;\n"
+    "void main() {\n"
+    "    vec4 texel = texture(image, vertexTexCoord);\n"
+    "    if (texel.a == 0.0) {\n"
+    "        discard;\n"
+    "    }\n"
+    "    fragmentColor = texel;\n"
+    "}\n";
+
+enum AttributeLocation {
+    AL_Position = 0,
+    AL_Color = 1,
+    AL_TexCoord = 1,
+    AL_X = 0,
+    AL_Y = 1,
+    AL_Z = 2,
+    AL_Layer = 3
+};
+
+/// attribute names by location, NULL terminated
+static char const* const kColorAttributes[] = { "position", "color", NULL };
+static char const* const kTextureAttributes[] = { "position", "texCoord", NULL };
+static char const* const kScanAttributes[] = { "x", "y", "z", "layer", NULL };
+
+static QOpenGLShaderProgram* createProgram(char const* vertexShader, char const* fragmentShader,
+                                           char const* const* attributes)
+{
+    QOpenGLShaderProgram* program = new QOpenGLShaderProgram;
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    for (int location = 0; attributes[location]; ++location) {
+        program->bindAttributeLocation(attributes[location], location);
+    }
+    if (!program->link()) {
+        LOG_ERROR("cannot link shader program: " << program->log());
+        delete program;
+        return NULL;
+    }
+    return program;
+}
+
+//////////////////////////////////////////////////////////////////////////
+LidarGLWindow::LidarGLWindow(QWindow* parent)
+    : QWindow(parent)
+    , m_updatePending(false)
+    , m_scanDirty(false)
+    , m_scanBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_scanVertexCount(0)
+    , m_groundCellSize(0)
+    , m_groundFromSweep(false)
+    , m_groundDirty(false)
+    , m_groundBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_groundTexture(0)
+    , m_overlayDirty(true)
+    , m_overlayBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_overlayVertexCount(0)
+    , m_displayLidar(true)
+    , m_displayGrid(true)
+    , m_displayGround(true)
+    , m_benchmark("window")
+    , m_benchmarkFrames(0)
+{
+    setSurfaceType(QWindow::OpenGLSurface);
+
+    QSurfaceFormat format;
+    format.setVersion(kGLMajorVersion, kGLMinorVersion);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setDepthBufferSize(24);
+    setFormat(format);
+
+    for (int i = Qt::red; i <= Qt::darkYellow; ++i) {
+        m_pointColors.append(QColor(Qt::GlobalColor(i)));
+    }
+    resetView();
+}
+
+LidarGLWindow::~LidarGLWindow()
+{
+    if (!m_context) {
+        return;
+    }
+    m_context->makeCurrent(this);
+    m_scanVao.destroy();
+    m_scanBuffer.destroy();
+    m_groundVao.destroy();
+    m_groundBuffer.destroy();
+    m_overlayVao.destroy();
+    m_overlayBuffer.destroy();
+    if (m_groundTexture) {
+        glDeleteTextures(1, &m_groundTexture);
+    }
+    m_colorProgram.reset();
+    m_scanProgram.reset();
+    m_textureProgram.reset();
+    m_context->doneCurrent();
+}
+
+//////////////////////////////////////////////////////////////////////////
+void LidarGLWindow::setSweep(LidarSweepPtr const& sweep)
+{
+    m_sweep = sweep;
+    m_scanDirty = true;
+    if (!m_sweep->birdEye.empty()) {
+        setGroundImage(m_sweep->birdEye, m_sweep->birdEyeCellSize);
+        m_groundFromSweep = true;
+    } else if (m_groundFromSweep) {
+        // the buffer goes back to the pool with the previous sweep
+        m_groundImage.release();
+        m_groundFromSweep = false;
+    }
+    if (m_benchmarkFrames > 0) {
+        m_benchmark.start(m_benchmarkFrames);
+        m_benchmarkFrames = 0;
+    }
+    renderLater();
+}
+
+void LidarGLWindow::setGroundImage(cv::Mat const& image, float cellSize)
+{
+    m_groundImage = image;
+    m_groundCellSize = cellSize;
+    m_groundFromSweep = false;
+    m_groundDirty = true;
+    renderLater();
+}
+
+void LidarGLWindow::setLidarEnabled(bool lidarEnabled)
+{
+    m_displayLidar = lidarEnabled;
+    renderLater();
+}
+
+void LidarGLWindow::setGridEnabled(bool gridEnabled)
+{
+    m_displayGrid = gridEnabled;
+    m_overlayDirty = true;
+    renderLater();
+}
+
+void LidarGLWindow::setGroundEnabled(bool groundEnabled)
+{
+    m_displayGround = groundEnabled;
+    renderLater();
+}
+
+void LidarGLWindow::setBenchmarkFrames(int frameCount)
+{
+    m_benchmarkFrames = frameCount;
+}
+
+void LidarGLWindow::renderLater()
+{
+    if (!m_updatePending) {
+        m_updatePending = true;
+        QCoreApplication::postEvent(this, new QEvent(QEvent::UpdateRequest));
+    }
+}
+
+bool LidarGLWindow::event(QEvent* event)
+{
+    if (event->type() == QEvent::UpdateRequest) {
+        m_updatePending = false;
+        renderNow();
+        return true;
+    }
+    return QWindow::event(event);
+}
+
+void LidarGLWindow::exposeEvent(QExposeEvent* /*event*/)
+{
+    if (isExposed()) {
+        renderNow();
+    }
+}
+
+void LidarGLWindow::resizeEvent(QResizeEvent* /*event*/)
+{
+    renderLater();
+}
+
+//////////////////////////////////////////////////////////////////////////
+bool LidarGLWindow::initializeGL()
+{
+    m_context.reset(new QOpenGLContext);
+    m_context->setFormat(requestedFormat());
+    if (!m_context->create() || !m_context->makeCurrent(this)) {
+        LOG_ERROR("cannot create an OpenGL " << kGLMajorVersion << "." << kGLMinorVersion << " core profile context");
+        return false;
+    }
+    initializeOpenGLFunctions();
+
+    QSurfaceFormat const format = m_context->format();
+    LOG_INFO("OpenGL " << format.majorVersion() << "." << format.minorVersion()
+        << ((format.profile() == QSurfaceFormat::CoreProfile) ? " core" : " compatibility") << " profile");
+
+    m_colorProgram.reset(createProgram(kColorVertexShader, kColorFragmentShader, kColorAttributes));
+    m_scanProgram.reset(createProgram(kScanVertexShader, kColorFragmentShader, kScanAttributes));
+    m_textureProgram.reset(createProgram(kTextureVertexShader, kTextureFragmentShader, kTextureAttributes));
+    if (!m_colorProgram || !m_scanProgram || !m_textureProgram) {
+        m_colorProgram.reset();
+        return false;
+    }
+
+    QVector4D layerColors[10];
+    for (int i = 0; i < 10; ++i) {
+        QColor const& color = m_pointColors[i];
+        layerColors[i] = QVector4D(color.redF(), color.greenF(), color.blueF(), 1);
+    }
+    m_scanProgram->bind();
+    m_scanProgram->setUniformValueArray("layerColors", layerColors, 10);
+    m_scanProgram->release();
+
+    // the plane offsets of the scan follow its capacity, set at each upload
+    m_scanBuffer.create();
+    m_scanBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    m_scanVao.create();
+    m_scanVao.bind();
+    m_scanProgram->enableAttributeArray(AL_X);
+    m_scanProgram->enableAttributeArray(AL_Y);
+    m_scanProgram->enableAttributeArray(AL_Z);
+    m_scanProgram->enableAttributeArray(AL_Layer);
+    m_scanVao.release();
+
+    // the other vertex layouts never change, only the buffer contents
+
+    m_overlayBuffer.create();
+    m_overlayVao.create();
+    m_overlayVao.bind();
+    setColorAttributes(m_overlayBuffer);
+    m_overlayVao.release();
+
+    m_groundBuffer.create();
+    m_groundVao.create();
+    m_groundVao.bind();
+    m_groundBuffer.bind();
+    m_textureProgram->enableAttributeArray(AL_Position);
+    m_textureProgram->setAttributeBuffer(AL_Position, GL_FLOAT, 0, 2, 4 * sizeof(GLfloat));
+    m_textureProgram->enableAttributeArray(AL_TexCoord);
+    m_textureProgram->setAttributeBuffer(AL_TexCoord, GL_FLOAT, 2 * sizeof(GLfloat), 2, 4 * sizeof(GLfloat));
+    m_groundVao.release();
+    m_groundBuffer.release();
+
+    glGenTextures(1, &m_groundTexture);
+    glBindTexture(GL_TEXTURE_2D, m_groundTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    return true;
+}
+
+void LidarGLWindow::setColorAttributes(QOpenGLBuffer& buffer)
+{
+    buffer.bind();
+    m_colorProgram->enableAttributeArray(AL_Position);
+    m_colorProgram->setAttributeBuffer(AL_Position, GL_FLOAT, offsetof(ColorVertex, x), 3, sizeof(ColorVertex));
+    // normalized to [0, 1]
+    m_colorProgram->enableAttributeArray(AL_Color);
+    m_colorProgram->setAttributeBuffer(AL_Color, GL_UNSIGNED_BYTE, offsetof(ColorVertex, r), 4, sizeof(ColorVertex));
+    buffer.release();
+}
+
+void LidarGLWindow::renderNow()
+{
+    if (!isExposed()) {
+        return;
+    }
+    if (!m_context) {
+        if (!initializeGL()) {
+            return;
+        }
+    } else if (!m_colorProgram) {
+        // initialization failed, already reported
+        return;
+    } else {
+        m_context->makeCurrent(this);
+    }
+    LIDAR_TRACE_SCOPE("LidarGLWindow::render");
+
+    qreal const ratio = devicePixelRatio();
+    glViewport(0, 0, static_cast<GLsizei>(width() * ratio), static_cast<GLsizei>(height() * ratio));
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    QMatrix4x4 projection;
+    projection.perspective(kFOVX, static_cast<float>(width()) / std::max(1, height()), kZNear, kZFar);
+    QMatrix4x4 modelView;
+    modelView.lookAt(/*eye=*/ m_cameraEye, /*center=*/ m_cameraRef, /*up=*/ m_cameraUp);
+    QMatrix4x4 const mvp = projection * modelView;
+
+    // ground image first, everything else is drawn over it
+    if (m_groundDirty) {
+        uploadGround();
+    }
+    if (m_displayGround && !m_groundImage.empty()) {
+        m_textureProgram->bind();
+        // the grid of a sweep moves with it
+        m_textureProgram->setUniformValue("mvp", m_groundFromSweep ? mvp * m_sweep->pose : mvp);
+        m_textureProgram->setUniformValue("image", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_groundTexture);
+        m_groundVao.bind();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        m_groundVao.release();
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_textureProgram->release();
+    }
+
+    m_colorProgram->bind();
+    m_colorProgram->setUniformValue("mvp", mvp);
+    if (m_overlayDirty) {
+        buildOverlay();
+    }
+    m_colorProgram->setUniformValue("pointSize", 1.0f);
+    m_overlayVao.bind();
+    glDrawArrays(GL_LINES, 0, m_overlayVertexCount);
+    m_overlayVao.release();
+    m_colorProgram->release();
+
+    if (m_displayLidar) {
+        if (m_scanDirty) {
+            uploadScan();
+        }
+        m_scanProgram->bind();
+        // the sweep is drawn at its pose
+        m_scanProgram->setUniformValue("mvp", m_sweep ? mvp * m_sweep->pose : mvp);
+        m_scanProgram->setUniformValue("pointSize", kPointSize);
+        m_scanVao.bind();
+        glDrawArrays(GL_POINTS, 0, m_scanVertexCount);
+        m_scanVao.release();
+        m_scanProgram->release();
+    }
+
+    m_context->swapBuffers(this);
+
+    if (m_benchmark.frameDone()) {
+        renderLater();
+    }
+}
+
+void LidarGLWindow::uploadScan()
+{
+    // the planes are uploaded as they are, no repacking
+    AlignedScan::Buffer const planes = m_sweep->points.buffer();
+    m_scanVertexCount = static_cast<int>(m_sweep->points.size());
+
+    m_scanVao.bind();
+    m_scanBuffer.bind();
+    m_scanBuffer.allocate(planes.data, static_cast<int>(planes.size));
+    m_scanProgram->setAttributeBuffer(AL_X, GL_FLOAT, static_cast<int>(planes.offset[AlignedScan::SP_X]), 1);
+    m_scanProgram->setAttributeBuffer(AL_Y, GL_FLOAT, static_cast<int>(planes.offset[AlignedScan::SP_Y]), 1);
+    m_scanProgram->setAttributeBuffer(AL_Z, GL_FLOAT, static_cast<int>(planes.offset[AlignedScan::SP_Z]), 1);
+    // converted to float as is, setAttributeBuffer() would normalize it
+    glVertexAttribPointer(AL_Layer, 1, GL_INT, GL_FALSE, 0,
+                          reinterpret_cast<GLvoid const*>(planes.offset[AlignedScan::SP_Layer]));
+    m_scanVao.release();
+    m_scanBuffer.release();
+
+    m_scanDirty = false;
+}
+
+void LidarGLWindow::uploadGround()
+{
+    m_groundDirty = false;
+    if (m_groundImage.empty()) {
+        return;
+    }
+    if (!groundImageToRgba(m_groundImage, m_groundPixels)) {
+        LOG_WARN("unsupported ground image type " << m_groundImage.type());
+        m_groundImage.release();
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, m_groundTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_groundImage.cols, m_groundImage.rows, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, &m_groundPixels[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // centered on the sensor, position and texture coordinates
+    GLfloat const halfX = 0.5f * m_groundCellSize * m_groundImage.cols;
+    GLfloat const halfY = 0.5f * m_groundCellSize * m_groundImage.rows;
+    GLfloat const quad[] = {
+        -halfX, -halfY, 0, 0,
+        halfX, -halfY, 1, 0,
+        -halfX, halfY, 0, 1,
+        halfX, halfY, 1, 1
+    };
+    m_groundBuffer.bind();
+    m_groundBuffer.allocate(quad, static_cast<int>(sizeof(quad)));
+    m_groundBuffer.release();
+}
+
+void LidarGLWindow::buildOverlay()
+{
+    std::vector<ColorVertex> vertices;
+    ColorVertex vertex = { 0, 0, 0, 0, 0, 0, 255 };
+
+    // XYZ-axis frame, red X, green Y, blue Z
+    for (int axis = 0; axis < 3; ++axis) {
+        vertex.r = static_cast<GLubyte>(255 * kAxes[axis][0]);
+        vertex.g = static_cast<GLubyte>(255 * kAxes[axis][1]);
+        vertex.b = static_cast<GLubyte>(255 * kAxes[axis][2]);
+        vertex.x = vertex.y = vertex.z = 0;
+        vertices.push_back(vertex);
+        vertex.x = kFrameLength * kAxes[axis][0];
+        vertex.y = kFrameLength * kAxes[axis][1];
+        vertex.z = kFrameLength * kAxes[axis][2];
+        vertices.push_back(vertex);
+    }
+
+    if (m_displayGrid) {
+        vertex.r = vertex.g = vertex.b = 255;
+        vertex.z = 0;
+        // concentric circles
+        for (float radius = kGridStep; radius < kGridLength; radius += kGridStep) {
+            for (int i = 0; i < kCircleSegments; ++i) {
+                for (int end = 0; end < 2; ++end) {
+                    double const angle = 2 * 3.14159265 * (i + end) / kCircleSegments;
+                    vertex.x = static_cast<GLfloat>(radius * std::cos(angle));
+                    vertex.y = static_cast<GLfloat>(radius * std::sin(angle));
+                    vertices.push_back(vertex);
+                }
+            }
+        }
+        // cross along the X and Y axes
+        float const length = kGridLength + kGridStep;
+        vertex.y = 0;
+        vertex.x = -length;
+        vertices.push_back(vertex);
+        vertex.x = length;
+        vertices.push_back(vertex);
+        vertex.x = 0;
+        vertex.y = -length;
+        vertices.push_back(vertex);
+        vertex.y = length;
+        vertices.push_back(vertex);
+    }
+
+    m_overlayVertexCount = static_cast<int>(vertices.size());
+    m_overlayBuffer.bind();
+    m_overlayBuffer.allocate(&vertices[0], static_cast<int>(vertices.size() * sizeof(ColorVertex)));
+    m_overlayBuffer.release();
+    m_overlayDirty = false;
+}
+
+//////////////////////////////////////////////////////////////////////////
+void LidarGLWindow::resetView()
+{
+    // camera eye above the center point, as in LidarScene
+    m_cameraEye = QVector3D(0, 0, 50);
+    m_cameraRef = QVector3D(0, 0, 0);
+    m_cameraUp = QVector3D(1, 0, 0);
+}
+
+void LidarGLWindow::zoomCamera(float ratio)
+{
+    QVector3D const viewVector = m_cameraRef - m_cameraEye;
+    m_cameraEye = m_cameraRef - viewVector * ratio;
+}
+
+void LidarGLWindow::moveCamera(QVector3D const& translation)
+{
+    m_cameraEye += translation;
+    m_cameraRef += translation;
+}
+
+void LidarGLWindow::mousePressEvent(QMouseEvent* event)
+{
+    m_lastMousePos = event->pos();
+    event->accept();
+}
+
+void LidarGLWindow::mouseMoveEvent(QMouseEvent* event)
+{
+    Qt::MouseButtons const handledButtons = Qt::LeftButton | Qt::RightButton | Qt::MiddleButton;
+    if (!(event->buttons() & handledButtons)) {
+        return;
+    }
+    QPoint const delta = event->pos() - m_lastMousePos;
+    m_lastMousePos = event->pos();
+
+    // same controls as LidarScene::mouseMoveEvent
+    QMatrix4x4 rot;
+    float const anglex = delta.x() * -1.0f;
+    if (event->buttons() & Qt::LeftButton) {
+        float const angley = delta.y() * 1.0f;
+        QVector3D const viewVector = m_cameraEye - m_cameraRef;
+        rot.rotate(anglex, m_cameraUp);
+        rot.rotate(angley, QVector3D::crossProduct(viewVector, m_cameraUp));
+        m_cameraRef = m_cameraEye - rot * viewVector;
+    }
+    if (event->buttons() & Qt::RightButton) {
+        float const angley = delta.y() * -1.0f;
+        QVector3D const viewVector = m_cameraRef - m_cameraEye;
+        rot.rotate(anglex, m_cameraUp);
+        rot.rotate(angley, QVector3D::crossProduct(viewVector, m_cameraUp));
+        m_cameraEye = m_cameraRef - rot * viewVector;
+    }
+    if (event->buttons() & Qt::MiddleButton) {
+        zoomCamera(std::pow(1.2f, delta.y() / 80.0f));
+        rot.rotate(anglex, m_cameraRef - m_cameraEye);
+    }
+    m_cameraUp = rot * m_cameraUp;
+
+    event->accept();
+    renderLater();
+}
+
+void LidarGLWindow::wheelEvent(QWheelEvent* event)
+{
+    zoomCamera(std::pow(1.2f, -event->angleDelta().y() / 120.0f));
+    event->accept();
+    renderLater();
+}
+
+void LidarGLWindow::keyPressEvent(QKeyEvent* event)
+{
+    QVector3D const side = QVector3D::crossProduct(m_cameraRef - m_cameraEye, m_cameraUp).normalized();
+
+    switch (event->key()) {
+    case Qt::Key_Up:
+        moveCamera(m_cameraUp * kTranslateStep);
+        break;
+    case Qt::Key_Down:
+        moveCamera(m_cameraUp * -kTranslateStep);
+        break;
+    case Qt::Key_Left:
+        moveCamera(side * -kTranslateStep);
+        break;
+    case Qt::Key_Right:
+        moveCamera(side * kTranslateStep);
+        break;
+
+    case Qt::Key_I:
+    case Qt::Key_Equal:
+    case Qt::Key_Plus:
+        zoomCamera(0.9f);
+        break;
+    case Qt::Key_O:
+    case Qt::Key_Minus:
+        zoomCamera(1.1f);
+        break;
+
+    case Qt::Key_Home:
+        resetView();
+        break;
+
+    case Qt::Key_S:
+        Q_EMIT snapshotRequested();
+        event->accept();
+        return;
+    case Qt::Key_R:
+        Q_EMIT continuousExportToggled();
+        event->accept();
+        return;
+
+    case Qt::Key_F9:
+        TraceRecorder::dump(QString("lidarviewer-trace-%1.json")
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+        event->accept();
+        return;
+
+    default:
+        QWindow::keyPressEvent(event);
+        return;
+    }
+
+    event->accept();
+    renderLater();
+}
@@ -0,0 +1,146 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief 3D view rendered in its own OpenGL window with a core profile
+/// context.
+///
+/// Unlike LidarScene, nothing goes through QGraphicsView: the window owns its
+/// context, draws with shaders and vertex array objects only and renders on
+/// demand, one frame per batch of changes. It shows the sweeps, the ground
+/// image and the grid, with the same camera controls as LidarScene. Streamed
+/// sectors, the lines input, the cluster boxes, picking, the panorama, the
+/// map and the viewports stay on the LidarScene path.
+
+#ifndef LIDARGLWINDOW_H
+#define LIDARGLWINDOW_H
+
+#include "FrameBenchmark.h"
+#include "LidarSweep.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <QColor>
+#include <QList>
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <QPoint>
+#include <QVector3D>
+#include <QWindow>
+#include <vector>
+
+class QExposeEvent;
+class QKeyEvent;
+class QMouseEvent;
+class QOpenGLContext;
+class QOpenGLShaderProgram;
+class QResizeEvent;
+class QWheelEvent;
+
+namespace pacpus
+{
+
+class LidarGLWindow
+    : public QWindow
+    , protected QOpenGLFunctions
+{
+    Q_OBJECT
+
+public:
+    LidarGLWindow(QWindow* parent = 0);
+    ~LidarGLWindow();
+
+public Q_SLOTS:
+    /// Displays a sweep without copying it, the window keeps a reference until the next one
+    void setSweep(LidarSweepPtr const& sweep);
+    /// Image laid on the ground plane, see LidarScene::setGroundImage
+    void setGroundImage(cv::Mat const& image, float cellSize);
+
+    void setLidarEnabled(bool lidarEnabled);
+    void setGridEnabled(bool gridEnabled);
+    void setGroundEnabled(bool groundEnabled);
+
+    /// Measures this many frames once the first sweep is shown, 0 disables
+    void setBenchmarkFrames(int frameCount);
+
+    /// Schedules one frame, several calls before it is drawn give one frame
+    void renderLater();
+
+Q_SIGNALS:
+    /// S key: export the displayed sweep
+    void snapshotRequested();
+    /// R key: start or stop exporting every sweep
+    void continuousExportToggled();
+
+protected:
+    bool event(QEvent* event) /* override */;
+    void exposeEvent(QExposeEvent* event) /* override */;
+    void resizeEvent(QResizeEvent* event) /* override */;
+
+    void mousePressEvent(QMouseEvent* event) /* override */;
+    void mouseMoveEvent(QMouseEvent* event) /* override */;
+    void wheelEvent(QWheelEvent* event) /* override */;
+    void keyPressEvent(QKeyEvent* event) /* override */;
+
+private:
+    /// interleaved position and color of the overlay, as in LidarScene
+    struct ColorVertex {
+        GLfloat x, y, z;
+        GLubyte r, g, b, a;
+    };
+
+    bool initializeGL();
+    void renderNow();
+    void uploadScan();
+    void uploadGround();
+    void buildOverlay();
+    void setColorAttributes(QOpenGLBuffer& buffer);
+
+    void resetView();
+    void zoomCamera(float ratio);
+    void moveCamera(QVector3D const& translation);
+
+    boost::scoped_ptr<QOpenGLContext> m_context;
+    boost::scoped_ptr<QOpenGLShaderProgram> m_colorProgram;
+    /// draws the scan straight from the planes of LidarSweep::points
+    boost::scoped_ptr<QOpenGLShaderProgram> m_scanProgram;
+    boost::scoped_ptr<QOpenGLShaderProgram> m_textureProgram;
+    bool m_updatePending;
+
+    LidarSweepPtr m_sweep;
+    bool m_scanDirty;
+    QOpenGLVertexArrayObject m_scanVao;
+    QOpenGLBuffer m_scanBuffer;
+    int m_scanVertexCount;
+    QList<QColor> m_pointColors;
+
+    /// ground image, shares the buffer of m_sweep when it comes from it
+    cv::Mat m_groundImage;
+    float m_groundCellSize;
+    bool m_groundFromSweep;
+    bool m_groundDirty;
+    QOpenGLVertexArrayObject m_groundVao;
+    QOpenGLBuffer m_groundBuffer;
+    GLuint m_groundTexture;
+    std::vector<unsigned char> m_groundPixels;
+
+    /// frame and grid lines
+    bool m_overlayDirty;
+    QOpenGLVertexArrayObject m_overlayVao;
+    QOpenGLBuffer m_overlayBuffer;
+    int m_overlayVertexCount;
+
+    bool m_displayLidar, m_displayGrid, m_displayGround;
+
+    QVector3D m_cameraEye, m_cameraRef, m_cameraUp;
+    QPoint m_lastMousePos;
+
+    FrameBenchmark m_benchmark;
+    int m_benchmarkFrames;
+};
+
+} // namespace pacpus
+
+#endif // LIDARGLWINDOW_H
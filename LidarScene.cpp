@@ -3,20 +3,30 @@
 // CECILL-C License, Version 1.0.
 // %pacpus:license}
 
+#include "GroundImage.h"
 #include "LidarScene.h"
+#include "LidarTrace.h"
 
 #include <Pacpus/kernel/Log.h>
 
 #include <boost/foreach.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
 #include <QCheckBox>
 #include <QColorDialog>
+#include <QDateTime>
+#include <QComboBox>
 #include <QDialog>
 #include <QGLWidget>
 #include <QGraphicsItem>
 #include <QGraphicsSceneMouseEvent>
 #include <QGraphicsSceneWheelEvent>
 #include <QKeyEvent>
+#include <QLabel>
 #include <QLayout>
+#include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
 #include <QPaintEngine>
 #include <QPainter>
@@ -44,6 +54,26 @@ static const float kGridLineWidth = 0.5;
 
 static const int kTranslateStep = 1;
 
+static const float kDegToRad = 3.14159265f / 180;
+
+/// Range mapped to the end of the panorama color scale [m]
+static const float kPanoramaMaxRange = 70;
+static const float kPanoramaMaxIntensity = 255;
+
+static const QRgb kClusterColor = qRgb(255, 220, 0);
+/// Points of newly occupied voxels, not used by any layer
+static const QRgb kDynamicColor = qRgb(255, 255, 255);
+
+static const int kPickPointSize = 8;
+/// Picking radius around the cursor [px]
+static const float kPickRadius = 6;
+
+/// Streaming latencies are reported every this many sectors
+static const std::size_t kLatencyReportPeriod = 512;
+
+/// Time without camera movement after which full detail is drawn again [ms]
+static const int kIdleDelay = 250;
+
 static const QRgb kDefaultBackgroundColor = qRgb(0.5f,0.8f , 0.7f);
 
 LidarScene::LidarScene(QObject* parent)
@@ -53,14 +83,39 @@ LidarScene::LidarScene(QObject* parent)
     , m_displayGrid(true)
     , mDisplayLines(false)
     , m_displayLidar(true)
+    , m_activeViewport(0)
     , m_fovx(kDefaultFOVX)
     , m_znear(kDefaultZNear)
     , m_zfar(kDefaultZFar)
     , mControls(NULL)
+    , mPickLabel(NULL)
+    , m_displayMode(DM_Points)
+    , m_sweep(new LidarSweep)
+    , m_dirty(DF_Scan | DF_Lines | DF_Overlay | DF_Camera)
+    , m_scanBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_scanVertexCount(0)
+    , m_streaming(false)
+    , m_sectorBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_sectorCount(0)
+    , m_sectorCapacity(0)
+    , m_groundCellSize(0)
+    , m_groundFromSweep(false)
+    , m_displayGround(true)
+    , m_groundTexture(0)
+    , m_displayMap(true)
+    , m_interacting(false)
+    , m_linesBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_linesVertexCount(0)
+    , m_clusterBuffer(QOpenGLBuffer::VertexBuffer)
+    , m_clusterVertexCount(0)
+    , m_displayClusters(true)
+    , m_overlayList(0)
+    , m_panoramaTexture(0)
+    , m_panoramaDirty(false)
 {
     glEnable(GL_BLEND);
 
-    resetView();
+    setViewports(QStringList(QString("top")));
 
     setBackgroundColor(kDefaultBackgroundColor);
 
@@ -69,6 +124,11 @@ LidarScene::LidarScene(QObject* parent)
     }
     mControls.reset(createDialog(tr("Controls"), /*parent=*/ NULL));
 
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(kIdleDelay);
+    connect(&m_idleTimer, &QTimer::timeout, this, &LidarScene::restoreFullDetail);
+    connect(&m_tileCache, &TileCache::tileLoaded, this, &LidarScene::mapTileLoaded);
+
     {
         QCheckBox* lidarCheckBox = new QCheckBox(tr("Show lidar"), /*parent=*/ mControls.get());
         lidarCheckBox->setChecked(m_displayLidar);
@@ -87,6 +147,38 @@ LidarScene::LidarScene(QObject* parent)
         connect(linesCheckBox, &QCheckBox::toggled, this, &LidarScene::setShowLines);
         mControls->layout()->addWidget(linesCheckBox);
     }
+    {
+        QCheckBox* groundCheckBox = new QCheckBox(tr("Show bird's-eye grid"), /*parent=*/ mControls.get());
+        groundCheckBox->setChecked(m_displayGround);
+        connect(groundCheckBox, &QCheckBox::toggled, this, &LidarScene::setGroundEnabled);
+        mControls->layout()->addWidget(groundCheckBox);
+    }
+    {
+        QCheckBox* clustersCheckBox = new QCheckBox(tr("Show clusters"), /*parent=*/ mControls.get());
+        clustersCheckBox->setChecked(m_displayClusters);
+        connect(clustersCheckBox, &QCheckBox::toggled, this, &LidarScene::setClustersEnabled);
+        mControls->layout()->addWidget(clustersCheckBox);
+    }
+    {
+        QCheckBox* mapCheckBox = new QCheckBox(tr("Show map"), /*parent=*/ mControls.get());
+        mapCheckBox->setChecked(m_displayMap);
+        connect(mapCheckBox, &QCheckBox::toggled, this, &LidarScene::setMapEnabled);
+        mControls->layout()->addWidget(mapCheckBox);
+    }
+    {
+        QComboBox* modeComboBox = new QComboBox(/*parent=*/ mControls.get());
+        modeComboBox->addItem(tr("3D points"), DM_Points);
+        modeComboBox->addItem(tr("Panorama: range"), DM_PanoramaRange);
+        modeComboBox->addItem(tr("Panorama: intensity"), DM_PanoramaIntensity);
+        modeComboBox->setCurrentIndex(m_displayMode);
+        connect(modeComboBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &LidarScene::setDisplayMode);
+        mControls->layout()->addWidget(modeComboBox);
+    }
+    {
+        mPickLabel = new QLabel(/*parent=*/ mControls.get());
+        mControls->layout()->addWidget(mPickLabel);
+        updatePickLabel();
+    }
 
     QGraphicsScene::addWidget(mControls.get());
 
@@ -134,29 +226,150 @@ void LidarScene::setBackgroundColor(QColor const& color)
 }
 
 
+void LidarScene::markDirty(int flags, bool visible)
+{
+    m_dirty |= flags;
+    if (visible) {
+        update();
+    }
+}
+
+void LidarScene::cameraMoved()
+{
+    m_interacting = true;
+    m_idleTimer.start();
+    markDirty(DF_Camera);
+}
+
+void LidarScene::restoreFullDetail()
+{
+    m_interacting = false;
+    markDirty(DF_Camera, (m_displayMode == DM_Points) && m_displayLidar);
+}
+
+void LidarScene::setTargetFrameTime(double targetFrameTime)
+{
+    m_governor.setTargetFrameTime(targetFrameTime);
+}
+
+void LidarScene::setMap(TiledMap* map, qint64 memoryBudget)
+{
+    m_tileCache.setMemoryBudget(memoryBudget);
+    m_tileCache.setMap(map);
+    markDirty(DF_Camera);
+}
+
+void LidarScene::setMapEnabled(bool mapEnabled)
+{
+    m_displayMap = mapEnabled;
+    markDirty(DF_Camera);
+}
+
+void LidarScene::setGroundImage(cv::Mat const& image, float cellSize)
+{
+    m_groundImage = image;
+    m_groundCellSize = cellSize;
+    m_groundFromSweep = false;
+    markDirty(DF_Ground, m_displayGround && (m_displayMode == DM_Points));
+}
+
+void LidarScene::setGroundEnabled(bool groundEnabled)
+{
+    m_displayGround = groundEnabled;
+    markDirty(DF_Camera);
+}
+
+void LidarScene::setClustersEnabled(bool clustersEnabled)
+{
+    m_displayClusters = clustersEnabled;
+    markDirty(DF_Camera);
+}
+
+void LidarScene::mapTileLoaded()
+{
+    markDirty(DF_Camera, m_displayMap && (m_displayMode == DM_Points));
+}
+
 void LidarScene::setLines(LineCloud3D const& lines)
 {
     mLines = lines;
+    markDirty(DF_Lines, (m_displayMode == DM_Points) && mDisplayLines);
 }
 
 void LidarScene::setScan(LidarScan const& scan)
 {
-    m_scan = scan;
+    QSharedPointer<LidarSweep> sweep(new LidarSweep);
+    sweep->scan = scan;
+    sweep->points.fromScan(scan);
+    setSweep(sweep);
+}
+
+void LidarScene::setSweep(LidarSweepPtr const& sweep)
+{
+    m_sweep = sweep;
+    mPicker.setSweep(m_sweep);
+    m_panoramaDirty = true;
+    if (!m_sweep->birdEye.empty()) {
+        setGroundImage(m_sweep->birdEye, m_sweep->birdEyeCellSize);
+        m_groundFromSweep = true;
+    } else if (m_groundFromSweep) {
+        // the buffer goes back to the pool with the previous sweep
+        m_groundImage.release();
+        m_groundFromSweep = false;
+    }
+    if (!m_sweep->clusters.empty() || (m_clusterVertexCount > 0)) {
+        markDirty(DF_Clusters, m_displayClusters && (m_displayMode == DM_Points));
+    }
+    // the sweeps of the other inputs are drawn whole again
+    m_streaming = m_sweep->streamed;
+    bool const visible = (m_displayMode == DM_Points) ? m_displayLidar : true;
+    if (m_streaming) {
+        // points are already displayed sector by sector, the scan is only
+        // uploaded for its dynamic points
+        if (!m_sweep->dynamic.empty() || !m_dynamicIndices.empty()) {
+            markDirty(DF_Scan, visible);
+        } else {
+            markDirty(DF_None, m_displayMode != DM_Points);
+        }
+        return;
+    }
+    markDirty(DF_Scan, visible);
+}
+
+void LidarScene::setSector(LidarSectorPtr const& sector)
+{
+    m_streaming = true;
+    if (static_cast<int>(m_pendingSectors.size()) != sector->sectorCount) {
+        m_pendingSectors.assign(sector->sectorCount, LidarSectorPtr());
+    }
+    m_pendingSectors[sector->index] = sector;
+    markDirty(DF_Sectors, (m_displayMode == DM_Points) && m_displayLidar);
+}
+
+void LidarScene::setDisplayMode(int mode)
+{
+    m_displayMode = static_cast<DisplayMode>(mode);
+    // same range image, only the coloring changes
+    m_panoramaDirty = true;
+    markDirty(DF_Camera);
 }
 
 void LidarScene::setShowLines(bool showLines)
 {
     mDisplayLines = showLines;
+    markDirty(DF_Camera);
 }
 
 void LidarScene::setGridEnabled(bool gridEnabled)
 {
     m_displayGrid = gridEnabled;
+    markDirty(DF_Overlay);
 }
 
 void LidarScene::setLidarEnabled(bool lidarEnabled)
 {
     m_displayLidar = lidarEnabled;
+    markDirty(DF_Camera);
 }
 
 //void LidarScene::drawForeground(QPainter* /*painter*/, QRectF const& /*rect*/)
@@ -165,6 +378,8 @@ void LidarScene::setLidarEnabled(bool lidarEnabled)
 
 void LidarScene::drawBackground(QPainter* painter, QRectF const& /*rect*/)
 {
+    LIDAR_TRACE_SCOPE("LidarScene::drawBackground");
+
     if ((painter->paintEngine()->type() != QPaintEngine::OpenGL)
         && (painter->paintEngine()->type() != QPaintEngine::OpenGL2)) {
         LOG_WARN("LidarScene: drawBackground needs a QGLWidget to be set as viewport on the graphics view");
@@ -174,58 +389,228 @@ void LidarScene::drawBackground(QPainter* painter, QRectF const& /*rect*/)
     glClearColor(m_backgroundColor.redF(), m_backgroundColor.greenF(), m_backgroundColor.blueF(), 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    if (m_displayMode != DM_Points) {
+        drawPanorama();
+        return;
+    }
+
+    m_frameTimer.start();
+    int pointsDrawn = 0;
+
+    // buffers are only rebuilt when their content changed,
+    // a camera change re-issues the draws of the uploaded buffers
+    if (m_dirty & DF_Overlay) {
+        compileOverlay();
+    }
+    if ((m_dirty & DF_Scan) && m_displayLidar) {
+        uploadScan();
+    }
+    if ((m_dirty & DF_Sectors) && m_displayLidar) {
+        uploadSectors();
+    }
+    if ((m_dirty & DF_Lines) && mDisplayLines) {
+        uploadLines();
+    }
+    if ((m_dirty & DF_Clusters) && m_displayClusters) {
+        uploadClusters();
+    }
+    m_dirty &= ~DF_Camera;
+
+    // all viewports draw the same buffers, each one only costs its draw calls
+    Viewport& active = m_viewports[m_activeViewport];
+    active.eye = m_cameraEye;
+    active.ref = m_cameraRef;
+    active.up = m_cameraUp;
+    for (int i = 0; i < static_cast<int>(m_viewports.size()); ++i) {
+        pointsDrawn += drawViewport(i);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, static_cast<GLsizei>(width()), static_cast<GLsizei>(height()));
+
+    // The governor only decimates while the camera moves. Only then wait
+    // for the GPU to measure the real cost of the frame: an idle frame must
+    // not stall the GUI thread.
+    if (m_interacting) {
+        glFinish();
+        m_governor.addFrame(m_frameTimer.nsecsElapsed() / 1e6, pointsDrawn);
+    }
+
+    if (!m_sectorArrivals.empty()) {
+        recordSectorLatencies();
+    }
+}
+
+/// Initial camera of a viewport preset, false for an unknown preset
+static bool presetCamera(QString const& preset, QVector3D& eye, QVector3D& ref, QVector3D& up)
+{
+    if (preset == "top") {
+        // camera eye above the center point
+        eye = QVector3D(0, 0, 50);
+        // looking at the center point
+        ref = QVector3D(0, 0, 0);
+        // FIXME: up vector?
+        up = QVector3D(1, 0, 0);
+    } else if (preset == "side") {
+        // from the left of the sensor, X axis to the right
+        eye = QVector3D(0, 60, 5);
+        ref = QVector3D(0, 0, 0);
+        up = QVector3D(0, 0, 1);
+    } else if (preset == "chase") {
+        // behind and above the sensor, looking ahead along X
+        eye = QVector3D(-20, 0, 8);
+        ref = QVector3D(15, 0, 0);
+        up = QVector3D(0, 0, 1);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int LidarScene::drawViewport(int index)
+{
+    Viewport const& viewport = m_viewports[index];
+    bool const active = (index == m_activeViewport);
+    int pointsDrawn = 0;
+
+    // GL window coordinates start at the bottom left corner
+    QRectF const rect = viewportRect(index);
+    GLint const x = static_cast<GLint>(rect.left());
+    GLint const y = static_cast<GLint>(height() - rect.bottom());
+    GLsizei const w = static_cast<GLsizei>(rect.width());
+    GLsizei const h = static_cast<GLsizei>(rect.height());
+    glViewport(x, y, w, h);
+    glScissor(x, y, w, h);
+    glEnable(GL_SCISSOR_TEST);
+
+    QMatrix4x4 projection;
+    projection.perspective(m_fovx, rect.width() / rect.height(), m_znear, m_zfar);
+    // cameras are placed in the sensor frame and follow the sweep pose
+    QMatrix4x4 modelView;
+    modelView.lookAt(/*eye=*/ viewport.eye, /*center=*/ viewport.ref, /*up=*/ viewport.up);
+    QMatrix4x4 const odometryView = modelView * m_sweep->pose.inverted();
+
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     {
-        m_projection.setToIdentity();
-        m_projection.perspective(m_fovx, width() / height(), m_znear, m_zfar);
-        glLoadMatrixf(m_projection.data());
+        glLoadMatrixf(projection.data());
 
         glMatrixMode(GL_MODELVIEW);
         glPushMatrix();
         {
-            m_modelView.setToIdentity();
-            m_modelView.lookAt(/*eye=*/ m_cameraEye, /*center=*/ m_cameraRef, /*up=*/ m_cameraUp);
-            glLoadMatrixf(m_modelView.data());
-
+            glLoadMatrixf(odometryView.data());
+
+            // ground image first, everything else is drawn over it
+            if (m_displayGround && !m_groundImage.empty()) {
+                // the grid of a sweep moves with it
+                glPushMatrix();
+                if (m_groundFromSweep) {
+                    glMultMatrixf(m_sweep->pose.constData());
+                }
+                drawGround();
+                glPopMatrix();
+            }
             // draw scale
             //drawScale(painter, kFrameLength);
-            // draw XYZ-axis frame
-            drawFrame(kFrameLineWidth, kFrameLength);
-            // draw camera target point
-            if (m_displayCamera) {
-                drawCameraTargetPoint();
-            }
-            // draw grid
-            if (m_displayGrid) {
-                drawGrid(kGridLength, kGridStep, kGridLineWidth);
-            }
-            // draw lidar scan
-            if (m_displayLidar) {
-                drawScan();
+            // draw XYZ-axis frame and grid
+            glCallList(m_overlayList);
+            // resident map tiles, the missing ones are loaded in the background
+            // around the camera of the active viewport
+            if (m_displayMap) {
+                if (active) {
+                    m_tileCache.update(projection * odometryView, m_sweep->pose.map(viewport.eye));
+                }
+                glPointSize(1);
+                pointsDrawn += m_tileCache.draw();
             }
-            if (mDisplayLines) {
-                drawLines();
+            // the sensor frame at the pose of the sweep, the map and the frame
+            // stay in the odometry frame. The streamed sectors and the lines
+            // are drawn at the same pose as the sweep and the camera.
+            glPushMatrix();
+            glMultMatrixf(m_sweep->pose.constData());
+            {
+                // draw camera target point
+                if (m_displayCamera && active) {
+                    drawCameraTargetPoint();
+                }
+                if (mDisplayLines) {
+                    drawLines();
+                }
+                // draw lidar scan
+                if (m_displayLidar) {
+                    pointsDrawn += drawScan();
+                }
+                if (m_displayClusters) {
+                    drawClusters();
+                }
+                if (!mPicks.isEmpty()) {
+                    drawPicks();
+                }
             }
+            glPopMatrix();
         }
         glPopMatrix();
         glMatrixMode(GL_PROJECTION);
     }
     glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    return pointsDrawn;
 }
 
 void LidarScene::resetView()
 {
-    // camera eye above the center point
-    m_cameraEye = QVector3D(0, 0, 50);
-    // looking at the center point
-    m_cameraRef = QVector3D(0, 0, 0);
-    // FIXME: up vector?
-    m_cameraUp = QVector3D(1, 0, 0);
+    presetCamera(m_viewports[m_activeViewport].preset, m_cameraEye, m_cameraRef, m_cameraUp);
+}
+
+bool LidarScene::setViewports(QStringList const& presets)
+{
+    if (presets.isEmpty()) {
+        return false;
+    }
+    std::vector<Viewport> viewports(presets.size());
+    for (int i = 0; i < presets.size(); ++i) {
+        Viewport& viewport = viewports[i];
+        viewport.preset = presets[i].trimmed();
+        if (!presetCamera(viewport.preset, viewport.eye, viewport.ref, viewport.up)) {
+            return false;
+        }
+    }
+    m_viewports.swap(viewports);
+    m_activeViewport = 0;
+    m_cameraEye = m_viewports[0].eye;
+    m_cameraRef = m_viewports[0].ref;
+    m_cameraUp = m_viewports[0].up;
+    markDirty(DF_Camera);
+    return true;
+}
+
+QRectF LidarScene::viewportRect(int index) const
+{
+    // side by side, full height
+    qreal const viewportWidth = width() / m_viewports.size();
+    return QRectF(index * viewportWidth, 0, viewportWidth, height());
+}
+
+void LidarScene::activateViewportAt(QPointF const& scenePos)
+{
+    int const index = std::max(0, std::min(static_cast<int>(m_viewports.size()) - 1,
+                                           static_cast<int>(scenePos.x() * m_viewports.size() / width())));
+    if (index == m_activeViewport) {
+        return;
+    }
+    // the active camera lives in m_cameraEye, m_cameraRef and m_cameraUp
+    Viewport& previous = m_viewports[m_activeViewport];
+    previous.eye = m_cameraEye;
+    previous.ref = m_cameraRef;
+    previous.up = m_cameraUp;
+    m_activeViewport = index;
+    m_cameraEye = m_viewports[index].eye;
+    m_cameraRef = m_viewports[index].ref;
+    m_cameraUp = m_viewports[index].up;
 }
 
 void LidarScene::mouseMoveEvent(QGraphicsSceneMouseEvent* mmEvent)
 {
+    LIDAR_TRACE_SCOPE("LidarScene::mouseMoveEvent");
     QGraphicsScene::mouseMoveEvent(mmEvent);
     if (mmEvent->isAccepted()) {
         return;
@@ -267,23 +652,33 @@ void LidarScene::mouseMoveEvent(QGraphicsSceneMouseEvent* mmEvent)
     m_cameraUp = rot * m_cameraUp;
 
     mmEvent->accept();
-    update();
+    cameraMoved();
 }
 
 void LidarScene::mousePressEvent(QGraphicsSceneMouseEvent* event)
 {
+    LIDAR_TRACE_SCOPE("LidarScene::mousePressEvent");
     QGraphicsScene::mousePressEvent(event);
     if (event->isAccepted()) {
         return;
     }
 
+    activateViewportAt(event->scenePos());
+    if ((event->button() == Qt::LeftButton) && (event->modifiers() & Qt::ControlModifier)) {
+        pickAt(event->scenePos());
+        event->accept();
+        markDirty(DF_Camera);
+        return;
+    }
+
     m_displayCamera = true;
     event->accept();
-    update();
+    markDirty(DF_Camera);
 }
 
 void LidarScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 {
+    LIDAR_TRACE_SCOPE("LidarScene::mouseReleaseEvent");
     QGraphicsScene::mouseReleaseEvent(event);
     if (event->isAccepted()) {
         return;
@@ -291,25 +686,28 @@ void LidarScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event)
 
     m_displayCamera = false;
     event->accept();
-    update();
+    markDirty(DF_Camera);
 }
 
 void LidarScene::wheelEvent(QGraphicsSceneWheelEvent* wEvent)
 {
+    LIDAR_TRACE_SCOPE("LidarScene::wheelEvent");
     QGraphicsScene::wheelEvent(wEvent);
     if (wEvent->isAccepted()) {
         return;
     }
 
+    activateViewportAt(wEvent->scenePos());
     float ratio = std::pow(1.2, -wEvent->delta() / 120);
     zoomCamera(ratio);
 
     wEvent->accept();
-    update();
+    cameraMoved();
 }
 
 void LidarScene::keyPressEvent(QKeyEvent* kEvent)
 {
+    LIDAR_TRACE_SCOPE("LidarScene::keyPressEvent");
     QGraphicsScene::keyPressEvent(kEvent);
     if (kEvent->isAccepted()) {
         return;
@@ -346,19 +744,39 @@ void LidarScene::keyPressEvent(QKeyEvent* kEvent)
         resetView();
         break;
 
+    case Qt::Key_Escape:
+        clearPicks();
+        break;
+
+    case Qt::Key_S:
+        Q_EMIT snapshotRequested();
+        kEvent->accept();
+        return;
+    case Qt::Key_R:
+        Q_EMIT continuousExportToggled();
+        kEvent->accept();
+        return;
+
+    case Qt::Key_F9:
+        TraceRecorder::dump(QString("lidarviewer-trace-%1.json")
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")));
+        kEvent->accept();
+        return;
+
     default:
-        // other key
+        // other key, nothing to redraw
         LOG_DEBUG("other key pressed:" << keyCode);
-        break;
+        kEvent->accept();
+        return;
     }
 
     kEvent->accept();
-    update();
+    cameraMoved();
 }
 
 void LidarScene::zoomCamera(float ratio)
 {
-    LOG_INFO("zoom camera by ratio: " << ratio);
+    LIDAR_TRACE_INSTANT("zoomCamera");
     QVector3D viewVector = m_cameraRef - m_cameraEye;
     m_cameraEye = m_cameraRef - viewVector * ratio;
 }
@@ -369,11 +787,11 @@ void LidarScene::moveCameraSideways(CameraMovement movement)
 
     switch (movement) {
     case CM_Right:
-        LOG_INFO("move camera right");
+        LIDAR_TRACE_INSTANT("moveCameraRight");
         translationStep = kTranslateStep;
         break;
     case CM_Left:
-        LOG_INFO("move camera left");
+        LIDAR_TRACE_INSTANT("moveCameraLeft");
         translationStep = -kTranslateStep;
         break;
     default:
@@ -392,11 +810,11 @@ void LidarScene::moveCameraUpDown(CameraMovement movement)
 
     switch (movement) {
     case CM_Up:
-        LOG_INFO("move camera up");
+        LIDAR_TRACE_INSTANT("moveCameraUp");
         translationStep = kTranslateStep;
         break;
     case CM_Down:
-        LOG_INFO("move camera down");
+        LIDAR_TRACE_INSTANT("moveCameraDown");
         translationStep = -kTranslateStep;
         break;
     default:
@@ -408,6 +826,71 @@ void LidarScene::moveCameraUpDown(CameraMovement movement)
     m_cameraRef += m_cameraUp * translationStep;
 }
 
+void LidarScene::pickAt(QPointF const& scenePos)
+{
+    // cursor ray from the near to the far clipping plane of the active viewport
+    QRectF const viewport = viewportRect(m_activeViewport);
+    float const x = 2.0f * (scenePos.x() - viewport.left()) / viewport.width() - 1.0f;
+    float const y = 1.0f - 2.0f * (scenePos.y() - viewport.top()) / viewport.height();
+    // camera of the active viewport as drawViewport() sets it, it may have
+    // been activated by this very click, after the last paint
+    QMatrix4x4 projection;
+    projection.perspective(m_fovx, viewport.width() / viewport.height(), m_znear, m_zfar);
+    QMatrix4x4 modelView;
+    modelView.lookAt(/*eye=*/ m_cameraEye, /*center=*/ m_cameraRef, /*up=*/ m_cameraUp);
+    // picked in the sensor frame of the sweep, where the camera is placed
+    QMatrix4x4 const inverse = (projection * modelView).inverted();
+    QVector3D const nearPoint = inverse * QVector3D(x, y, -1);
+    QVector3D const farPoint = inverse * QVector3D(x, y, 1);
+
+    // angular size of the picking radius
+    float const tanTolerance = kPickRadius * 2 * std::tan(m_fovx / 2 * kDegToRad) / viewport.height();
+
+    PickResult result;
+    if (!mPicker.pick(nearPoint, farPoint - nearPoint, tanTolerance, result)) {
+        LOG_DEBUG("no point under the cursor");
+        return;
+    }
+    if (mPicks.size() >= 2) {
+        mPicks.clear();
+    }
+    mPicks.append(result);
+    updatePickLabel();
+}
+
+void LidarScene::clearPicks()
+{
+    mPicks.clear();
+    updatePickLabel();
+}
+
+void LidarScene::updatePickLabel()
+{
+    if (!mPickLabel) {
+        return;
+    }
+    if (mPicks.isEmpty()) {
+        mPickLabel->setText(tr("Ctrl+click: pick a point\nEsc: clear"));
+        return;
+    }
+
+    QString text;
+    for (int i = 0; i < mPicks.size(); ++i) {
+        PickResult const& pick = mPicks[i];
+        text += tr("Point %1: range %2 m, intensity %3, layer %4\n")
+            .arg(i + 1)
+            .arg(pick.range, 0, 'f', 2)
+            .arg(pick.intensity)
+            .arg(pick.layer);
+    }
+    if (mPicks.size() == 2) {
+        QVector3D const a(mPicks[0].x, mPicks[0].y, mPicks[0].z);
+        QVector3D const b(mPicks[1].x, mPicks[1].y, mPicks[1].z);
+        text += tr("Distance: %1 m").arg((b - a).length(), 0, 'f', 2);
+    }
+    mPickLabel->setText(text.trimmed());
+}
+
 void LidarScene::drawCameraTargetPoint()
 {
     glPointSize(kCameraTargetPointSize);
@@ -421,75 +904,506 @@ void LidarScene::drawCameraTargetPoint()
     glDisable(GL_POINT_SMOOTH);
 }
 
+void LidarScene::drawPicks()
+{
+    glPointSize(kPickPointSize);
+    glColor3f(1.0, 1.0, 0.0);
+
+    glEnable(GL_POINT_SMOOTH);
+    glBegin(GL_POINTS);
+    BOOST_FOREACH(PickResult const& pick, mPicks) {
+        glVertex3f(pick.x, pick.y, pick.z);
+    }
+    glEnd();
+    glDisable(GL_POINT_SMOOTH);
+
+    if (mPicks.size() == 2) {
+        glBegin(GL_LINES);
+        glVertex3f(mPicks[0].x, mPicks[0].y, mPicks[0].z);
+        glVertex3f(mPicks[1].x, mPicks[1].y, mPicks[1].z);
+        glEnd();
+    }
+}
+
+void LidarScene::drawPanorama()
+{
+    if (m_sweep->image.size() == 0) {
+        return;
+    }
+
+    if (!m_panoramaTexture) {
+        glGenTextures(1, &m_panoramaTexture);
+        glBindTexture(GL_TEXTURE_2D, m_panoramaTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, m_panoramaTexture);
+    }
+    if (m_panoramaDirty) {
+        updatePanoramaTexture();
+        m_panoramaDirty = false;
+    }
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, 1, 0, 1, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // azimuth from left to right, lowest laser at the bottom
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1.0, 1.0, 1.0);
+    glBegin(GL_QUADS);
+    {
+        glTexCoord2f(0, 0);
+        glVertex2f(0, 0);
+        glTexCoord2f(1, 0);
+        glVertex2f(1, 0);
+        glTexCoord2f(1, 1);
+        glVertex2f(1, 1);
+        glTexCoord2f(0, 1);
+        glVertex2f(0, 1);
+    }
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+/// Jet-like color scale, value in [0, 1]
+static void panoramaColor(float value, unsigned char* rgba)
+{
+    float const r = 1.5f - std::fabs(4 * value - 3);
+    float const g = 1.5f - std::fabs(4 * value - 2);
+    float const b = 1.5f - std::fabs(4 * value - 1);
+    rgba[0] = static_cast<unsigned char>(255 * std::min(1.0f, std::max(0.0f, r)));
+    rgba[1] = static_cast<unsigned char>(255 * std::min(1.0f, std::max(0.0f, g)));
+    rgba[2] = static_cast<unsigned char>(255 * std::min(1.0f, std::max(0.0f, b)));
+    rgba[3] = 255;
+}
+
+void LidarScene::updatePanoramaTexture()
+{
+    int const rows = m_sweep->image.rows();
+    int const cols = m_sweep->image.cols();
+
+    // texture rows sorted by elevation, lasers are interleaved in the raw data
+    std::vector<std::pair<float, int> > rowOrder(rows);
+    for (int row = 0; row < rows; ++row) {
+        rowOrder[row] = std::make_pair(m_sweep->image.rowAngle(row), row);
+    }
+    std::sort(rowOrder.begin(), rowOrder.end());
+
+    bool const byRange = (m_displayMode == DM_PanoramaRange);
+    float const scale = 1.0f / (byRange ? kPanoramaMaxRange : kPanoramaMaxIntensity);
+
+    m_panoramaPixels.resize(4 * rows * cols);
+    unsigned char* pixel = &m_panoramaPixels[0];
+    for (int i = 0; i < rows; ++i) {
+        int const row = rowOrder[i].second;
+        float const* values = byRange ? m_sweep->image.rangeRow(row) : m_sweep->image.intensityRow(row);
+        unsigned char const* valid = m_sweep->image.validRow(row);
+        for (int col = 0; col < cols; ++col, pixel += 4) {
+            if (valid[col]) {
+                panoramaColor(values[col] * scale, pixel);
+            } else {
+                pixel[0] = pixel[1] = pixel[2] = 0;
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, cols, rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, &m_panoramaPixels[0]);
+}
+
+void LidarScene::drawGround()
+{
+    if (!m_groundTexture) {
+        glGenTextures(1, &m_groundTexture);
+        glBindTexture(GL_TEXTURE_2D, m_groundTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, m_groundTexture);
+    }
+    if (m_dirty & DF_Ground) {
+        updateGroundTexture();
+        m_dirty &= ~DF_Ground;
+        if (m_groundImage.empty()) {
+            glBindTexture(GL_TEXTURE_2D, 0);
+            return;
+        }
+    }
+
+    float const halfX = 0.5f * m_groundCellSize * m_groundImage.cols;
+    float const halfY = 0.5f * m_groundCellSize * m_groundImage.rows;
+
+    // empty cells are transparent
+    glEnable(GL_ALPHA_TEST);
+    glAlphaFunc(GL_GREATER, 0);
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1.0, 1.0, 1.0);
+    glBegin(GL_QUADS);
+    {
+        glTexCoord2f(0, 0);
+        glVertex3f(-halfX, -halfY, 0);
+        glTexCoord2f(1, 0);
+        glVertex3f(halfX, -halfY, 0);
+        glTexCoord2f(1, 1);
+        glVertex3f(halfX, halfY, 0);
+        glTexCoord2f(0, 1);
+        glVertex3f(-halfX, halfY, 0);
+    }
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_ALPHA_TEST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LidarScene::updateGroundTexture()
+{
+    if (!groundImageToRgba(m_groundImage, m_groundPixels)) {
+        LOG_WARN("unsupported ground image type " << m_groundImage.type());
+        m_groundImage.release();
+        return;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, m_groundImage.cols, m_groundImage.rows, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, &m_groundPixels[0]);
+}
+
+void LidarScene::uploadLines()
+{
+    m_linesVertices.clear();
+    m_linesVertices.reserve(6 * mLines.size());
+    BOOST_FOREACH(Line3D const& line, mLines) {
+        m_linesVertices.push_back(line.start.x);
+        m_linesVertices.push_back(line.start.y);
+        m_linesVertices.push_back(line.start.z);
+        m_linesVertices.push_back(line.end.x);
+        m_linesVertices.push_back(line.end.y);
+        m_linesVertices.push_back(line.end.z);
+    }
+    m_linesVertexCount = static_cast<int>(m_linesVertices.size() / 3);
+
+    if (!m_linesBuffer.isCreated()) {
+        m_linesBuffer.create();
+        m_linesBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    }
+    m_linesBuffer.bind();
+    m_linesBuffer.allocate(m_linesVertices.empty() ? NULL : &m_linesVertices[0],
+                           static_cast<int>(m_linesVertices.size() * sizeof(GLfloat)));
+    m_linesBuffer.release();
+
+    m_dirty &= ~DF_Lines;
+}
+
 void LidarScene::drawLines()
 {
+    if (m_linesVertexCount == 0) {
+        return;
+    }
     // TODO
     //glLineWidth(kLineWidth);
+    glColor3f(1.0, 1.0, 1.0);
 
     glEnable(GL_LINE_SMOOTH);
-    glBegin(GL_LINES);
-    // set color for the layer
-    //QColor const& color = m_pointColors[layer.id % m_pointColors.size()];
-    //glColor3f(color.redF(), color.greenF(), color.blueF());
-    BOOST_FOREACH(Line3D const& line, mLines) {
-        {
-            Point3D const& point = line.start;
-            glVertex3f(point.x, point.y, point.z);
+    m_linesBuffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+    glDrawArrays(GL_LINES, 0, m_linesVertexCount);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    m_linesBuffer.release();
+    glDisable(GL_LINE_SMOOTH);
+}
+
+void LidarScene::uploadClusters()
+{
+    // 12 edges per box
+    static const int kEdges[12][2] = {
+        {0, 1}, {1, 3}, {3, 2}, {2, 0},
+        {4, 5}, {5, 7}, {7, 6}, {6, 4},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}
+    };
+    std::vector<ClusterBox> const& clusters = m_sweep->clusters;
+    m_clusterVertices.resize(clusters.size() * 12 * 2 * 3);
+    GLfloat* vertex = m_clusterVertices.empty() ? NULL : &m_clusterVertices[0];
+    BOOST_FOREACH(ClusterBox const& box, clusters) {
+        for (int e = 0; e < 12; ++e) {
+            for (int end = 0; end < 2; ++end) {
+                // corner bits: X, Y, Z
+                int const corner = kEdges[e][end];
+                *vertex++ = (corner & 1) ? box.maxX : box.minX;
+                *vertex++ = (corner & 2) ? box.maxY : box.minY;
+                *vertex++ = (corner & 4) ? box.maxZ : box.minZ;
+            }
         }
-        {
-            Point3D const& point = line.end;
-            glVertex3f(point.x, point.y, point.z);
+    }
+    m_clusterVertexCount = static_cast<int>(m_clusterVertices.size() / 3);
+
+    if (!m_clusterBuffer.isCreated()) {
+        m_clusterBuffer.create();
+        m_clusterBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    }
+    m_clusterBuffer.bind();
+    m_clusterBuffer.allocate(m_clusterVertices.empty() ? NULL : &m_clusterVertices[0],
+                             static_cast<int>(m_clusterVertices.size() * sizeof(GLfloat)));
+    m_clusterBuffer.release();
+
+    m_dirty &= ~DF_Clusters;
+}
+
+void LidarScene::drawClusters()
+{
+    if (m_clusterVertexCount == 0) {
+        return;
+    }
+    QColor const color(kClusterColor);
+    glColor3f(color.redF(), color.greenF(), color.blueF());
+
+    m_clusterBuffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+    glDrawArrays(GL_LINES, 0, m_clusterVertexCount);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    m_clusterBuffer.release();
+}
+
+void LidarScene::uploadScan()
+{
+    // the fixed pipeline wants interleaved positions, packed from the planes
+    AlignedScan const& points = m_sweep->points;
+    size_t const pointCount = points.size();
+    m_scanVertices.resize(pointCount);
+    float const* x = points.x();
+    float const* y = points.y();
+    float const* z = points.z();
+    BOOST_FOREACH(AlignedScan::Layer const& layer, points.layers()) {
+        // set color for the layer
+        QColor const& color = m_pointColors[layer.id % 10];
+        ScanVertex vertex;
+        vertex.r = static_cast<GLubyte>(color.red());
+        vertex.g = static_cast<GLubyte>(color.green());
+        vertex.b = static_cast<GLubyte>(color.blue());
+        vertex.a = 255;
+        for (size_t i = layer.begin; i < layer.end; ++i) {
+            vertex.x = x[i];
+            vertex.y = y[i];
+            vertex.z = z[i];
+            m_scanVertices[i] = vertex;
         }
     }
-    glEnd();
-    glDisable(GL_LINE_SMOOTH);
+    m_scanVertexCount = static_cast<int>(pointCount);
+
+    std::vector<unsigned char> const& dynamic = m_sweep->dynamic;
+    m_dynamicIndices.clear();
+    if (dynamic.size() == pointCount) {
+        QColor const dynamicColor(kDynamicColor);
+        for (size_t i = 0; i < pointCount; ++i) {
+            if (dynamic[i]) {
+                ScanVertex& moving = m_scanVertices[i];
+                moving.r = static_cast<GLubyte>(dynamicColor.red());
+                moving.g = static_cast<GLubyte>(dynamicColor.green());
+                moving.b = static_cast<GLubyte>(dynamicColor.blue());
+                m_dynamicIndices.push_back(static_cast<GLuint>(i));
+            }
+        }
+    }
+
+    if (!m_scanBuffer.isCreated()) {
+        m_scanBuffer.create();
+        m_scanBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    }
+    m_scanBuffer.bind();
+    m_scanBuffer.allocate(m_scanVertices.empty() ? NULL : &m_scanVertices[0],
+                          static_cast<int>(m_scanVertices.size() * sizeof(ScanVertex)));
+    m_scanBuffer.release();
+
+    m_dirty &= ~DF_Scan;
 }
 
-void LidarScene::drawScan()
+void LidarScene::uploadSectors()
 {
+    if (!m_sectorBuffer.isCreated()) {
+        m_sectorBuffer.create();
+        m_sectorBuffer.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    }
+    m_sectorBuffer.bind();
+    for (size_t s = 0; s < m_pendingSectors.size(); ++s) {
+        LidarSectorPtr const sector = m_pendingSectors[s];
+        if (!sector) {
+            continue;
+        }
+        m_pendingSectors[s].clear();
+
+        if ((sector->sectorCount != m_sectorCount) || (sector->capacity != m_sectorCapacity)) {
+            m_sectorCount = sector->sectorCount;
+            m_sectorCapacity = sector->capacity;
+            m_sectorBuffer.allocate(m_sectorCount * m_sectorCapacity * static_cast<int>(sizeof(ScanVertex)));
+            m_sectorVertexCounts.assign(m_sectorCount, 0);
+            m_sectorRevolutions.assign(m_sectorCount, 0);
+        }
+
+        int const count = std::min(static_cast<int>(sector->points.size()), m_sectorCapacity);
+        m_scanVertices.resize(count);
+        for (int i = 0; i < count; ++i) {
+            LidarSector::Point const& point = sector->points[i];
+            QColor const& color = m_pointColors[point.layer % 10];
+            ScanVertex& vertex = m_scanVertices[i];
+            vertex.x = point.x;
+            vertex.y = point.y;
+            vertex.z = point.z;
+            vertex.r = static_cast<GLubyte>(color.red());
+            vertex.g = static_cast<GLubyte>(color.green());
+            vertex.b = static_cast<GLubyte>(color.blue());
+            vertex.a = 255;
+        }
+        if (count > 0) {
+            m_sectorBuffer.write(sector->index * m_sectorCapacity * static_cast<int>(sizeof(ScanVertex)),
+                                 &m_scanVertices[0], count * static_cast<int>(sizeof(ScanVertex)));
+        }
+        m_sectorVertexCounts[sector->index] = count;
+        m_sectorRevolutions[sector->index] = sector->revolution;
+        m_sectorArrivals.push_back(sector->arrivalTime);
+    }
+    m_sectorBuffer.release();
+
+    // The sectors of a revolution arrive by increasing index. A slot behind
+    // the newest sector that still holds an older revolution, or one more
+    // than a revolution old, lost its sector in the queue: clear it rather
+    // than show stale points.
+    unsigned int newestRevolution = 0;
+    int newestSector = 0;
+    for (int s = 0; s < m_sectorCount; ++s) {
+        if (m_sectorRevolutions[s] >= newestRevolution) {
+            newestRevolution = m_sectorRevolutions[s];
+            newestSector = s;
+        }
+    }
+    for (int s = 0; s < m_sectorCount; ++s) {
+        unsigned int const age = newestRevolution - m_sectorRevolutions[s];
+        if ((age > 1) || ((age == 1) && (s < newestSector))) {
+            m_sectorVertexCounts[s] = 0;
+        }
+    }
+
+    m_dirty &= ~DF_Sectors;
+}
+
+void LidarScene::recordSectorLatencies()
+{
+    // the frame has been submitted, and finished by the GPU while interacting
+    qint64 const now = TraceRecorder::now();
+    BOOST_FOREACH(qint64 arrivalTime, m_sectorArrivals) {
+        m_sectorLatencies.push_back(now - arrivalTime);
+    }
+    m_sectorArrivals.clear();
+
+    if (m_sectorLatencies.size() >= kLatencyReportPeriod) {
+        std::vector<qint64>::iterator median = m_sectorLatencies.begin() + m_sectorLatencies.size() / 2;
+        std::nth_element(m_sectorLatencies.begin(), median, m_sectorLatencies.end());
+        qint64 const maxLatency = *std::max_element(median, m_sectorLatencies.end());
+        LOG_INFO("streaming latency: median=" << *median / 1e6 << " ms max=" << maxLatency / 1e6
+            << " ms over " << m_sectorLatencies.size() << " sectors");
+        m_sectorLatencies.clear();
+    }
+}
+
+int LidarScene::drawScan()
+{
+    int pointCount = m_scanVertexCount;
+    if (m_streaming) {
+        if (!m_sectorBuffer.isCreated()) {
+            return 0;
+        }
+        pointCount = 0;
+        for (int s = 0; s < m_sectorCount; ++s) {
+            pointCount += m_sectorVertexCounts[s];
+        }
+    }
+    if ((pointCount == 0) && m_dynamicIndices.empty()) {
+        return 0;
+    }
+    // decimated while the camera moves, every point once it rests
+    int const stride = m_interacting ? m_governor.stride(pointCount) : 1;
+    int pointsDrawn = 0;
+
+    QOpenGLBuffer& buffer = m_streaming ? m_sectorBuffer : m_scanBuffer;
     glPointSize(m_pointSize);
 
     glEnable(GL_POINT_SMOOTH);
-  
-    BOOST_FOREACH(LidarLayer const& layer, m_scan.layers) {
-        // set color for the layer
-		  glBegin(GL_POINTS);
-		  glShadeModel(GL_SMOOTH); 
-			int col_id=layer.id%10;
-			QColor const& color = m_pointColors[col_id];
-			//LOG_INFO(col_id);
-			glColor3f(color.redF(), color.greenF(), color.blueF());
-			// draw points
-			BOOST_FOREACH(LidarPoint const& point, layer.points) {
-				
-				glVertex3f(point.x, point.y, point.z);			
-			}
-		glEnd();
+    glShadeModel(GL_SMOOTH);
+    buffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (m_streaming) {
+        for (int s = 0; s < m_sectorCount; ++s) {
+            int const count = (m_sectorVertexCounts[s] + stride - 1) / stride;
+            if (count > 0) {
+                setScanPointers(s * m_sectorCapacity, stride);
+                glDrawArrays(GL_POINTS, 0, count);
+                pointsDrawn += count;
+            }
+        }
+    } else {
+        pointsDrawn = (m_scanVertexCount + stride - 1) / stride;
+        setScanPointers(0, stride);
+        glDrawArrays(GL_POINTS, 0, pointsDrawn);
     }
-    
-
-	   /* for (int i=0;i<32;i++)
-			{
-				LidarLayer layer=m_scan.layers[i];
-        // set color for the layer
-		  glBegin(GL_POINTS);
-		  glShadeModel(GL_SMOOTH); 
-			int col_id=layer.id%10;
-			QColor const& color = m_pointColors[col_id];
-			//LOG_INFO(col_id);
-			glColor3f(color.redF(), color.greenF(), color.blueF());
-			// draw points
-			for (int j=0;j<layer.points.size();j++) {
-				LidarPoint point=layer.points[j];
-				
-				glVertex3f(point.x, point.y, point.z);			
-			}
-		glEnd();
-    }
-
-
-		*/
+    buffer.release();
+    // dynamic points again from the scan, larger and never decimated
+    if (!m_dynamicIndices.empty() && m_scanBuffer.isCreated()) {
+        m_scanBuffer.bind();
+        glPointSize(2 * m_pointSize);
+        setScanPointers(0, 1);
+        glDrawElements(GL_POINTS, static_cast<GLsizei>(m_dynamicIndices.size()), GL_UNSIGNED_INT,
+                       &m_dynamicIndices[0]);
+        pointsDrawn += static_cast<int>(m_dynamicIndices.size());
+        m_scanBuffer.release();
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
     glDisable(GL_POINT_SMOOTH);
+    return pointsDrawn;
+}
+
+void LidarScene::setScanPointers(int firstVertex, int stride)
+{
+    // skipping vertices through the attribute stride decimates without re-uploading
+    GLsizei const vertexStride = static_cast<GLsizei>(stride * sizeof(ScanVertex));
+    std::size_t const base = firstVertex * sizeof(ScanVertex);
+    glVertexPointer(3, GL_FLOAT, vertexStride, reinterpret_cast<GLvoid const*>(base + offsetof(ScanVertex, x)));
+    glColorPointer(4, GL_UNSIGNED_BYTE, vertexStride, reinterpret_cast<GLvoid const*>(base + offsetof(ScanVertex, r)));
+}
+
+void LidarScene::compileOverlay()
+{
+    if (!m_overlayList) {
+        m_overlayList = glGenLists(1);
+    }
+    glNewList(m_overlayList, GL_COMPILE);
+    {
+        // XYZ-axis frame
+        drawFrame(kFrameLineWidth, kFrameLength);
+        // grid
+        if (m_displayGrid) {
+            drawGrid(kGridLength, kGridStep, kGridLineWidth);
+        }
+    }
+    glEndList();
+
+    m_dirty &= ~DF_Overlay;
 }
 
 void LidarScene::drawGrid(float length, float step, float lineWidth)
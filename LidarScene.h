@@ -16,20 +16,33 @@
 #ifndef LIDARSCENE_H
 #define LIDARSCENE_H
 
+#include "FrameGovernor.h"
+#include "LidarSweep.h"
+#include "PointPicker.h"
+#include "TileCache.h"
+
 #include <structure/GenericLidar.h>
 #include <structure/LineCloud.h>
 
 #include <boost/scoped_ptr.hpp>
+#include <QElapsedTimer>
 #include <QGraphicsScene>
+#include <QOpenGLBuffer>
+#include <qopengl.h>
 #include <QMatrix4x4>
+#include <QStringList>
+#include <QTimer>
 #include <QVector2D>
 #include <QVector3D>
+#include <QVector>
+#include <vector>
 
 
 class QDialog;
 class QGraphicsSceneMouseEvent;
 class QGraphicsSceneWheelEvent;
 class QKeyEvent;
+class QLabel;
 class QPainter;
 class QRectF;
 class QWidget;
@@ -48,6 +61,17 @@ public:
 
     void setBackgroundColor(QColor const& color);
 
+    /// Splits the view into side by side viewports, one per preset camera
+    /// (top, side or chase). They all draw the same uploaded buffers.
+    /// @returns false and keeps the viewports for an unknown preset
+    bool setViewports(QStringList const& presets);
+
+    enum DisplayMode {
+        DM_Points,              ///< 3D point cloud
+        DM_PanoramaRange,       ///< lasers x azimuth panorama colored by range
+        DM_PanoramaIntensity    ///< lasers x azimuth panorama colored by intensity
+    };
+
 public Q_SLOTS:
     void setGridEnabled(bool gridEnabled);
     void setLidarEnabled(bool lidarEnabled);
@@ -56,6 +80,34 @@ public Q_SLOTS:
     void setLines(LineCloud3D const& lines);
     void setShowLines(bool showLines);
 
+    /// Displays a sweep without copying it, the scene keeps a reference until the next one
+    void setSweep(LidarSweepPtr const& sweep);
+    /// Replaces one sector of the streamed revolution, points are then
+    /// drawn from the sectors only
+    void setSector(LidarSectorPtr const& sector);
+    void setDisplayMode(int mode);
+    /// Frame time [ms] held by decimating the points while the camera moves
+    void setTargetFrameTime(double targetFrameTime);
+
+    /// Map drawn around the camera, NULL for none
+    void setMap(TiledMap* map, qint64 memoryBudget);
+    void setMapEnabled(bool mapEnabled);
+
+    /// Image laid on the ground plane, centered on the sensor, column along X
+    /// and first row at the smallest Y. A CV_32FC4 bird's-eye grid is colored
+    /// by max height, CV_8UC1, CV_8UC3 and CV_32FC1 grids as they are.
+    /// Replaced by the next grid, from a sweep or from this call.
+    void setGroundImage(cv::Mat const& image, float cellSize);
+    void setGroundEnabled(bool groundEnabled);
+    /// Boxes of the obstacle clusters of the sweep
+    void setClustersEnabled(bool clustersEnabled);
+
+Q_SIGNALS:
+    /// S key: export the displayed sweep
+    void snapshotRequested();
+    /// R key: start or stop exporting every sweep
+    void continuousExportToggled();
+
 protected:
     QDialog* createDialog(QString const& windowTitle, QWidget* parent = 0) const;
 
@@ -63,6 +115,11 @@ protected:
     void drawBackground(QPainter* painter, QRectF const& rect) /* override */;
 
     void resetView();
+    /// Makes the viewport under the cursor receive the camera controls
+    void activateViewportAt(QPointF const& scenePos);
+    QRectF viewportRect(int index) const;
+    /// @returns the number of points drawn
+    int drawViewport(int index);
     
     void mousePressEvent(QGraphicsSceneMouseEvent* event);
     void mouseReleaseEvent(QGraphicsSceneMouseEvent* event);
@@ -70,15 +127,52 @@ protected:
     void wheelEvent(QGraphicsSceneWheelEvent* wheelEvent);
     void keyPressEvent(QKeyEvent* event);
 
+    void pickAt(QPointF const& scenePos);
+    void clearPicks();
+    void updatePickLabel();
+
+    /// What changed since the last frame
+    enum DirtyFlag {
+        DF_None = 0,
+        DF_Scan = 1 << 0,       ///< scan points, buffer must be uploaded again
+        DF_Lines = 1 << 1,      ///< lines, buffer must be uploaded again
+        DF_Overlay = 1 << 2,    ///< grid and frame, display list must be compiled again
+        DF_Camera = 1 << 3,     ///< camera or small overlays, buffers are reused
+        DF_Sectors = 1 << 4,    ///< streamed sectors, their buffer slots must be written again
+        DF_Ground = 1 << 5,     ///< ground image, texture must be uploaded again
+        DF_Clusters = 1 << 6    ///< cluster boxes, buffer must be uploaded again
+    };
+    /// Records a change and schedules a frame if it is visible.
+    void markDirty(int flags, bool visible = true);
+    /// Schedules a frame at reduced detail, full detail comes back once the camera rests
+    void cameraMoved();
+    void uploadScan();
+    void uploadSectors();
+    void recordSectorLatencies();
+    void uploadLines();
+    void uploadClusters();
+    void compileOverlay();
+
     void drawCameraTargetPoint();
+    void drawPicks();
+    void drawPanorama();
+    void updatePanoramaTexture();
+    void drawGround();
+    void updateGroundTexture();
     void drawLines();
-    void drawScan();
-	void drawLDMRS_Scan();
+    void drawClusters();
+    /// @returns the number of points drawn
+    int drawScan();
+    void setScanPointers(int firstVertex, int stride);
     void drawGrid(float length, float step, float lineWidth);
     void drawCircle(float radius, QVector3D center, QVector3D normal, int num_segments);
     void drawFrame(float lineWidth, float length);
     //void drawScale(QPainter* painter, float length);
     
+private Q_SLOTS:
+    void restoreFullDetail();
+    void mapTileLoaded();
+
 private:
     enum CameraMovement {
         CM_None,
@@ -101,9 +195,77 @@ private:
 
 private:
     boost::scoped_ptr<QWidget> mControls;
+    QLabel* mPickLabel;
+
+    PointPicker mPicker;
+    /// last picked points, the two last ones are measured
+    QVector<PickResult> mPicks;
 
     LineCloud3D mLines;
-    LidarScan m_scan;
+    /// displayed sweep, never null
+    LidarSweepPtr m_sweep;
+    DisplayMode m_displayMode;
+
+    /// DF_* mask of the buffers to rebuild before the next frame
+    int m_dirty;
+
+    /// interleaved position and color of the scan points
+    struct ScanVertex {
+        GLfloat x, y, z;
+        GLubyte r, g, b, a;
+    };
+    QOpenGLBuffer m_scanBuffer;
+    std::vector<ScanVertex> m_scanVertices;
+    int m_scanVertexCount;
+    /// vertices of the dynamic points of the sweep, drawn again on top
+    std::vector<GLuint> m_dynamicIndices;
+
+    /// streamed points, one slot of m_sectorCapacity vertices per sector.
+    /// Set by the sectors, cleared by a sweep that was not streamed.
+    bool m_streaming;
+    QOpenGLBuffer m_sectorBuffer;
+    int m_sectorCount, m_sectorCapacity;
+    std::vector<int> m_sectorVertexCounts;
+    /// revolution of the sector in each slot
+    std::vector<unsigned int> m_sectorRevolutions;
+    /// latest sector received for each slot, null when uploaded
+    std::vector<LidarSectorPtr> m_pendingSectors;
+    /// arrival times of the sectors uploaded for the current frame
+    std::vector<qint64> m_sectorArrivals;
+    /// arrival to draw latencies [ns], reported by batches
+    std::vector<qint64> m_sectorLatencies;
+
+    /// ground image, shares the buffer of m_sweep when it comes from it
+    cv::Mat m_groundImage;
+    float m_groundCellSize;
+    bool m_groundFromSweep;
+    bool m_displayGround;
+    GLuint m_groundTexture;
+    std::vector<unsigned char> m_groundPixels;
+
+    TileCache m_tileCache;
+    bool m_displayMap;
+
+    FrameGovernor m_governor;
+    /// true while the camera moves, points are then decimated to the budget
+    bool m_interacting;
+    QTimer m_idleTimer;
+    QElapsedTimer m_frameTimer;
+    QOpenGLBuffer m_linesBuffer;
+    std::vector<GLfloat> m_linesVertices;
+    int m_linesVertexCount;
+    /// edges of all cluster boxes, drawn at once
+    QOpenGLBuffer m_clusterBuffer;
+    std::vector<GLfloat> m_clusterVertices;
+    int m_clusterVertexCount;
+    bool m_displayClusters;
+    /// display list of the static grid and frame
+    GLuint m_overlayList;
+
+    /// panorama texture, re-uploaded when the image or the coloring changed
+    GLuint m_panoramaTexture;
+    bool m_panoramaDirty;
+    std::vector<unsigned char> m_panoramaPixels;
     QColor m_backgroundColor;
 	
     float m_pointSize;
@@ -114,8 +276,17 @@ private:
 
     //QGraphicsRectItem *m_lightItem;
 
+    /// camera of the active viewport, the one controlled by the mouse and keys,
+    /// in the sensor frame so that it follows the sweep pose
     QVector3D m_cameraEye, m_cameraRef, m_cameraUp;
-    QMatrix4x4 m_projection, m_modelView;
+    struct Viewport
+    {
+        QString preset;
+        /// camera, only up to date while the viewport is inactive
+        QVector3D eye, ref, up;
+    };
+    std::vector<Viewport> m_viewports;
+    int m_activeViewport;
     QList<QColor> m_pointColors;
 
     float m_fovx, m_znear, m_zfar;
@@ -0,0 +1,93 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief One converted revolution, as passed between the pipeline stages,
+/// and the partial sectors streamed while it is being received.
+
+#ifndef LIDARSWEEP_H
+#define LIDARSWEEP_H
+
+#include "AlignedScan.h"
+#include "VelodyneRangeImage.h"
+
+#include <structure/GenericLidar.h>
+
+#include "opencv2/core/core.hpp"
+#include <QMatrix4x4>
+#include <QSharedPointer>
+#include <vector>
+
+namespace pacpus
+{
+
+/// Axis-aligned bounding box of a cluster of points [m]
+struct ClusterBox
+{
+    float minX, minY, minZ;
+    float maxX, maxY, maxZ;
+    int pointCount;
+};
+
+struct LidarSweep
+{
+    LidarSweep()
+        : birdEyeCellSize(0)
+        , streamed(false)
+    {
+    }
+
+    /// Organized image, empty for scans received already converted
+    VelodyneRangeImage image;
+    LidarScan scan;
+    /// Same points as the scan, by planes, for the filters and the uploads
+    AlignedScan points;
+    /// Bird's-eye grid of the scan (see BirdEyeGrid), empty when disabled.
+    /// Its buffer is reused with the sweep, clone it to keep it longer.
+    cv::Mat birdEye;
+    /// side of a bird's-eye cell [m]
+    float birdEyeCellSize;
+    /// Obstacle clusters of the range image (see SweepClusterer), empty
+    /// when disabled or without an image
+    std::vector<ClusterBox> clusters;
+    /// 1 for the points of the scan, numbered across the layers, falling
+    /// into newly occupied voxels (see ChangeDetector), empty when disabled
+    std::vector<unsigned char> dynamic;
+    /// Sensor to odometry frame transform (see SweepRegistration), the
+    /// identity when odometry is disabled. The sweep is drawn and mapped in
+    /// this frame.
+    QMatrix4x4 pose;
+    /// true when its points were already displayed sector by sector
+    /// (see LidarSector), the display then only takes its overlays
+    bool streamed;
+};
+
+typedef QSharedPointer<LidarSweep const> LidarSweepPtr;
+
+/// Points of a range of azimuth columns of the revolution being received
+struct LidarSector
+{
+    struct Point
+    {
+        float x, y, z;
+        int layer;
+    };
+
+    /// sector index in [0, sectorCount)
+    int index;
+    /// sequence number of its revolution, increasing
+    unsigned int revolution;
+    int sectorCount;
+    /// maximum number of points of any sector
+    int capacity;
+    /// arrival time of the newest blocks [ns, TraceRecorder::now()]
+    qint64 arrivalTime;
+    std::vector<Point> points;
+};
+
+typedef QSharedPointer<LidarSector const> LidarSectorPtr;
+
+} // namespace pacpus
+
+#endif // LIDARSWEEP_H
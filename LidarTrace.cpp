@@ -0,0 +1,219 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "LidarTrace.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
+
+#include <vector>
+
+using namespace pacpus;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.Trace");
+
+/// Events kept per thread, must be a power of two
+static const unsigned int kBufferCapacity = 1 << 14;
+
+namespace
+{
+
+struct TraceEvent
+{
+    char const* name;
+    qint64 begin;
+    /// negative for instant events
+    qint64 duration;
+};
+
+/// Single-producer ring buffer, only the owning thread writes.
+class TraceBuffer
+{
+public:
+    TraceBuffer(int threadId, QString const& threadName)
+        : mThreadId(threadId)
+        , mThreadName(threadName)
+        , mEvents(kBufferCapacity)
+        , mWriteCount(0)
+    {
+    }
+
+    void push(TraceEvent const& event)
+    {
+        unsigned int const count = static_cast<unsigned int>(mWriteCount.load());
+        mEvents[count & (kBufferCapacity - 1)] = event;
+        mWriteCount.storeRelease(static_cast<int>(count + 1));
+    }
+
+    /// Copies the events that were not overwritten while reading.
+    void snapshot(std::vector<TraceEvent>& events) const
+    {
+        unsigned int const end = static_cast<unsigned int>(mWriteCount.loadAcquire());
+        unsigned int const available = (end < kBufferCapacity) ? end : kBufferCapacity;
+        unsigned int const begin = end - available;
+
+        std::vector<TraceEvent> copy(available);
+        for (unsigned int i = 0; i < available; ++i) {
+            copy[i] = mEvents[(begin + i) & (kBufferCapacity - 1)];
+        }
+
+        // The writer may have wrapped over the first copied slots: it wrote
+        // the events up to `after` and may be filling the slot of `after`,
+        // which is the slot of `begin` once the buffer is full.
+        unsigned int const after = static_cast<unsigned int>(mWriteCount.loadAcquire());
+        long long const overwritten = static_cast<long long>(after - end) + available - kBufferCapacity + 1;
+        unsigned int const discarded = (overwritten <= 0) ? 0
+                : (overwritten < available) ? static_cast<unsigned int>(overwritten) : available;
+        events.assign(copy.begin() + discarded, copy.end());
+    }
+
+    int threadId() const { return mThreadId; }
+    QString const& threadName() const { return mThreadName; }
+
+private:
+    int mThreadId;
+    QString mThreadName;
+    std::vector<TraceEvent> mEvents;
+    QAtomicInt mWriteCount;
+};
+
+typedef QSharedPointer<TraceBuffer> TraceBufferPtr;
+
+QMutex sRegistryMutex;
+QVector<TraceBufferPtr> sBuffers;
+QThreadStorage<TraceBufferPtr> sThreadBuffer;
+
+/// Started at load time, before any thread records
+struct TraceClock
+{
+    TraceClock()
+    {
+        timer.start();
+    }
+    QElapsedTimer timer;
+};
+TraceClock sClock;
+
+/// Buffer of the calling thread, registered on first use
+TraceBuffer& threadBuffer()
+{
+    if (!sThreadBuffer.hasLocalData()) {
+        QString name;
+        if (QThread::currentThread()) {
+            name = QThread::currentThread()->objectName();
+        }
+
+        QMutexLocker lock(&sRegistryMutex);
+        if (name.isEmpty()) {
+            name = QString("thread %1").arg(sBuffers.size() + 1);
+        }
+        TraceBufferPtr buffer(new TraceBuffer(sBuffers.size() + 1, name));
+        sBuffers.append(buffer);
+        sThreadBuffer.setLocalData(buffer);
+    }
+    return *sThreadBuffer.localData();
+}
+
+QString jsonEscaped(QString const& text)
+{
+    QString escaped = text;
+    escaped.replace('\\', "\\\\");
+    escaped.replace('"', "\\\"");
+    return escaped;
+}
+
+} // namespace
+
+qint64 TraceRecorder::now()
+{
+    return sClock.timer.nsecsElapsed();
+}
+
+void TraceRecorder::record(char const* name, qint64 begin, qint64 end)
+{
+    TraceEvent event;
+    event.name = name;
+    event.begin = begin;
+    event.duration = end - begin;
+    threadBuffer().push(event);
+}
+
+void TraceRecorder::instant(char const* name)
+{
+    TraceEvent event;
+    event.name = name;
+    event.begin = now();
+    event.duration = -1;
+    threadBuffer().push(event);
+}
+
+bool TraceRecorder::isCompiledIn()
+{
+#ifdef LIDARVIEWER_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool TraceRecorder::dump(QString const& path)
+{
+    if (!isCompiledIn()) {
+        LOG_WARN("trace points are not compiled in, configure with LIDARVIEWER_TRACING=ON");
+    }
+
+    QVector<TraceBufferPtr> buffers;
+    {
+        QMutexLocker lock(&sRegistryMutex);
+        buffers = sBuffers;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        LOG_ERROR("cannot write trace file '" << path << "'");
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    int eventCount = 0;
+    std::vector<TraceEvent> events;
+    Q_FOREACH (TraceBufferPtr const& buffer, buffers) {
+        int const tid = buffer->threadId();
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << jsonEscaped(buffer->threadName()) << "\"}}";
+        first = false;
+
+        buffer->snapshot(events);
+        for (size_t i = 0; i < events.size(); ++i) {
+            TraceEvent const& event = events[i];
+            // timestamps in microseconds
+            out << ",\n{\"name\":\"" << event.name << "\",\"pid\":1,\"tid\":" << tid
+                << ",\"ts\":" << QString::number(event.begin / 1000.0, 'f', 3);
+            if (event.duration >= 0) {
+                out << ",\"ph\":\"X\",\"dur\":" << QString::number(event.duration / 1000.0, 'f', 3) << "}";
+            } else {
+                out << ",\"ph\":\"i\",\"s\":\"t\"}";
+            }
+        }
+        eventCount += static_cast<int>(events.size());
+    }
+    out << "\n]}\n";
+
+    LOG_INFO("wrote " << eventCount << " trace events of " << buffers.size() << " threads to '" << path << "'");
+    return true;
+}
@@ -0,0 +1,76 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Lightweight hot path tracing, exported as Chrome trace JSON.
+///
+/// Each thread records into its own fixed-size ring buffer, written without
+/// locks; the oldest events are overwritten. dump() collects all buffers
+/// into a file that chrome://tracing and Perfetto can open.
+///
+/// Trace points are compiled only when LIDARVIEWER_TRACING is defined
+/// (CMake option of the same name), otherwise the macros expand to nothing.
+
+#ifndef LIDARTRACE_H
+#define LIDARTRACE_H
+
+#include <QString>
+#include <QtGlobal>
+
+namespace pacpus
+{
+
+class TraceRecorder
+{
+public:
+    /// Monotonic time [ns]
+    static qint64 now();
+
+    /// Records a completed span in the buffer of the calling thread.
+    /// @param name must be a string literal, only the pointer is stored
+    static void record(char const* name, qint64 begin, qint64 end);
+    /// Records an instant event in the buffer of the calling thread.
+    static void instant(char const* name);
+
+    /// Writes all recorded events as Chrome trace JSON.
+    static bool dump(QString const& path);
+
+    static bool isCompiledIn();
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(char const* name)
+        : mName(name)
+        , mBegin(TraceRecorder::now())
+    {
+    }
+
+    ~TraceScope()
+    {
+        TraceRecorder::record(mName, mBegin, TraceRecorder::now());
+    }
+
+private:
+    char const* mName;
+    qint64 mBegin;
+};
+
+} // namespace pacpus
+
+#define LIDAR_TRACE_CONCAT_IMPL(a, b) a ## b
+#define LIDAR_TRACE_CONCAT(a, b) LIDAR_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef LIDARVIEWER_TRACING
+/// Records the time spent until the end of the enclosing scope
+#   define LIDAR_TRACE_SCOPE(name) ::pacpus::TraceScope LIDAR_TRACE_CONCAT(lidarTraceScope, __LINE__)(name)
+/// Records a point in time
+#   define LIDAR_TRACE_INSTANT(name) ::pacpus::TraceRecorder::instant(name)
+#else
+#   define LIDAR_TRACE_SCOPE(name) ((void) 0)
+#   define LIDAR_TRACE_INSTANT(name) ((void) 0)
+#endif
+
+#endif // LIDARTRACE_H
@@ -8,6 +8,7 @@ static const int DEFAULT_IMAGE_HEIGHT = 240;
 static const int DEFAULT_IMAGE_DEPTH = 32;
 
 #include "LidarScene.h"
+#include "LidarTrace.h"
 #include "LidarView.h"
 
 #include <Pacpus/kernel/Log.h>
@@ -18,6 +19,7 @@ static const int DEFAULT_IMAGE_DEPTH = 32;
 #include <cmath>
 #include <QtOpenGL/QGLFormat>
 #include <QtOpenGL/QGLWidget>
+#include <QPaintEvent>
 #include <QResizeEvent>
 
 using namespace pacpus;
@@ -26,6 +28,8 @@ DECLARE_STATIC_LOGGER("pacpus.LidarViewer.LidarView");
 
 LidarView::LidarView(QWidget* parent)
     : QGraphicsView(parent)
+    , mBenchmark("scene")
+    , mBenchmarkFrames(0)
 {    
     PACPUS_LOG_FUNCTION();
 
@@ -42,6 +46,8 @@ LidarView::LidarView(QWidget* parent)
     mScene = new LidarScene(this);
     BOOST_ASSERT(mScene);
     setScene(mScene);
+    connect(mScene, &LidarScene::snapshotRequested, this, &LidarView::snapshotRequested);
+    connect(mScene, &LidarScene::continuousExportToggled, this, &LidarView::continuousExportToggled);
 }
 
 LidarView::~LidarView()
@@ -51,20 +57,77 @@ LidarView::~LidarView()
 
 void LidarView::display(LidarScan const& scan)
 {
-    PACPUS_LOG_FUNCTION();
+    LIDAR_TRACE_SCOPE("LidarView::display");
 
     BOOST_ASSERT(mScene);
     mScene->setScan(scan);
-    mScene->update();
 }
 
 void LidarView::display(LineCloud3D const& lines)
 {
-    PACPUS_LOG_FUNCTION();
+    LIDAR_TRACE_SCOPE("LidarView::display");
 
     BOOST_ASSERT(mScene);
     mScene->setLines(lines);
-    mScene->update();
+}
+
+void LidarView::display(LidarSweepPtr const& sweep)
+{
+    LIDAR_TRACE_SCOPE("LidarView::display");
+
+    BOOST_ASSERT(mScene);
+    mScene->setSweep(sweep);
+    if (mBenchmarkFrames > 0) {
+        mBenchmark.start(mBenchmarkFrames);
+        mBenchmarkFrames = 0;
+    }
+}
+
+void LidarView::setTargetFrameTime(double targetFrameTime)
+{
+    BOOST_ASSERT(mScene);
+    mScene->setTargetFrameTime(targetFrameTime);
+}
+
+void LidarView::setMap(TiledMap* map, qint64 memoryBudget)
+{
+    BOOST_ASSERT(mScene);
+    mScene->setMap(map, memoryBudget);
+}
+
+void LidarView::display(LidarSectorPtr const& sector)
+{
+    LIDAR_TRACE_SCOPE("LidarView::display");
+
+    BOOST_ASSERT(mScene);
+    mScene->setSector(sector);
+}
+
+void LidarView::display(cv::Mat const& grid, float cellSize)
+{
+    LIDAR_TRACE_SCOPE("LidarView::display");
+
+    BOOST_ASSERT(mScene);
+    mScene->setGroundImage(grid, cellSize);
+}
+
+bool LidarView::setViewports(QStringList const& presets)
+{
+    BOOST_ASSERT(mScene);
+    return mScene->setViewports(presets);
+}
+
+void LidarView::setBenchmarkFrames(int frameCount)
+{
+    mBenchmarkFrames = frameCount;
+}
+
+void LidarView::paintEvent(QPaintEvent* pEvent)
+{
+    QGraphicsView::paintEvent(pEvent);
+    if (mBenchmark.frameDone()) {
+        viewport()->update();
+    }
 }
 
 void LidarView::resizeEvent(QResizeEvent* rEvent)
@@ -16,18 +16,24 @@
 #ifndef LIDARVIEW_H
 #define LIDARVIEW_H
 
+#include "FrameBenchmark.h"
+#include "LidarSweep.h"
+
 #include <structure/LineCloud.h>
 
 #include <QGraphicsView>
 #include <QMatrix4x4>
+#include <QStringList>
 #include <QVector3D>
 
+class QPaintEvent;
 class QResizeEvent;
 
 namespace pacpus
 {
     
 class LidarScene;
+class TiledMap;
 struct LidarScan;
 
 class LidarView
@@ -42,12 +48,32 @@ public:
 public Q_SLOTS:
     void display(LidarScan const& scan);
     void display(LineCloud3D const& lines);
+    void display(LidarSweepPtr const& sweep);
+    void display(LidarSectorPtr const& sector);
+    /// Grid image laid on the ground plane, centered on the sensor
+    void display(cv::Mat const& grid, float cellSize);
+
+    /// Frame time [ms] held while the camera moves
+    void setTargetFrameTime(double targetFrameTime);
+    /// Map drawn around the camera, NULL for none
+    void setMap(TiledMap* map, qint64 memoryBudget);
+    /// Measures this many frames once the first sweep is shown, 0 disables
+    void setBenchmarkFrames(int frameCount);
+    /// Side by side viewports, see LidarScene::setViewports
+    bool setViewports(QStringList const& presets);
+
+Q_SIGNALS:
+    void snapshotRequested();
+    void continuousExportToggled();
 
 protected:
     void resizeEvent(QResizeEvent* event);
+    void paintEvent(QPaintEvent* event);
 
 private:
     LidarScene* mScene;
+    FrameBenchmark mBenchmark;
+    int mBenchmarkFrames;
 };
 
 } // namespace pacpus
@@ -5,6 +5,7 @@
 
 #include "LidarViewer.h"
 #include "LidarViewerImpl.h"
+#include "LidarTrace.h"
 
 #include <Pacpus/kernel/ComponentFactory.h>
 #include <Pacpus/kernel/Log.h>
@@ -19,23 +20,117 @@ DECLARE_STATIC_LOGGER("pacpus.LidarViewer");
 /// Constructs a static component factory
 static ComponentFactory<LidarViewer> sFactory("LidarViewer");
 
+static const double kDegToRad = 3.14159265358979323846 / 180;
+
 //////////////////////////////////////////////////////////////////////////
 LidarViewer::LidarViewer(QString name)
     : ComponentBase(name)
+    , mScanOutput(NULL)
+    , mAzimuthBins(VelodyneConverter::kDefaultColumnCount)
+    , mRoiMinRange(1.5)
+    , mRoiMaxRange(0)
+    , mRoiMinAzimuth(0)
+    , mRoiMaxAzimuth(360)
+    , mRoiMinZ(-100)
+    , mRoiMaxZ(100)
+    , mRoiBoxX(0)
+    , mRoiBoxY(0)
+    , mRoiBoxYaw(0)
+    , mRoiBoxLength(0)
+    , mRoiBoxWidth(0)
+    , mIngestQueueCapacity(2)
+    , mPublishQueueCapacity(2)
+    , mStreamSectors(36)
+    , mTargetFrameTime(16)
+    , mMapTileSize(25)
+    , mMapMemoryBudget(256)
+    , mBirdEyeGrid(false)
+    , mBirdEyeCellSize(0.2)
+    , mBirdEyeExtent(50)
+    , mOccupancyCellSize(0.2)
+    , mClusters(true)
+    , mClusterTolerance(0.5)
+    , mClusterMinZ(-1.5)
+    , mClusterMinPoints(10)
+    , mChangeDetection(false)
+    , mChangeVoxelSize(0.3)
+    , mChangeBackgroundSweeps(5)
+    , mTemporalFilter(false)
+    , mTemporalFilterDepth(4)
+    , mTemporalFilterSupport(1)
+    , mTemporalFilterTolerance(0.5)
+    , mOdometry(false)
+    , mOdometryColumnStep(4)
+    , mOdometryMaxDistance(1.0)
+    , mOdometryMaxIterations(20)
+    , mOdometryBudget(30)
+    , mBenchmarkFrames(0)
+    , mShmSlots(4)
+    , mShmCapacity(0)
 {   
     LOG_TRACE("constructor(" << name << ")");
 
     mImpl.reset(new Impl(this));
+    mThread.setObjectName("LidarViewer input");
     string velodyne_source="velodynedbtply"; 
 	shmem_velodyne = new pacpus::ShMem(velodyne_source.c_str(), sizeof(VelodynePolarData));
 	velodyne_mem = malloc(sizeof(VelodynePolarData)); 
 	
 
-    //addParameters()
-    //("parameter-name", value<ParameterType>(&mImpl->mParameterVariable)->required(), "parameter description")
-    //("parameter-name", value<ParameterType>(&mImpl->mParameterVariable)->default_value(0), "parameter description")
-    //;
-	counter=1;
+    addParameters()
+    ("sensor-model", value<string>(&mSensorModel)->default_value("hdl32"), "Velodyne model of the raw inputs: hdl32, vlp16 or hdl64")
+    ("calibration-file", value<string>(&mCalibrationFile)->default_value(""), "per-laser Velodyne calibration file (vertical angle, rotational, distance and offset corrections)")
+    ("azimuth-bins", value<int>(&mAzimuthBins)->default_value(VelodyneConverter::kDefaultColumnCount), "number of azimuth columns of the Velodyne range image, at most 36000")
+    ("roi-min-range", value<double>(&mRoiMinRange)->default_value(1.5), "returns closer than this distance [m] are dropped during the conversion")
+    ("roi-max-range", value<double>(&mRoiMaxRange)->default_value(0), "returns farther than this distance [m] are dropped during the conversion, 0 for no limit")
+    ("roi-min-azimuth", value<double>(&mRoiMinAzimuth)->default_value(0), "start of the kept azimuth window [deg], the window wraps through 0 when it is greater than roi-max-azimuth")
+    ("roi-max-azimuth", value<double>(&mRoiMaxAzimuth)->default_value(360), "end of the kept azimuth window [deg]")
+    ("roi-min-z", value<double>(&mRoiMinZ)->default_value(-100), "returns below this height [m] are dropped during the conversion")
+    ("roi-max-z", value<double>(&mRoiMaxZ)->default_value(100), "returns above this height [m] are dropped during the conversion")
+    ("roi-box-x", value<double>(&mRoiBoxX)->default_value(0), "X of the center of the kept box [m]")
+    ("roi-box-y", value<double>(&mRoiBoxY)->default_value(0), "Y of the center of the kept box [m]")
+    ("roi-box-yaw", value<double>(&mRoiBoxYaw)->default_value(0), "angle of the length of the kept box from X [deg]")
+    ("roi-box-length", value<double>(&mRoiBoxLength)->default_value(0), "length of the kept box [m], 0 to keep returns outside any box")
+    ("roi-box-width", value<double>(&mRoiBoxWidth)->default_value(0), "width of the kept box [m]")
+    ("ingest-queue-capacity", value<int>(&mIngestQueueCapacity)->default_value(2), "number of raw revolutions waiting for conversion")
+    ("ingest-queue-policy", value<string>(&mIngestQueuePolicy)->default_value("drop-oldest"), "ingest queue overflow policy: drop-oldest, drop-newest or block")
+    ("publish-queue-capacity", value<int>(&mPublishQueueCapacity)->default_value(2), "number of converted sweeps waiting for display")
+    ("publish-queue-policy", value<string>(&mPublishQueuePolicy)->default_value("drop-oldest"), "publish queue overflow policy: drop-oldest, drop-newest or block")
+    ("stream-sectors", value<int>(&mStreamSectors)->default_value(36), "number of azimuth sectors updated separately when streaming partial revolutions")
+    ("target-frame-time", value<double>(&mTargetFrameTime)->default_value(16), "frame time [ms] held by decimating the points while the camera moves")
+    ("map-file", value<string>(&mMapFile)->default_value(""), "file accumulating the sweeps into a tiled map, empty to disable the map")
+    ("map-tile-size", value<double>(&mMapTileSize)->default_value(25), "side of a map tile [m]")
+    ("map-memory-budget", value<int>(&mMapMemoryBudget)->default_value(256), "memory for the map tiles loaded around the camera [MiB]")
+    ("birdeye-grid", value<bool>(&mBirdEyeGrid)->default_value(false), "bin each sweep into a bird's-eye grid of max height, min height, density and mean intensity, displayed instead of the occgrid input")
+    ("birdeye-cell-size", value<double>(&mBirdEyeCellSize)->default_value(0.2), "side of a bird's-eye grid cell [m]")
+    ("birdeye-extent", value<double>(&mBirdEyeExtent)->default_value(50), "the bird's-eye grid covers this distance [m] around the sensor in X and Y")
+    ("occgrid-cell-size", value<double>(&mOccupancyCellSize)->default_value(0.2), "side of a cell of the occupancy grid input [m]")
+    ("clusters", value<bool>(&mClusters)->default_value(true), "group the returns of each Velodyne sweep into obstacle clusters shown as boxes")
+    ("cluster-tolerance", value<double>(&mClusterTolerance)->default_value(0.5), "largest distance between two neighbouring returns of a cluster [m]")
+    ("cluster-min-z", value<double>(&mClusterMinZ)->default_value(-1.5), "returns below this height [m] are ground and never clustered")
+    ("cluster-min-points", value<int>(&mClusterMinPoints)->default_value(10), "smaller clusters are dropped")
+    ("change-detection", value<bool>(&mChangeDetection)->default_value(false), "highlight the points falling into voxels free in the previous sweeps, for a static sensor")
+    ("change-voxel-size", value<double>(&mChangeVoxelSize)->default_value(0.3), "side of a change detection voxel [m]")
+    ("change-background-sweeps", value<int>(&mChangeBackgroundSweeps)->default_value(5), "number of previous sweeps a point is compared to, 1 to 31")
+    ("temporal-filter", value<bool>(&mTemporalFilter)->default_value(false), "drop the Velodyne returns no recent sweep confirms: rain, spray, dust")
+    ("temporal-filter-depth", value<int>(&mTemporalFilterDepth)->default_value(4), "previous sweeps kept per beam by the temporal filter, 1 to 8")
+    ("temporal-filter-support", value<int>(&mTemporalFilterSupport)->default_value(1), "previous sweeps that must confirm a return, 1 to temporal-filter-depth")
+    ("temporal-filter-tolerance", value<double>(&mTemporalFilterTolerance)->default_value(0.5), "largest range difference of a confirming return [m], must cover the sensor motion over the kept sweeps")
+    ("odometry", value<bool>(&mOdometry)->default_value(false), "register each Velodyne sweep onto the previous one (point-to-plane ICP) and display the sweeps at their odometry pose")
+    ("odometry-column-step", value<int>(&mOdometryColumnStep)->default_value(4), "one azimuth column out of this many of a sweep is registered")
+    ("odometry-max-distance", value<double>(&mOdometryMaxDistance)->default_value(1.0), "farthest distance between matched points of two sweeps [m]")
+    ("odometry-max-iterations", value<int>(&mOdometryMaxIterations)->default_value(20), "ICP iterations per sweep")
+    ("odometry-budget", value<double>(&mOdometryBudget)->default_value(30), "time allowed to register a sweep [ms], leaves the rest of a 10 Hz revolution to the other stages")
+    ("render-path", value<string>(&mRenderPath)->default_value("scene"), "3D view: scene (QGraphicsView) or window (core profile OpenGL window, sweeps, ground image and grid only, without lines, clusters, sectors or map)")
+    ("viewports", value<string>(&mViewports)->default_value("top"), "comma-separated cameras of the side by side viewports: top, side or chase")
+    ("benchmark-frames", value<int>(&mBenchmarkFrames)->default_value(0), "number of frames rendered back to back and timed once the first sweep is shown, 0 to disable")
+    ("shm-name", value<string>(&mShmName)->default_value(""), "shared memory key publishing the converted sweeps to other local processes, empty to disable")
+    ("shm-slots", value<int>(&mShmSlots)->default_value(4), "number of sweeps kept in the shared memory ring")
+    ("shm-capacity", value<int>(&mShmCapacity)->default_value(0), "points per shared memory slot, 0 for lasers times azimuth-bins")
+    ("export-directory", value<string>(&mExportDirectory)->default_value("."), "directory of the exported point clouds")
+    ("export-format", value<string>(&mExportFormat)->default_value("ply"), "point cloud export format: ply, pcd or las")
+    ("export-queue-capacity", value<int>(&mExportQueueCapacity)->default_value(4), "number of sweeps waiting to be written, newer ones are dropped")
+    ;
 }
 
 LidarViewer::~LidarViewer()
@@ -51,19 +146,22 @@ void LidarViewer::addInputs()
     addInput<LidarScan, LidarViewer>("scan", &LidarViewer::processScan);
     addInput<LineCloud3D, LidarViewer>("lines", &LidarViewer::processLines);
 	addInput<VelodynePolarData, LidarViewer>("velodyne", &LidarViewer::processVelodyne);
+    addInput<VelodynePolarData, LidarViewer>("velodyne-blocks", &LidarViewer::processVelodyneBlocks);
 	addInput<cv::Mat, LidarViewer>("occgrid", &LidarViewer::processOccgrid);
-	//addInput<TYPE_GEN, LidarViewer>("scan_ldmrs", &LidarViewer::processLDMRS_Scan);
-	//addInput<TYPE_GEN, LidarViewer>("scan_lms511", &LidarViewer::processLDMRS_Scan);
+    // Cartesian scans of the SICK sensors, the LD-MRS layers are drawn as any scan
+    addInput<LidarScan, LidarViewer>("scan_ldmrs", &LidarViewer::processScan);
+    addInput<LidarScan, LidarViewer>("scan_lms511", &LidarViewer::processScan);
 }
 
 void LidarViewer::addOutputs()
 {
-    // no outputs
+    addOutput<LidarScan, LidarViewer>("scan");
 }
 
 //////////////////////////////////////////////////////////////////////////
 void LidarViewer::startActivity()
 {
+    mScanOutput = getTypedOutput<LidarScan, LidarViewer>("scan");
     mImpl->start();
     moveToThread(&mThread);
     mThread.start();
@@ -79,18 +177,184 @@ void LidarViewer::stopActivity()
 //////////////////////////////////////////////////////////////////////////
 ComponentBase::COMPONENT_CONFIGURATION LidarViewer::configureComponent(XmlComponentConfig config)
 {
+    if (!mImpl->converter().setModel(mSensorModel)) {
+        LOG_ERROR("unknown sensor-model '" << mSensorModel << "'");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if (mCalibrationFile.empty()) {
+        LOG_INFO("no calibration-file given, using the nominal elevations of the " << mSensorModel);
+        mImpl->converter().setDefaultCalibration();
+    } else if (!mImpl->converter().calibration().load(mCalibrationFile)) {
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if ((mAzimuthBins <= 0) || (mAzimuthBins > VelodyneConverter::kMaxColumnCount)) {
+        LOG_ERROR("azimuth-bins must be between 1 and " << VelodyneConverter::kMaxColumnCount);
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->converter().setColumnCount(mAzimuthBins);
+
+    if ((mRoiMinRange < 0) || (mRoiMaxRange < 0) || ((mRoiMaxRange > 0) && (mRoiMaxRange <= mRoiMinRange))) {
+        LOG_ERROR("roi-min-range and roi-max-range must not be negative and roi-max-range must exceed roi-min-range");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if ((mRoiMinAzimuth < 0) || (mRoiMinAzimuth > 360) || (mRoiMaxAzimuth < 0) || (mRoiMaxAzimuth > 360)) {
+        LOG_ERROR("roi-min-azimuth and roi-max-azimuth must be between 0 and 360");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if (mRoiMaxZ <= mRoiMinZ) {
+        LOG_ERROR("roi-max-z must exceed roi-min-z");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if ((mRoiBoxLength < 0) || ((mRoiBoxLength > 0) && (mRoiBoxWidth <= 0))) {
+        LOG_ERROR("roi-box-length must not be negative and roi-box-width must be positive with a box");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    VelodyneConverter::Crop crop;
+    crop.minRange = static_cast<float>(mRoiMinRange);
+    if (mRoiMaxRange > 0) {
+        crop.maxRange = static_cast<float>(mRoiMaxRange);
+    }
+    crop.minAzimuth = static_cast<float>(mRoiMinAzimuth);
+    crop.maxAzimuth = static_cast<float>(mRoiMaxAzimuth);
+    crop.minZ = static_cast<float>(mRoiMinZ);
+    crop.maxZ = static_cast<float>(mRoiMaxZ);
+    if (mRoiBoxLength > 0) {
+        crop.boxX = static_cast<float>(mRoiBoxX);
+        crop.boxY = static_cast<float>(mRoiBoxY);
+        crop.boxYaw = static_cast<float>(mRoiBoxYaw * kDegToRad);
+        crop.boxHalfLength = static_cast<float>(mRoiBoxLength / 2);
+        crop.boxHalfWidth = static_cast<float>(mRoiBoxWidth / 2);
+    }
+    mImpl->converter().setCrop(crop);
+    mImpl->configureStreamConverter();
+
+    QueueOverflowPolicy ingestPolicy, publishPolicy;
+    if (!parseQueueOverflowPolicy(mIngestQueuePolicy, ingestPolicy)) {
+        LOG_ERROR("unknown ingest-queue-policy '" << mIngestQueuePolicy << "'");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if (!parseQueueOverflowPolicy(mPublishQueuePolicy, publishPolicy)) {
+        LOG_ERROR("unknown publish-queue-policy '" << mPublishQueuePolicy << "'");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if ((mIngestQueueCapacity <= 0) || (mPublishQueueCapacity <= 0)) {
+        LOG_ERROR("queue capacities must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureQueues(mIngestQueueCapacity, ingestPolicy, mPublishQueueCapacity, publishPolicy);
+
+    if ((mStreamSectors <= 0) || (mStreamSectors > mAzimuthBins)) {
+        LOG_ERROR("stream-sectors must be between 1 and azimuth-bins");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->setStreamSectorCount(mStreamSectors);
+
+    if (mTargetFrameTime <= 0) {
+        LOG_ERROR("target-frame-time must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->setTargetFrameTime(mTargetFrameTime);
+
+    if ((mMapTileSize <= 0) || (mMapMemoryBudget <= 0)) {
+        LOG_ERROR("map-tile-size and map-memory-budget must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureMap(QString::fromStdString(mMapFile), static_cast<float>(mMapTileSize),
+                        static_cast<qint64>(mMapMemoryBudget) * 1024 * 1024);
+
+    if ((mBirdEyeCellSize <= 0) || (mBirdEyeExtent <= 0) || (mOccupancyCellSize <= 0)) {
+        LOG_ERROR("birdeye-cell-size, birdeye-extent and occgrid-cell-size must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureBirdEye(mBirdEyeGrid, static_cast<float>(mBirdEyeCellSize), static_cast<float>(mBirdEyeExtent));
+    mImpl->setOccupancyCellSize(static_cast<float>(mOccupancyCellSize));
+
+    if ((mClusterTolerance <= 0) || (mClusterMinPoints <= 0)) {
+        LOG_ERROR("cluster-tolerance and cluster-min-points must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureClusters(mClusters, static_cast<float>(mClusterTolerance), static_cast<float>(mClusterMinZ),
+                             mClusterMinPoints);
+
+    if ((mChangeVoxelSize <= 0) || (mChangeBackgroundSweeps < 1) || (mChangeBackgroundSweeps > 31)) {
+        LOG_ERROR("change-voxel-size must be positive and change-background-sweeps between 1 and 31");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureChangeDetection(mChangeDetection, static_cast<float>(mChangeVoxelSize), mChangeBackgroundSweeps);
+
+    if ((mTemporalFilterDepth < 1) || (mTemporalFilterDepth > TemporalRangeFilter::kMaxDepth)
+        || (mTemporalFilterSupport < 1) || (mTemporalFilterSupport > mTemporalFilterDepth)
+        || (mTemporalFilterTolerance <= 0)) {
+        LOG_ERROR("temporal-filter-depth must be between 1 and " << TemporalRangeFilter::kMaxDepth
+            << ", temporal-filter-support between 1 and the depth and temporal-filter-tolerance positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureTemporalFilter(mTemporalFilter, mTemporalFilterDepth, mTemporalFilterSupport,
+                                   static_cast<float>(mTemporalFilterTolerance));
+
+    if ((mOdometryColumnStep < 1) || (mOdometryMaxDistance <= 0) || (mOdometryMaxIterations < 1) || (mOdometryBudget <= 0)) {
+        LOG_ERROR("odometry-column-step, odometry-max-distance, odometry-max-iterations and odometry-budget must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureOdometry(mOdometry, mOdometryColumnStep, static_cast<float>(mOdometryMaxDistance),
+                             mOdometryMaxIterations, static_cast<qint64>(mOdometryBudget * 1e6));
+
+    if ((mRenderPath != "scene") && (mRenderPath != "window")) {
+        LOG_ERROR("unknown render-path '" << mRenderPath << "'");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if (mBenchmarkFrames < 0) {
+        LOG_ERROR("benchmark-frames must not be negative");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->configureView(mRenderPath == "window", mBenchmarkFrames);
+    QStringList const viewports = QString::fromStdString(mViewports).split(',');
+    if (!mImpl->setViewports(viewports)) {
+        LOG_ERROR("viewports must be a comma-separated list of top, side and chase, got '" << mViewports << "'");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if ((mRenderPath == "window") && (viewports.size() > 1)) {
+        LOG_WARN("the window render path shows a single viewport");
+    }
+
+    if (mShmSlots < 2) {
+        LOG_ERROR("shm-slots must be at least 2");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if (mShmCapacity < 0) {
+        LOG_ERROR("shm-capacity must not be negative");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    int const shmCapacity = (mShmCapacity > 0) ? mShmCapacity : mImpl->converter().laserCount() * mAzimuthBins;
+    mImpl->configureSharing(QString::fromStdString(mShmName), mShmSlots, shmCapacity);
+
+    ExportFormat exportFormat;
+    if (!parseExportFormat(mExportFormat, exportFormat)) {
+        LOG_ERROR("unknown export-format '" << mExportFormat << "'");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    if (mExportQueueCapacity <= 0) {
+        LOG_ERROR("export-queue-capacity must be positive");
+        return ComponentBase::CONFIGURED_FAILED;
+    }
+    mImpl->exporter().configure(QString::fromStdString(mExportDirectory), exportFormat, mExportQueueCapacity);
     return ComponentBase::CONFIGURED_OK;
 }
 
+void LidarViewer::sendScan(LidarScan const& scan)
+{
+    checkedSend(mScanOutput, scan);
+}
+
 //////////////////////////////////////////////////////////////////////////
 void LidarViewer::processScan(LidarScan const& scan)
 {
     mImpl->processScan(scan);
 }
 
-void LidarViewer::processOccgrid(cv::Mat const& scan)
+void LidarViewer::processOccgrid(cv::Mat const& grid)
 {
-   // mImpl->processScan(scan);
+    mImpl->processOccupancyGrid(grid);
 }
 //////////////////////////////////////////////////////////////////////////
 void LidarViewer::processLines(LineCloud3D const& lines)
@@ -101,89 +365,12 @@ void LidarViewer::processLines(LineCloud3D const& lines)
 
 void LidarViewer::processVelodyne(VelodynePolarData const& velodyne_re)
 {
-	counter++;
-	if (counter==30)
-	{
-		//shmem_velodyne->read(velodyne_mem,sizeof(VelodynePolarData));
-	//VelodynePolarData lidardata;
-	//memcpy( &lidardata, velodyne_mem, sizeof(VelodynePolarData));
-	
-	
-	   toRad = 3.1415926/180.0;
-
-     
-       resFov = 1.33 * toRad;
-	    beta = 10.67* toRad - resFov * 32;
-    for (int j=0; j < 32; ++j)
-     {
-				
-	   
-        for (int i=0; i < velodyne_re.range; ++i)
-        {
-            alpha = ((velodyne_re.polarData[i].angle) / 100.0) * toRad;
-		///if (j==10)	cout<<"angle  "<<i<<"  :  "<<velodyne_re.polarData[i].angle/ 100.0<<endl;
-		
-               
-            
-            // boucle pour les 32 impacts
-           
-            
-				//cout<<"distance"<<lidardata.polarData[i].rawPoints[j].distance<<endl;
-				
-			 
-			 d = (velodyne_re.polarData[i].rawPoints[j].distance) / 500.0 ; // increments de 2mm => /500 pour avoir des m + correction (en cm)
-			//LOG_INFO(d);
-			//LOG_INFO(i);
-                // suppression des points trop proches
-                if (d < 1.5)
-                    continue;
-
-                // Application des corrections du LIDAR (cf. doc velodyne)  
-                 cosVertAngle = cos(beta);
-                 sinVertAngle = sin(beta);
-
-                 cosRotAngle = cos(alpha );
-                 sinRotAngle = sin(alpha);
-
-                //double hOffsetCorr = m_hOffsetCor[j+k] / 100.0;
-               // double vOffsetCorr = m_vOffsetCor[j+k] / 100.0;
-	
-                dxy = d * cosVertAngle;
-                X = dxy * sinRotAngle ;  // x
-                Y = dxy * cosRotAngle  ; // y
-                Z = d   * sinVertAngle ; // z
-                // add point
-            
-
-                // on met a jour beta
-             
-
-			intensity_m=velodyne_re.polarData[j].rawPoints[i].intensity;
-		
-			point_m.x=X;
-			point_m.y=Y;
-			point_m.z=Z;
-			point_m.intensity=intensity_m;
-			layer_m.points.push_back(point_m);
-			layer_m.angle=beta;
-			layer_m.id=j;
-		  
-
-            }
-
-		 beta += resFov; // 26.8 FOV vertical
-		scan_rec.layers.push_back(layer_m);
-
-		//cout<<"layers number:  "<<scan_rec.getLayerCount()<<endl;
-        }
-		
-
-	}
-
-		processScan(scan_rec);
-		//LOG_INFO("point yyyyyy=  "<<scan_rec.layers[2].points[6].x);	
-	///mImpl->processScan(scan_rec);
-	
-	//	std::cout << "start angle is " << scan_rec.layers[5].points[4].x << std::endl;
+    LIDAR_TRACE_SCOPE("LidarViewer::processVelodyne");
+    mImpl->ingestVelodyne(velodyne_re);
+}
 
-}
\ No newline at end of file
+void LidarViewer::processVelodyneBlocks(VelodynePolarData const& blocks)
+{
+    LIDAR_TRACE_SCOPE("LidarViewer::processVelodyneBlocks");
+    mImpl->ingestVelodyneBlocks(blocks);
+}
@@ -19,6 +19,7 @@
 #include "LidarViewerConfig.h"
 #include "structure/structure_velodyne.h"
 #include <Pacpus/kernel/ComponentBase.h>
+#include <Pacpus/kernel/InputOutputInterface.h>
 #include "PacpusTools/ShMem.h"
 #include <structure/LineCloud.h>
 #include "structure/GenericLidar.h"
@@ -27,6 +28,7 @@
 #include <QThread>
 #include "opencv2/core/core.hpp"
 #include <QSharedPointer>
+#include <string>
 
 namespace pacpus
 {
@@ -53,6 +55,8 @@ public:
     void processLines(LineCloud3D const& lines);
     void processScan(LidarScan const& scan);
 		void processVelodyne(VelodynePolarData const& velodyne_rec);
+    /// Partial revolution, the first `range` blocks were just received
+    void processVelodyneBlocks(VelodynePolarData const& blocks);
 	VelodynePolarData velodyne_rec;
 
 //public Q_SLOTS:
@@ -66,29 +70,79 @@ private:
 
 private:
     class Impl;
+
+    /// Sends a converted sweep on the "scan" output, from the convert stage
+    void sendScan(LidarScan const& scan);
+
     boost::scoped_ptr<Impl> mImpl;
+    OutputInterface<LidarScan, LidarViewer>* mScanOutput;
 	QThread mThread; 
-	   double toRad ;
-
-        double d;    // distance reu par le velodyne
-        double X, Y, Z;
-        double dxy;  // distance XY
-        double alpha;// angle azimuth
-        double beta; // angle elevation
-		double cosVertAngle ;
-        double sinVertAngle ;
-        double cosRotAngle ;
-        double sinRotAngle ;
-        // resolution de l'angle d'ouverture
-        double resFov;
-		LidarScan scan_rec;
-        int intensity_m;
+
 			void*  velodyne_mem;
 		ShMem * shmem_velodyne; 	
-		int counter;
-		LidarLayer layer_m;
-		LidarPoint point_m;
 
+    /// Velodyne model decoding the raw blocks, see VelodyneConverter::models()
+    std::string mSensorModel;
+    /// Per-laser calibration file, empty for the nominal elevations of the model
+    std::string mCalibrationFile;
+    int mAzimuthBins;
+
+    /// region of interest [m, deg], a max range or box length of 0 disables it
+    double mRoiMinRange, mRoiMaxRange;
+    double mRoiMinAzimuth, mRoiMaxAzimuth;
+    double mRoiMinZ, mRoiMaxZ;
+    double mRoiBoxX, mRoiBoxY, mRoiBoxYaw, mRoiBoxLength, mRoiBoxWidth;
+
+    int mIngestQueueCapacity, mPublishQueueCapacity;
+    std::string mIngestQueuePolicy, mPublishQueuePolicy;
+    int mStreamSectors;
+    /// [ms]
+    double mTargetFrameTime;
+
+    std::string mMapFile;
+    /// [m]
+    double mMapTileSize;
+    /// [MiB]
+    int mMapMemoryBudget;
+
+    bool mBirdEyeGrid;
+    /// [m]
+    double mBirdEyeCellSize, mBirdEyeExtent;
+    double mOccupancyCellSize;
+
+    bool mClusters;
+    /// [m]
+    double mClusterTolerance, mClusterMinZ;
+    int mClusterMinPoints;
+
+    bool mChangeDetection;
+    /// [m]
+    double mChangeVoxelSize;
+    int mChangeBackgroundSweeps;
+
+    bool mTemporalFilter;
+    int mTemporalFilterDepth, mTemporalFilterSupport;
+    /// [m]
+    double mTemporalFilterTolerance;
+
+    bool mOdometry;
+    int mOdometryColumnStep;
+    /// [m]
+    double mOdometryMaxDistance;
+    int mOdometryMaxIterations;
+    /// [ms]
+    double mOdometryBudget;
+
+    std::string mRenderPath;
+    std::string mViewports;
+    int mBenchmarkFrames;
+
+    /// shared memory of the converted sweeps, empty to disable
+    std::string mShmName;
+    int mShmSlots, mShmCapacity;
+
+    std::string mExportDirectory, mExportFormat;
+    int mExportQueueCapacity;
 };
 
 } // namespace pacpus
@@ -5,9 +5,14 @@
 
 #include "LidarViewer.h"
 #include "LidarViewerImpl.h"
+#include "LidarTrace.h"
 
 #include <Pacpus/kernel/Log.h>
 #include <structure/GenericLidar.h>
+
+#include <algorithm>
+#include <cstring>
+#include <QMutexLocker>
 //#include "structure/structure_telemetre.h"
 
 //using namespace boost;
@@ -16,10 +21,74 @@ using namespace pacpus;
 
 DECLARE_STATIC_LOGGER("pacpus.LidarViewer.Impl");
 
+/// Export statistics are logged every this many published sweeps
+static const unsigned long kExportStatisticsPeriod = 100;
+/// Odometry timings are logged every this many registered sweeps
+static const int kOdometryStatisticsPeriod = 50;
+
+static const int kDefaultStreamSectorCount = 36;
+static const std::size_t kStreamQueueCapacity = 256;
+/// A block more than half a turn behind the previous one starts a new revolution
+static const int kHalfTurn = 18000;
+
+static int blockCapacity()
+{
+    return sizeof(VelodynePolarData().polarData) / sizeof(VelodynePolarData().polarData[0]);
+}
+
+//////////////////////////////////////////////////////////////////////////
+class LidarViewer::Impl::ConvertThread
+    : public QThread
+{
+public:
+    typedef void (LidarViewer::Impl::*Loop)();
+
+    ConvertThread(LidarViewer::Impl* impl, Loop loop)
+        : mImpl(impl)
+        , mLoop(loop)
+    {
+    }
+
+protected:
+    void run() /* override */
+    {
+        (mImpl->*mLoop)();
+    }
+
+private:
+    LidarViewer::Impl* mImpl;
+    Loop mLoop;
+};
+
 //////////////////////////////////////////////////////////////////////////
 LidarViewer::Impl::Impl(LidarViewer* parent)
     : mParent(parent)
+    , mTargetFrameTime(16)
+    , mIngestQueue(2, QOP_DropOldest)
+    , mPublishQueue(2, QOP_DropOldest)
+    , mStreamSectorCount(kDefaultStreamSectorCount)
+    , mAssemblyAngle(0)
+    , mStreamQueue(kStreamQueueCapacity, QOP_DropOldest)
+    , mStreamRevolutionCount(0)
+    , mSectorQueue(2 * kDefaultStreamSectorCount, QOP_DropOldest)
+    , mBirdEyeEnabled(false)
+    , mClustersEnabled(true)
+    , mChangeDetectionEnabled(false)
+    , mTemporalFilterEnabled(false)
+    , mOdometryEnabled(false)
+    , mOdometryBudget(0)
+    , mOccupancyQueue(2, QOP_DropOldest)
+    , mOccupancyCellSize(0.2f)
+    , mLinesQueue(2, QOP_DropOldest)
+    , mShareSlotCount(4)
+    , mShareSlotCapacity(0)
+    , mMapTileSize(25)
+    , mMapMemoryBudget(0)
+    , mContinuousExport(false)
+    , mPublishedCount(0)
 {
+    memset(&mTemporalFilterStatistics, 0, sizeof(mTemporalFilterStatistics));
+    memset(&mOdometryStatistics, 0, sizeof(mOdometryStatistics));
 	lidarScan = new LidarScan(4);
 		
 	lidarScan->layers[0].id = 1;
@@ -27,31 +96,289 @@ LidarViewer::Impl::Impl(LidarViewer* parent)
 	lidarScan->layers[2].id = 3;
 	lidarScan->layers[3].id = 4;	
 	
+    mConvertThread.reset(new ConvertThread(this, &Impl::convertLoop));
+    mConvertThread->setObjectName("LidarViewer convert");
+    mStreamThread.reset(new ConvertThread(this, &Impl::streamLoop));
+    mStreamThread->setObjectName("LidarViewer stream");
+}
+
+void LidarViewer::Impl::configureQueues(std::size_t ingestCapacity, QueueOverflowPolicy ingestPolicy,
+                                        std::size_t publishCapacity, QueueOverflowPolicy publishPolicy)
+{
+    mIngestQueue.configure(ingestCapacity, ingestPolicy);
+    mPublishQueue.configure(publishCapacity, publishPolicy);
+    mStreamQueue.configure(kStreamQueueCapacity, ingestPolicy);
+}
+
+void LidarViewer::Impl::configureStreamConverter()
+{
+    // its own crop statistics are kept
+    mStreamConverter.setModel(mConverter.model());
+    mStreamConverter.calibration() = mConverter.calibration();
+    mStreamConverter.setColumnCount(mConverter.columnCount());
+    mStreamConverter.setCrop(mConverter.crop());
+}
+
+void LidarViewer::Impl::configureMap(QString const& path, float tileSize, qint64 memoryBudget)
+{
+    mMapPath = path;
+    mMapTileSize = tileSize;
+    mMapMemoryBudget = memoryBudget;
+}
+
+void LidarViewer::Impl::configureSharing(QString const& key, int slotCount, int slotCapacity)
+{
+    mShareKey = key;
+    mShareSlotCount = slotCount;
+    mShareSlotCapacity = slotCapacity;
+}
+
+void LidarViewer::Impl::configureView(bool glWindow, int benchmarkFrames)
+{
+    // only the selected view is built, the other one never gets its scene
+    if (glWindow && !mGLView) {
+        mView.reset();
+        mGLView.reset(new LidarGLView);
+        connect(mGLView.get(), &LidarGLView::snapshotRequested, this, &Impl::exportSnapshot);
+        connect(mGLView.get(), &LidarGLView::continuousExportToggled, this, &Impl::toggleContinuousExport);
+    } else if (!glWindow && !mView) {
+        mGLView.reset();
+        mView.reset(new LidarView);
+        mView->setTargetFrameTime(mTargetFrameTime);
+        connect(mView.get(), &LidarView::snapshotRequested, this, &Impl::exportSnapshot);
+        connect(mView.get(), &LidarView::continuousExportToggled, this, &Impl::toggleContinuousExport);
+    }
+    if (mGLView) {
+        mGLView->setBenchmarkFrames(benchmarkFrames);
+    } else {
+        mView->setBenchmarkFrames(benchmarkFrames);
+    }
+}
+
+void LidarViewer::Impl::setTargetFrameTime(double targetFrameTime)
+{
+    mTargetFrameTime = targetFrameTime;
+    if (mView) {
+        mView->setTargetFrameTime(targetFrameTime);
+    }
+}
+
+bool LidarViewer::Impl::setViewports(QStringList const& presets)
+{
+    // the OpenGL window has a single camera of its own
+    return !mView || mView->setViewports(presets);
+}
+
+void LidarViewer::Impl::configureBirdEye(bool enabled, float cellSize, float halfExtent)
+{
+    QMutexLocker lock(&mBirdEyeMutex);
+    mBirdEyeEnabled = enabled;
+    mBirdEye.configure(cellSize, halfExtent);
+}
+
+void LidarViewer::Impl::configureClusters(bool enabled, float tolerance, float minZ, int minPoints)
+{
+    QMutexLocker lock(&mClusterMutex);
+    mClustersEnabled = enabled;
+    mClusterer.configure(tolerance, minZ, minPoints);
+}
+
+void LidarViewer::Impl::configureChangeDetection(bool enabled, float voxelSize, int backgroundSweeps)
+{
+    QMutexLocker lock(&mChangeMutex);
+    mChangeDetectionEnabled = enabled;
+    mChangeDetector.configure(voxelSize, backgroundSweeps);
+}
+
+void LidarViewer::Impl::configureTemporalFilter(bool enabled, int depth, int minSupport, float tolerance)
+{
+    QMutexLocker lock(&mTemporalFilterMutex);
+    mTemporalFilterEnabled = enabled;
+    mTemporalFilter.configure(depth, minSupport, tolerance);
+}
+
+void LidarViewer::Impl::configureOdometry(bool enabled, int columnStep, float maxDistance, int maxIterations, qint64 budget)
+{
+    QMutexLocker lock(&mOdometryMutex);
+    mOdometryEnabled = enabled;
+    mOdometryBudget = budget;
+    mRegistration.configure(columnStep, maxDistance, maxIterations, budget);
 }
 
 //////////////////////////////////////////////////////////////////////////
 void LidarViewer::Impl::start()
 {
-	m_isRunning = false;
-    mView.show();
+    mIngestQueue.reopen();
+    mPublishQueue.reopen();
+    mStreamQueue.reopen();
+    mSectorQueue.configure(2 * mStreamSectorCount, QOP_DropOldest);
+    mSectorQueue.reopen();
+    mOccupancyQueue.reopen();
+    mLinesQueue.reopen();
+    {
+        QMutexLocker lock(&mTemporalFilterMutex);
+        mTemporalFilter.reset();
+        memset(&mTemporalFilterStatistics, 0, sizeof(mTemporalFilterStatistics));
+    }
+    {
+        QMutexLocker lock(&mOdometryMutex);
+        mRegistration.reset();
+        memset(&mOdometryStatistics, 0, sizeof(mOdometryStatistics));
+    }
+    mConvertThread->start();
+    mStreamThread->start();
+    mExporter.start();
+    if (!mShareKey.isEmpty()) {
+        // the viewer still runs without it
+        mShareRing.create(mShareKey, mShareSlotCount, mShareSlotCapacity);
+    }
+    // still recorded with the OpenGL window, which does not draw it
+    if (!mMapPath.isEmpty() && mMap.open(mMapPath, mMapTileSize) && mView) {
+        mView->setMap(&mMap, mMapMemoryBudget);
+    }
+    if (mGLView) {
+        mGLView->show();
+    } else {
+        mView->show();
+    }
 }
 
 void LidarViewer::Impl::stop()
 {	
-    mView.setVisible(false);
-	mView.close();
+    if (mView) {
+        mView->setVisible(false);
+        mView->close();
+    }
+    if (mGLView) {
+        mGLView->close();
+    }
 
-	while(m_isRunning == true) ;
-		//msleep(10);
+    // wakes up the blocked stages, the convert stage returns
+    mIngestQueue.close();
+    mPublishQueue.close();
+    mStreamQueue.close();
+    mSectorQueue.close();
+    mOccupancyQueue.close();
+    mLinesQueue.close();
+    mConvertThread->wait();
+    mStreamThread->wait();
+    mAssembly.clear();
+    if (mShareRing.isOpen()) {
+        SweepRingWriter::Statistics const shared = mShareRing.statistics();
+        LOG_INFO("shared memory: written=" << shared.written << " truncated=" << shared.truncated);
+        mShareRing.close();
+    }
+    mContinuousExport = false;
+    mLastSweep.clear();
+    mExporter.stop();
+    if (mMap.isOpen()) {
+        logMapStatistics();
+        if (mView) {
+            mView->setMap(NULL, mMapMemoryBudget);
+        }
+        mMap.close();
+    }
 
+    logQueueStatistics();
+    logCropStatistics();
+    if (mTemporalFilterEnabled) {
+        logTemporalFilterStatistics();
+    }
+    logExportStatistics();
+    if (mOdometryStatistics.sweeps > 0) {
+        logOdometryStatistics();
+    }
 	LOG_INFO("stopped component '" << mParent->getName() << "'");
 }
 
 LidarViewer::Impl::~Impl()
 {
+    mIngestQueue.close();
+    mPublishQueue.close();
+    mStreamQueue.close();
+    mSectorQueue.close();
+    mOccupancyQueue.close();
+    mLinesQueue.close();
+    mConvertThread->wait();
+    mStreamThread->wait();
     delete lidarScan;
 }
 
+void LidarViewer::Impl::logQueueStatistics() const
+{
+    LOG_INFO("ingest queue: depth=" << mIngestQueue.depth() << "/" << mIngestQueue.capacity()
+        << " pushed=" << mIngestQueue.pushCount() << " dropped=" << mIngestQueue.dropCount());
+    LOG_INFO("publish queue: depth=" << mPublishQueue.depth() << "/" << mPublishQueue.capacity()
+        << " pushed=" << mPublishQueue.pushCount() << " dropped=" << mPublishQueue.dropCount());
+    if (mStreamQueue.pushCount() > 0) {
+        LOG_INFO("stream queue: pushed=" << mStreamQueue.pushCount() << " dropped=" << mStreamQueue.dropCount()
+            << ", sector queue: pushed=" << mSectorQueue.pushCount() << " dropped=" << mSectorQueue.dropCount());
+    }
+
+    SweepPool::Statistics const sweeps = mSweepPool.statistics();
+    LOG_INFO("sweeps: acquired=" << sweeps.acquired << " allocated=" << sweeps.allocated
+        << " layer reallocations=" << sweeps.layerReallocations
+        << " mean acquire time=" << (sweeps.acquired ? sweeps.acquireTime / 1000.0 / sweeps.acquired : 0.0) << " us");
+}
+
+void LidarViewer::Impl::logCropStatistics() const
+{
+    // the convert threads are stopped
+    VelodyneConverter::CropStatistics crop = mConverter.cropStatistics();
+    VelodyneConverter::CropStatistics const& streamed = mStreamConverter.cropStatistics();
+    crop.kept += streamed.kept;
+    crop.collisions += streamed.collisions;
+    for (int filter = 0; filter < VelodyneConverter::CF_Count; ++filter) {
+        crop.rejected[filter] += streamed.rejected[filter];
+    }
+    LOG_INFO("region of interest: kept=" << crop.kept
+        << " rejected by range=" << crop.rejected[VelodyneConverter::CF_Range]
+        << " azimuth=" << crop.rejected[VelodyneConverter::CF_Azimuth]
+        << " height=" << crop.rejected[VelodyneConverter::CF_Height]
+        << " box=" << crop.rejected[VelodyneConverter::CF_Box]
+        << " lost to cell collisions=" << crop.collisions);
+}
+
+void LidarViewer::Impl::logTemporalFilterStatistics() const
+{
+    // the convert threads are stopped
+    TemporalFilterStatistics const& statistics = mTemporalFilterStatistics;
+    unsigned long const sweeps = std::max(1UL, statistics.sweeps);
+    LOG_INFO("temporal filter: sweeps=" << statistics.sweeps << " rejected=" << statistics.rejected
+        << " mean time=" << statistics.totalTime / 1e6 / sweeps << " ms"
+        << " max time=" << statistics.maxTime / 1e6 << " ms");
+}
+
+void LidarViewer::Impl::logMapStatistics() const
+{
+    TiledMap::Statistics const statistics = mMap.statistics();
+    LOG_INFO("map: tiles=" << statistics.tileCount << " points=" << statistics.pointCount
+        << " file size=" << statistics.fileSize / (1024 * 1024) << " MiB"
+        << " dropped sweeps=" << statistics.droppedSweeps);
+}
+
+void LidarViewer::Impl::logOdometryStatistics()
+{
+    OdometryStatistics& statistics = mOdometryStatistics;
+    int const sweeps = std::max(1, statistics.sweeps);
+    LOG_INFO("odometry: sweeps=" << statistics.sweeps
+        << " mean time=" << statistics.totalTime / 1e6 / sweeps << " ms"
+        << " max time=" << statistics.maxTime / 1e6 << " ms"
+        << " mean iterations=" << static_cast<double>(statistics.iterations) / sweeps
+        << " converged=" << statistics.converged << " over budget=" << statistics.overBudget);
+    QMatrix4x4 const& pose = mRegistration.pose();
+    LOG_INFO("odometry: position=(" << pose(0, 3) << ", " << pose(1, 3) << ", " << pose(2, 3) << ") m");
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+void LidarViewer::Impl::logExportStatistics() const
+{
+    PointCloudExporter::Statistics const statistics = mExporter.statistics();
+    LOG_INFO("export: written=" << statistics.written << " dropped=" << statistics.dropped
+        << " bytes=" << statistics.bytes
+        << " throughput=" << statistics.bytesPerSecond / (1024 * 1024) << " MiB/s");
+}
+
 //////////////////////////////////////////////////////////////////////////
 //void LidarViewer::Impl::outputData()
 //{
@@ -60,14 +387,385 @@ LidarViewer::Impl::~Impl()
 //}
 
 //////////////////////////////////////////////////////////////////////////
+void LidarViewer::Impl::ingestVelodyne(VelodynePolarData const& data)
+{
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::ingestVelodyne");
+    QSharedPointer<VelodynePolarData const> raw(new VelodynePolarData(data));
+    mIngestQueue.push(raw);
+}
+
+void LidarViewer::Impl::convertLoop()
+{
+    QSharedPointer<VelodynePolarData const> raw;
+    while (mIngestQueue.pop(raw)) {
+        LIDAR_TRACE_SCOPE("LidarViewer::Impl::convert");
+        QSharedPointer<LidarSweep> sweep = mSweepPool.acquire();
+        sweep->streamed = false;
+        mConverter.convert(*raw, sweep->image);
+        filterRanges(*sweep);
+        sweep->points.fromImage(sweep->image);
+        mSweepPool.addLayerReallocations(sweep->points.toScan(sweep->scan));
+        raw.clear();
+        registerSweep(*sweep);
+        computeBirdEye(*sweep);
+        computeClusters(*sweep);
+        detectChanges(*sweep);
+        shareSweep(*sweep);
+
+        queueForPublishing(sweep);
+    }
+}
+
+void LidarViewer::Impl::ingestVelodyneBlocks(VelodynePolarData const& data)
+{
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::ingestVelodyneBlocks");
+    qint64 const arrivalTime = TraceRecorder::now();
+    int const blockCount = std::min(static_cast<int>(data.range), blockCapacity());
+
+    StreamChunk chunk;
+    chunk.arrivalTime = arrivalTime;
+    chunk.blockCount = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        int const angle = data.polarData[i].angle;
+        bool const wrapped = mAssembly && (angle + kHalfTurn < mAssemblyAngle);
+        if (!mAssembly || wrapped || (static_cast<int>(mAssembly->range) >= blockCapacity())) {
+            if (chunk.blockCount > 0) {
+                mStreamQueue.push(chunk);
+            }
+            // the previous revolution stays alive until converted
+            mAssembly.reset(new VelodynePolarData);
+            mAssembly->range = 0;
+            chunk.revolution = mAssembly;
+            chunk.firstBlock = 0;
+            chunk.blockCount = 0;
+        } else if (chunk.blockCount == 0) {
+            chunk.revolution = mAssembly;
+            chunk.firstBlock = static_cast<int>(mAssembly->range);
+        }
+        // blocks already queued are never written again
+        mAssembly->polarData[mAssembly->range] = data.polarData[i];
+        ++mAssembly->range;
+        ++chunk.blockCount;
+        mAssemblyAngle = angle;
+    }
+    if (chunk.blockCount > 0) {
+        mStreamQueue.push(chunk);
+    }
+}
+
+void LidarViewer::Impl::streamLoop()
+{
+    StreamChunk chunk;
+    while (mStreamQueue.pop(chunk)) {
+        LIDAR_TRACE_SCOPE("LidarViewer::Impl::streamChunk");
+        if (chunk.revolution != mStreamRevolution) {
+            finishStreamedRevolution();
+            mStreamRevolution = chunk.revolution;
+            mStreamSweep = mSweepPool.acquire();
+            mStreamSweep->streamed = true;
+            ++mStreamRevolutionCount;
+            mStreamConverter.beginRevolution(mStreamSweep->image);
+        }
+
+        VelodyneRangeImage& image = mStreamSweep->image;
+        mStreamConverter.convertBlocks(*chunk.revolution, chunk.firstBlock, chunk.blockCount, image);
+
+        // sectors touched by the chunk, azimuths increase within a revolution,
+        // only the scene draws them: the OpenGL window shows whole sweeps
+        if (mView) {
+            int const colsPerSector = (image.cols() + mStreamSectorCount - 1) / mStreamSectorCount;
+            int const firstSector = image.columnOf(chunk.revolution->polarData[chunk.firstBlock].angle) / colsPerSector;
+            int const lastSector = image.columnOf(chunk.revolution->polarData[chunk.firstBlock + chunk.blockCount - 1].angle) / colsPerSector;
+            if (lastSector < firstSector) {
+                queueSector(firstSector, chunk.arrivalTime);
+                queueSector(lastSector, chunk.arrivalTime);
+            } else {
+                for (int sector = firstSector; sector <= lastSector; ++sector) {
+                    queueSector(sector, chunk.arrivalTime);
+                }
+            }
+        }
+        chunk.revolution.clear();
+    }
+    mStreamRevolution.clear();
+    mStreamSweep.clear();
+}
+
+void LidarViewer::Impl::finishStreamedRevolution()
+{
+    if (!mStreamSweep) {
+        return;
+    }
+    filterRanges(*mStreamSweep);
+    mStreamSweep->points.fromImage(mStreamSweep->image);
+    mSweepPool.addLayerReallocations(mStreamSweep->points.toScan(mStreamSweep->scan));
+    registerSweep(*mStreamSweep);
+    computeBirdEye(*mStreamSweep);
+    computeClusters(*mStreamSweep);
+    detectChanges(*mStreamSweep);
+    shareSweep(*mStreamSweep);
+    queueForPublishing(mStreamSweep);
+    mStreamSweep.clear();
+    mStreamRevolution.clear();
+}
+
+void LidarViewer::Impl::queueSector(int index, qint64 arrivalTime)
+{
+    VelodyneRangeImage const& image = mStreamSweep->image;
+    int const colsPerSector = (image.cols() + mStreamSectorCount - 1) / mStreamSectorCount;
+    int const firstCol = index * colsPerSector;
+    int const lastCol = std::min(image.cols(), firstCol + colsPerSector);
+
+    QSharedPointer<LidarSector> sector(new LidarSector);
+    sector->index = index;
+    sector->revolution = mStreamRevolutionCount;
+    sector->sectorCount = mStreamSectorCount;
+    sector->capacity = image.rows() * colsPerSector;
+    sector->arrivalTime = arrivalTime;
+    sector->points.reserve(sector->capacity);
+    for (int row = 0; row < image.rows(); ++row) {
+        float const* x = image.xRow(row);
+        float const* y = image.yRow(row);
+        float const* z = image.zRow(row);
+        unsigned char const* valid = image.validRow(row);
+        for (int col = firstCol; col < lastCol; ++col) {
+            if (!valid[col]) {
+                continue;
+            }
+            LidarSector::Point point;
+            point.x = x[col];
+            point.y = y[col];
+            point.z = z[col];
+            point.layer = row;
+            sector->points.push_back(point);
+        }
+    }
+
+    if (mSectorQueue.push(sector)) {
+        QMetaObject::invokeMethod(this, "publishSectors", Qt::QueuedConnection);
+    }
+}
+
+void LidarViewer::Impl::publishSectors()
+{
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::publishSectors");
+    LidarSectorPtr sector;
+    while (mSectorQueue.tryPop(sector)) {
+        if (mView) {
+            mView->display(sector);
+        }
+    }
+}
+
+void LidarViewer::Impl::filterRanges(LidarSweep& sweep)
+{
+    QMutexLocker lock(&mTemporalFilterMutex);
+    if (!mTemporalFilterEnabled) {
+        return;
+    }
+    LIDAR_TRACE_SCOPE("TemporalRangeFilter::process");
+    qint64 const begin = TraceRecorder::now();
+    int const rejected = mTemporalFilter.process(sweep.image);
+    qint64 const time = TraceRecorder::now() - begin;
+
+    TemporalFilterStatistics& statistics = mTemporalFilterStatistics;
+    ++statistics.sweeps;
+    statistics.rejected += rejected;
+    statistics.totalTime += time;
+    statistics.maxTime = std::max(statistics.maxTime, time);
+}
+
+void LidarViewer::Impl::registerSweep(LidarSweep& sweep)
+{
+    QMutexLocker lock(&mOdometryMutex);
+    if (!mOdometryEnabled) {
+        sweep.pose.setToIdentity();
+        return;
+    }
+    {
+        LIDAR_TRACE_SCOPE("SweepRegistration::process");
+        sweep.pose = mRegistration.process(sweep.image);
+    }
+
+    SweepRegistration::Result const& result = mRegistration.lastResult();
+    for (std::size_t i = 0; i < result.iterations.size(); ++i) {
+        SweepRegistration::Iteration const& iteration = result.iterations[i];
+        LOG_DEBUG("odometry iteration " << i << ": correspondences=" << iteration.correspondences
+            << " rms=" << iteration.rmsError << " m time=" << iteration.time / 1e6 << " ms");
+    }
+    if (result.iterations.empty()) {
+        // first sweep or new image size, nothing to register onto
+        return;
+    }
+    OdometryStatistics& statistics = mOdometryStatistics;
+    ++statistics.sweeps;
+    statistics.iterations += static_cast<int>(result.iterations.size());
+    statistics.converged += result.converged;
+    statistics.overBudget += (result.time > mOdometryBudget);
+    statistics.totalTime += result.time;
+    statistics.maxTime = std::max(statistics.maxTime, result.time);
+    if (statistics.sweeps == kOdometryStatisticsPeriod) {
+        logOdometryStatistics();
+    }
+}
+
+void LidarViewer::Impl::computeBirdEye(LidarSweep& sweep)
+{
+    QMutexLocker lock(&mBirdEyeMutex);
+    if (!mBirdEyeEnabled) {
+        sweep.birdEye.release();
+        return;
+    }
+    LIDAR_TRACE_SCOPE("BirdEyeGrid::compute");
+    mBirdEye.compute(sweep.points, sweep.birdEye);
+    sweep.birdEyeCellSize = mBirdEye.cellSize();
+}
+
+void LidarViewer::Impl::computeClusters(LidarSweep& sweep)
+{
+    QMutexLocker lock(&mClusterMutex);
+    if (!mClustersEnabled) {
+        sweep.clusters.clear();
+        return;
+    }
+    LIDAR_TRACE_SCOPE("SweepClusterer::cluster");
+    mClusterer.cluster(sweep.image, sweep.clusters);
+}
+
+void LidarViewer::Impl::detectChanges(LidarSweep& sweep)
+{
+    QMutexLocker lock(&mChangeMutex);
+    if (!mChangeDetectionEnabled) {
+        sweep.dynamic.clear();
+        return;
+    }
+    LIDAR_TRACE_SCOPE("ChangeDetector::process");
+    mChangeDetector.process(sweep.points, sweep.dynamic);
+}
+
+void LidarViewer::Impl::shareSweep(LidarSweep const& sweep)
+{
+    {
+        QMutexLocker lock(&mShareMutex);
+        if (mShareRing.isOpen()) {
+            LIDAR_TRACE_SCOPE("SweepRingWriter::write");
+            mShareRing.write(sweep.scan);
+        }
+    }
+    mParent->sendScan(sweep.scan);
+}
+
+void LidarViewer::Impl::queueForPublishing(LidarSweepPtr const& sweep)
+{
+    if (mMap.isOpen()) {
+        // the sensor frame unless odometry is enabled
+        mMap.enqueue(sweep, sweep->pose);
+    }
+    if (mPublishQueue.push(sweep)) {
+        QMetaObject::invokeMethod(this, "publishSweep", Qt::QueuedConnection);
+    }
+}
+
+void LidarViewer::Impl::publishSweep()
+{
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::publishSweep");
+    LidarSweepPtr sweep;
+    if (!mPublishQueue.tryPop(sweep)) {
+        // dropped by the overflow policy
+        return;
+    }
+
+    if (mGLView) {
+        mGLView->display(sweep);
+    } else {
+        mView->display(sweep);
+    }
+    mLastSweep = sweep;
+    ++mPublishedCount;
+
+    if (mContinuousExport) {
+        mExporter.enqueue(sweep);
+        if (mPublishedCount % kExportStatisticsPeriod == 0) {
+            logExportStatistics();
+        }
+    }
+}
+
+void LidarViewer::Impl::exportSnapshot()
+{
+    if (!mLastSweep) {
+        LOG_WARN("nothing to export yet");
+        return;
+    }
+    if (!mExporter.enqueue(mLastSweep)) {
+        LOG_WARN("export queue full, snapshot dropped");
+    }
+}
+
+void LidarViewer::Impl::toggleContinuousExport()
+{
+    mContinuousExport = !mContinuousExport;
+    LOG_INFO("continuous export " << (mContinuousExport ? "started" : "stopped"));
+    if (!mContinuousExport) {
+        logExportStatistics();
+    }
+}
+
 void LidarViewer::Impl::processScan(LidarScan const& scan)
 {
-    mView.display(scan);
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::processScan");
+    QSharedPointer<LidarSweep> sweep = mSweepPool.acquire();
+    sweep->image.resize(0, 0);
+    sweep->streamed = false;
+    sweep->scan = scan;
+    sweep->points.fromScan(scan);
+    // no image to register
+    sweep->pose.setToIdentity();
+    computeBirdEye(*sweep);
+    computeClusters(*sweep);
+    detectChanges(*sweep);
+    queueForPublishing(sweep);
+}
+
+void LidarViewer::Impl::processOccupancyGrid(cv::Mat const& grid)
+{
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::processOccupancyGrid");
+    // the sender may reuse its buffer
+    if (mOccupancyQueue.push(grid.clone())) {
+        QMetaObject::invokeMethod(this, "publishOccupancyGrid", Qt::QueuedConnection);
+    }
+}
+
+void LidarViewer::Impl::publishOccupancyGrid()
+{
+    cv::Mat grid;
+    while (mOccupancyQueue.tryPop(grid)) {
+        if (mGLView) {
+            mGLView->display(grid, mOccupancyCellSize);
+        } else {
+            mView->display(grid, mOccupancyCellSize);
+        }
+    }
 }
 
 void LidarViewer::Impl::processLines(LineCloud3D const& lines)
 {
-    mView.display(lines);
+    LIDAR_TRACE_SCOPE("LidarViewer::Impl::processLines");
+    // the scene is only touched from the GUI thread
+    if (mLinesQueue.push(lines)) {
+        QMetaObject::invokeMethod(this, "publishLines", Qt::QueuedConnection);
+    }
+}
+
+void LidarViewer::Impl::publishLines()
+{
+    LineCloud3D lines;
+    while (mLinesQueue.tryPop(lines)) {
+        // the OpenGL window does not draw the lines
+        if (mView) {
+            mView->display(lines);
+        }
+    }
 }
 
 //////////////////////////////////////////////////////////////////////////
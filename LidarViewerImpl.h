@@ -16,13 +16,59 @@
 #ifndef LIDARVIEWERIMPL_H
 #define LIDARVIEWERIMPL_H
 
+#include "BirdEyeGrid.h"
+#include "BoundedQueue.h"
+#include "ChangeDetector.h"
+#include "LidarGLView.h"
+#include "LidarSweep.h"
 #include "LidarView.h"
 #include "LidarViewer.h"
+#include "PointCloudExporter.h"
+#include "SweepClusterer.h"
+#include "SweepPool.h"
+#include "SweepRegistration.h"
+#include "SweepRing.h"
+#include "TemporalRangeFilter.h"
+#include "TiledMap.h"
+#include "VelodyneConverter.h"
 //#include <datatypes/Scan.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <QMutex>
 #include <QSharedPointer>
 namespace pacpus
 {
 
+/// Processing pipeline: ingest -> convert -> publish.
+///
+/// The ingest stage runs in the thread delivering the inputs and only queues
+/// the raw revolutions. The convert stage has its own thread. The publish
+/// stage runs in the GUI thread, which owns the view. Stages are separated
+/// by bounded queues.
+///
+/// Partial revolutions (a few blocks at a time) take a streaming path with
+/// its own convert thread: blocks are gathered into the revolution they
+/// belong to, a new one starting when the azimuth wraps. Each chunk is
+/// converted at once and the azimuth sectors it touched are published, the
+/// completed revolution is then published as a whole sweep.
+///
+/// Returns outside the region of interest are dropped by the converter, the
+/// rejections of each filter are logged when stopping. When enabled, the
+/// returns no recent sweep confirms are then dropped by the temporal range
+/// filter (the streamed sectors are shown before it runs).
+///
+/// Each sweep is binned into a bird's-eye grid before publishing, by the
+/// stage that produced it, its range image into obstacle clusters and its
+/// points compared to the previous sweeps for changes. When odometry is
+/// enabled, each Velodyne sweep is first registered onto the previous one
+/// and drawn and mapped at its odometry pose. Converted Velodyne sweeps are
+/// also written to the shared memory ring (SweepRing) and sent on the "scan"
+/// output. Occupancy grids received as images are displayed through the
+/// same path.
+///
+/// The publish stage displays in the LidarView (QGraphicsView) or, when
+/// selected, in the LidarGLView (core profile OpenGL window). Only the
+/// selected view is built; the window draws neither the lines nor the
+/// clusters, and no sectors are streamed to it.
 class LidarViewer::Impl
     : public QObject
 {
@@ -35,18 +81,185 @@ public:
     void start();
     void stop();
 
+    /// Converter of the convert stage, configured by the component
+    VelodyneConverter& converter() { return mConverter; }
+    /// Gives the streaming path the settings of converter(): model,
+    /// calibration, column count and crop
+    void configureStreamConverter();
+    PointCloudExporter& exporter() { return mExporter; }
+    void configureQueues(std::size_t ingestCapacity, QueueOverflowPolicy ingestPolicy,
+                         std::size_t publishCapacity, QueueOverflowPolicy publishPolicy);
+
+    /// Ingest stage: queues a raw revolution for conversion
+    void ingestVelodyne(VelodynePolarData const& data);
+    /// Ingest stage of the streaming path: the first `range` blocks are new
+    void ingestVelodyneBlocks(VelodynePolarData const& data);
+    void setStreamSectorCount(int sectorCount) { mStreamSectorCount = sectorCount; }
+    void setTargetFrameTime(double targetFrameTime);
+    /// @param path map file, empty to disable the map
+    void configureMap(QString const& path, float tileSize, qint64 memoryBudget);
+    void configureBirdEye(bool enabled, float cellSize, float halfExtent);
+    /// See SweepClusterer::configure()
+    void configureClusters(bool enabled, float tolerance, float minZ, int minPoints);
+    /// See ChangeDetector::configure()
+    void configureChangeDetection(bool enabled, float voxelSize, int backgroundSweeps);
+    /// See TemporalRangeFilter::configure()
+    void configureTemporalFilter(bool enabled, int depth, int minSupport, float tolerance);
+    /// See SweepRegistration::configure()
+    void configureOdometry(bool enabled, int columnStep, float maxDistance, int maxIterations, qint64 budget);
+    /// @param glWindow display through LidarGLView instead of LidarView
+    /// @param benchmarkFrames frames measured once the first sweep is shown, 0 for none
+    void configureView(bool glWindow, int benchmarkFrames);
+    /// Viewports of the LidarView, ignored by the OpenGL window
+    /// @returns false for an unknown viewport preset
+    bool setViewports(QStringList const& presets);
+    void setOccupancyCellSize(float cellSize) { mOccupancyCellSize = cellSize; }
+    /// @param key shared memory key, empty to disable sharing
+    void configureSharing(QString const& key, int slotCount, int slotCapacity);
+
     void processLines(LineCloud3D const& lines);
     void processScan(LidarScan const& scan);
+    void processOccupancyGrid(cv::Mat const& grid);
+
+private Q_SLOTS:
+    /// Publish stage
+    void publishSweep();
+    void publishSectors();
+    void publishOccupancyGrid();
+    void publishLines();
 
+    /// Writes the displayed sweep
+    void exportSnapshot();
+    /// Starts or stops writing every published sweep
+    void toggleContinuousExport();
 
 private:
+    class ConvertThread;
+
+    /// Blocks received since the previous chunk, all in the same revolution
+    struct StreamChunk
+    {
+        QSharedPointer<VelodynePolarData const> revolution;
+        int firstBlock;
+        int blockCount;
+        /// [ns, TraceRecorder::now()]
+        qint64 arrivalTime;
+    };
+
+    /// Convert stage, returns when the ingest queue is closed
+    void convertLoop();
+    /// Convert stage of the streaming path
+    void streamLoop();
+    void finishStreamedRevolution();
+    void queueSector(int sector, qint64 arrivalTime);
+    /// Drops the unconfirmed returns of the image, before its points are taken
+    void filterRanges(LidarSweep& sweep);
+    /// Sets the pose of the sweep, registering its image when enabled
+    void registerSweep(LidarSweep& sweep);
+    void computeBirdEye(LidarSweep& sweep);
+    void computeClusters(LidarSweep& sweep);
+    void detectChanges(LidarSweep& sweep);
+    /// Hands a converted sweep to the other components and processes
+    void shareSweep(LidarSweep const& sweep);
+    void queueForPublishing(LidarSweepPtr const& sweep);
+    void logQueueStatistics() const;
+    void logCropStatistics() const;
+    void logTemporalFilterStatistics() const;
+    void logExportStatistics() const;
+    void logMapStatistics() const;
+    void logOdometryStatistics();
+
     LidarViewer* mParent;
-    LidarView mView;
+    /// scene render path, null when the OpenGL window is used
+    boost::scoped_ptr<LidarView> mView;
+    double mTargetFrameTime;
+    /// OpenGL window render path, null when the view is used
+    boost::scoped_ptr<LidarGLView> mGLView;
 
 	//QSharedPointer<LidarScan> lidarScan;
 	LidarScan *lidarScan;
 
-	bool m_isRunning;
+    VelodyneConverter mConverter;
+    /// converter of the stream thread, the scratch buffers of a converter
+    /// are not shared between threads
+    VelodyneConverter mStreamConverter;
+    SweepPool mSweepPool;
+    BoundedQueue<QSharedPointer<VelodynePolarData const> > mIngestQueue;
+    BoundedQueue<LidarSweepPtr> mPublishQueue;
+    boost::scoped_ptr<ConvertThread> mConvertThread;
+
+    // streaming path
+    int mStreamSectorCount;
+    /// revolution being gathered, only used by the ingest stage
+    QSharedPointer<VelodynePolarData> mAssembly;
+    int mAssemblyAngle;
+    BoundedQueue<StreamChunk> mStreamQueue;
+    /// revolution being converted, only used by the stream thread
+    QSharedPointer<VelodynePolarData const> mStreamRevolution;
+    /// revolutions streamed since the start, numbers the sectors
+    unsigned int mStreamRevolutionCount;
+    QSharedPointer<LidarSweep> mStreamSweep;
+    BoundedQueue<LidarSectorPtr> mSectorQueue;
+    boost::scoped_ptr<ConvertThread> mStreamThread;
+
+    /// shared by the stages producing sweeps, one scan binned at a time
+    QMutex mBirdEyeMutex;
+    BirdEyeGrid mBirdEye;
+    bool mBirdEyeEnabled;
+    /// shared by the stages producing sweeps, one image clustered at a time
+    QMutex mClusterMutex;
+    SweepClusterer mClusterer;
+    bool mClustersEnabled;
+    /// shared by the stages producing sweeps, compares them in arrival order
+    QMutex mChangeMutex;
+    ChangeDetector mChangeDetector;
+    bool mChangeDetectionEnabled;
+    /// shared by the stages producing sweeps, filters them in arrival order
+    QMutex mTemporalFilterMutex;
+    TemporalRangeFilter mTemporalFilter;
+    bool mTemporalFilterEnabled;
+    struct TemporalFilterStatistics
+    {
+        unsigned long sweeps;
+        unsigned long long rejected;
+        qint64 totalTime;
+        qint64 maxTime;
+    } mTemporalFilterStatistics;
+    /// shared by the stages producing sweeps, registers them in arrival order
+    QMutex mOdometryMutex;
+    SweepRegistration mRegistration;
+    bool mOdometryEnabled;
+    qint64 mOdometryBudget;
+    /// since the last report
+    struct OdometryStatistics
+    {
+        int sweeps;
+        int iterations;
+        int converged;
+        int overBudget;
+        qint64 totalTime;
+        qint64 maxTime;
+    } mOdometryStatistics;
+    BoundedQueue<cv::Mat> mOccupancyQueue;
+    float mOccupancyCellSize;
+    BoundedQueue<LineCloud3D> mLinesQueue;
+
+    QString mShareKey;
+    int mShareSlotCount, mShareSlotCapacity;
+    /// written by both convert stages
+    QMutex mShareMutex;
+    SweepRingWriter mShareRing;
+
+    QString mMapPath;
+    float mMapTileSize;
+    qint64 mMapMemoryBudget;
+    TiledMap mMap;
+
+    PointCloudExporter mExporter;
+    /// last published sweep, for snapshots
+    LidarSweepPtr mLastSweep;
+    bool mContinuousExport;
+    unsigned long mPublishedCount;
 };
 
 } // namespace pacpus
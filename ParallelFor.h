@@ -0,0 +1,88 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Splits an index range over the threads of a pool.
+///
+/// The range is cut into one contiguous chunk per worker and the functor is
+/// called as functor(first, last, worker) for each chunk. The calling thread
+/// runs the last chunk itself and returns once all of them are done, so the
+/// functor may keep per-worker state indexed by `worker` without locking.
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+
+namespace pacpus
+{
+
+/// Number of workers worth using for `count` items of at least `grain` items each
+inline int parallelWorkerCount(int count, int grain)
+{
+    int const threads = std::max(1, QThread::idealThreadCount());
+    return std::max(1, std::min(threads, count / std::max(1, grain)));
+}
+
+template <typename Functor>
+class ParallelForTask
+    : public QRunnable
+{
+public:
+    ParallelForTask(Functor& functor, int first, int last, int worker, QSemaphore& done)
+        : mFunctor(functor)
+        , mFirst(first)
+        , mLast(last)
+        , mWorker(worker)
+        , mDone(done)
+    {
+    }
+
+    void run() /* override */
+    {
+        mFunctor(mFirst, mLast, mWorker);
+        mDone.release();
+    }
+
+private:
+    Functor& mFunctor;
+    int mFirst, mLast;
+    int mWorker;
+    QSemaphore& mDone;
+};
+
+/// Calls functor(first, last, worker) over [begin, end) split in workerCount chunks.
+/// @param pool must not be saturated by tasks waiting for this call
+template <typename Functor>
+void parallelFor(int begin, int end, int workerCount, Functor& functor,
+                 QThreadPool* pool = QThreadPool::globalInstance())
+{
+    int const count = end - begin;
+    if (count <= 0) {
+        return;
+    }
+    workerCount = std::max(1, std::min(workerCount, count));
+
+    QSemaphore done;
+    int const chunk = (count + workerCount - 1) / workerCount;
+    int started = 0;
+    int first = begin;
+    for (int worker = 0; worker + 1 < workerCount; ++worker) {
+        int const last = std::min(end, first + chunk);
+        pool->start(new ParallelForTask<Functor>(functor, first, last, worker, done));
+        ++started;
+        first = last;
+    }
+    functor(first, end, workerCount - 1);
+    done.acquire(started);
+}
+
+} // namespace pacpus
+
+#endif // PARALLELFOR_H
@@ -0,0 +1,235 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "PickingGrid.h"
+
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace pacpus;
+using namespace std;
+
+/// Upper bound on the number of cells, the cell size is doubled until it fits
+static const int kMaxCells = 1 << 20;
+
+static bool clipAxis(float origin, float direction, float lo, float hi, float& t0, float& t1)
+{
+    if (fabs(direction) < 1e-9f) {
+        return (lo <= origin) && (origin <= hi);
+    }
+    float ta = (lo - origin) / direction;
+    float tb = (hi - origin) / direction;
+    if (ta > tb) {
+        swap(ta, tb);
+    }
+    t0 = max(t0, ta);
+    t1 = min(t1, tb);
+    return t0 <= t1;
+}
+
+PickingGrid::PickingGrid()
+    : mCellSize(1)
+    , mMinX(0)
+    , mMinY(0)
+    , mMinZ(0)
+    , mMaxZ(0)
+    , mCols(0)
+    , mRows(0)
+{
+}
+
+void PickingGrid::build(LidarScan const& scan, float cellSize)
+{
+    size_t pointCount = 0;
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            minX = min(minX, point.x);
+            minY = min(minY, point.y);
+            minZ = min(minZ, point.z);
+            maxX = max(maxX, point.x);
+            maxY = max(maxY, point.y);
+            maxZ = max(maxZ, point.z);
+        }
+        pointCount += layer.points.size();
+    }
+
+    mCellStart.clear();
+    mX.resize(pointCount);
+    mY.resize(pointCount);
+    mZ.resize(pointCount);
+    mIntensity.resize(pointCount);
+    mLayer.resize(pointCount);
+    if (pointCount == 0) {
+        mCols = mRows = 0;
+        return;
+    }
+
+    mCellSize = cellSize;
+    for (;;) {
+        mCols = static_cast<int>((maxX - minX) / mCellSize) + 1;
+        mRows = static_cast<int>((maxY - minY) / mCellSize) + 1;
+        if (static_cast<double>(mCols) * mRows <= kMaxCells) {
+            break;
+        }
+        mCellSize *= 2;
+    }
+    mMinX = minX;
+    mMinY = minY;
+    mMinZ = minZ;
+    mMaxZ = maxZ;
+
+    // counting sort by cell
+    int const cellCount = mCols * mRows;
+    mCellStart.assign(cellCount + 1, 0);
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            int const col = static_cast<int>((point.x - mMinX) / mCellSize);
+            int const row = static_cast<int>((point.y - mMinY) / mCellSize);
+            ++mCellStart[row * mCols + col + 1];
+        }
+    }
+    for (int c = 0; c < cellCount; ++c) {
+        mCellStart[c + 1] += mCellStart[c];
+    }
+
+    vector<unsigned int> cursor(mCellStart.begin(), mCellStart.end() - 1);
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            int const col = static_cast<int>((point.x - mMinX) / mCellSize);
+            int const row = static_cast<int>((point.y - mMinY) / mCellSize);
+            unsigned int const index = cursor[row * mCols + col]++;
+            mX[index] = point.x;
+            mY[index] = point.y;
+            mZ[index] = point.z;
+            mIntensity[index] = point.intensity;
+            mLayer[index] = layer.id;
+        }
+    }
+}
+
+void PickingGrid::testCell(int col, int row, float const origin[3], float const direction[3],
+                           float tanTolerance, float minTolerance,
+                           float& bestScore, int& bestIndex) const
+{
+    if ((col < 0) || (col >= mCols) || (row < 0) || (row >= mRows)) {
+        return;
+    }
+
+    int const cell = row * mCols + col;
+    for (unsigned int i = mCellStart[cell]; i < mCellStart[cell + 1]; ++i) {
+        float const vx = mX[i] - origin[0];
+        float const vy = mY[i] - origin[1];
+        float const vz = mZ[i] - origin[2];
+        float const t = vx * direction[0] + vy * direction[1] + vz * direction[2];
+        if (t <= 0) {
+            continue;
+        }
+        float const perp2 = max(0.0f, vx * vx + vy * vy + vz * vz - t * t);
+        float const tolerance = max(minTolerance, t * tanTolerance);
+        if (perp2 >= tolerance * tolerance) {
+            continue;
+        }
+        float const score = sqrt(perp2) / tolerance;
+        if (score < bestScore) {
+            bestScore = score;
+            bestIndex = static_cast<int>(i);
+        }
+    }
+}
+
+bool PickingGrid::pick(float const origin[3], float const direction[3],
+                       float tanTolerance, float minTolerance, PickResult& result) const
+{
+    if (mX.empty()) {
+        return false;
+    }
+
+    // clip the ray to the grid extent, widened by one cell, then by the
+    // tolerance reached at the far end of the first clip
+    float margin = max(mCellSize, minTolerance);
+    float t0 = 0, t1 = FLT_MAX;
+    for (int pass = 0; pass < 2; ++pass) {
+        t0 = 0;
+        t1 = FLT_MAX;
+        if (!clipAxis(origin[0], direction[0], mMinX - margin, mMinX + mCols * mCellSize + margin, t0, t1)
+            || !clipAxis(origin[1], direction[1], mMinY - margin, mMinY + mRows * mCellSize + margin, t0, t1)
+            || !clipAxis(origin[2], direction[2], mMinZ - margin, mMaxZ + margin, t0, t1)) {
+            return false;
+        }
+        float const farTolerance = t1 * tanTolerance;
+        if (!(farTolerance > margin)) {
+            break;
+        }
+        margin = farTolerance;
+    }
+
+    // 2D DDA over the XY cells crossed by [t0, t1]
+    float const px = origin[0] + t0 * direction[0];
+    float const py = origin[1] + t0 * direction[1];
+    int col = static_cast<int>(floor((px - mMinX) / mCellSize));
+    int row = static_cast<int>(floor((py - mMinY) / mCellSize));
+    int const stepCol = (direction[0] > 0) ? 1 : -1;
+    int const stepRow = (direction[1] > 0) ? 1 : -1;
+
+    float tMaxCol = FLT_MAX, tDeltaCol = FLT_MAX;
+    if (fabs(direction[0]) > 1e-9f) {
+        float const boundary = mMinX + (col + (stepCol > 0 ? 1 : 0)) * mCellSize;
+        tMaxCol = t0 + (boundary - px) / direction[0];
+        tDeltaCol = mCellSize / fabs(direction[0]);
+    }
+    float tMaxRow = FLT_MAX, tDeltaRow = FLT_MAX;
+    if (fabs(direction[1]) > 1e-9f) {
+        float const boundary = mMinY + (row + (stepRow > 0 ? 1 : 0)) * mCellSize;
+        tMaxRow = t0 + (boundary - py) / direction[1];
+        tDeltaRow = mCellSize / fabs(direction[1]);
+    }
+
+    float bestScore = FLT_MAX;
+    int bestIndex = -1;
+    int const maxSteps = mCols + mRows + 4;
+    for (int step = 0; step < maxSteps; ++step) {
+        // the cone is widest where the ray leaves the cell, test every cell
+        // it may reach there
+        float const tExit = min(min(tMaxCol, tMaxRow), t1);
+        float const tolerance = max(minTolerance, tExit * tanTolerance);
+        int const radius = 1 + static_cast<int>(min(tolerance / mCellSize, static_cast<float>(mCols + mRows)));
+        int const rowBegin = max(row - radius, 0), rowEnd = min(row + radius, mRows - 1);
+        int const colBegin = max(col - radius, 0), colEnd = min(col + radius, mCols - 1);
+        for (int r = rowBegin; r <= rowEnd; ++r) {
+            for (int c = colBegin; c <= colEnd; ++c) {
+                testCell(c, r, origin, direction, tanTolerance, minTolerance, bestScore, bestIndex);
+            }
+        }
+
+        float t;
+        if (tMaxCol < tMaxRow) {
+            t = tMaxCol;
+            tMaxCol += tDeltaCol;
+            col += stepCol;
+        } else {
+            t = tMaxRow;
+            tMaxRow += tDeltaRow;
+            row += stepRow;
+        }
+        if (t > t1) {
+            break;
+        }
+    }
+
+    if (bestIndex < 0) {
+        return false;
+    }
+    result.x = mX[bestIndex];
+    result.y = mY[bestIndex];
+    result.z = mZ[bestIndex];
+    result.range = sqrt(result.x * result.x + result.y * result.y + result.z * result.z);
+    result.intensity = mIntensity[bestIndex];
+    result.layer = mLayer[bestIndex];
+    return true;
+}
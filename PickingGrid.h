@@ -0,0 +1,76 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Uniform XY grid over a scan used for ray picking.
+///
+/// Points are bucketed by XY cell with a counting sort, so the grid is one
+/// flat array of points plus one offset per cell. A pick walks the cells
+/// crossed by the ray (2D DDA, clipped to the Z extent of the scan) and tests
+/// the points of the neighbouring cells only.
+
+#ifndef PICKINGGRID_H
+#define PICKINGGRID_H
+
+#include <structure/GenericLidar.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace pacpus
+{
+
+struct PickResult
+{
+    float x, y, z;
+    float range;
+    float intensity;
+    int layer;
+};
+
+class PickingGrid
+{
+public:
+    PickingGrid();
+
+    /// Buckets all points of the scan.
+    /// @param cellSize requested cell size [m], enlarged for very large scans
+    void build(LidarScan const& scan, float cellSize);
+
+    /// Finds the point closest to the ray origin + t * direction.
+    ///
+    /// A point is a candidate when its distance to the ray is below
+    /// max(minTolerance, t * tanTolerance), i.e. a cone around the ray.
+    /// The candidate with the smallest angular distance wins.
+    ///
+    /// @param direction must be normalized
+    bool pick(float const origin[3], float const direction[3],
+              float tanTolerance, float minTolerance, PickResult& result) const;
+
+    std::size_t size() const
+    {
+        return mX.size();
+    }
+
+private:
+    void testCell(int col, int row, float const origin[3], float const direction[3],
+                  float tanTolerance, float minTolerance,
+                  float& bestScore, int& bestIndex) const;
+
+    float mCellSize;
+    float mMinX, mMinY;
+    float mMinZ, mMaxZ;
+    int mCols, mRows;
+
+    /// start of each cell in the point arrays, mCols * mRows + 1 entries
+    std::vector<unsigned int> mCellStart;
+    /// points sorted by cell
+    std::vector<float> mX, mY, mZ;
+    std::vector<float> mIntensity;
+    std::vector<int> mLayer;
+};
+
+} // namespace pacpus
+
+#endif // PICKINGGRID_H
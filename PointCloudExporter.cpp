@@ -0,0 +1,371 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "PointCloudExporter.h"
+#include "LidarTrace.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <boost/foreach.hpp>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+using namespace pacpus;
+using namespace std;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.PointCloudExporter");
+
+/// LAS coordinates are stored as integers of this resolution [m]
+static const double kLasScale = 0.001;
+static const unsigned short kLasHeaderSize = 227;
+static const unsigned short kLasPointRecordLength = 20;
+
+static char const* const kFilePrefix = "lidar-";
+
+/// Appends the raw little-endian bytes of a value
+template <typename T>
+static void append(vector<char>& buffer, T const& value)
+{
+    char const* bytes = reinterpret_cast<char const*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+static void appendString(vector<char>& buffer, string const& text)
+{
+    buffer.insert(buffer.end(), text.begin(), text.end());
+}
+
+/// Appends a fixed-size, zero-padded character field
+static void appendField(vector<char>& buffer, char const* text, size_t size)
+{
+    size_t const length = min(strlen(text), size);
+    buffer.insert(buffer.end(), text, text + length);
+    buffer.insert(buffer.end(), size - length, '\0');
+}
+
+static size_t pointCount(LidarScan const& scan)
+{
+    size_t count = 0;
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        count += layer.points.size();
+    }
+    return count;
+}
+
+/// x, y, z, intensity as float, layer as unsigned char
+static void appendPackedPoints(vector<char>& buffer, LidarScan const& scan)
+{
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        unsigned char const layerId = static_cast<unsigned char>(layer.id);
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            append(buffer, static_cast<float>(point.x));
+            append(buffer, static_cast<float>(point.y));
+            append(buffer, static_cast<float>(point.z));
+            append(buffer, static_cast<float>(point.intensity));
+            append(buffer, layerId);
+        }
+    }
+}
+
+static void serializePly(LidarScan const& scan, vector<char>& buffer)
+{
+    ostringstream header;
+    header << "ply\n"
+           << "format binary_little_endian 1.0\n"
+           << "comment LidarViewer export\n"
+           << "element vertex " << pointCount(scan) << "\n"
+           << "property float x\n"
+           << "property float y\n"
+           << "property float z\n"
+           << "property float intensity\n"
+           << "property uchar layer\n"
+           << "end_header\n";
+    appendString(buffer, header.str());
+    appendPackedPoints(buffer, scan);
+}
+
+static void serializePcd(LidarScan const& scan, vector<char>& buffer)
+{
+    size_t const count = pointCount(scan);
+    ostringstream header;
+    header << "# .PCD v0.7 - Point Cloud Data file format\n"
+           << "VERSION 0.7\n"
+           << "FIELDS x y z intensity layer\n"
+           << "SIZE 4 4 4 4 1\n"
+           << "TYPE F F F F U\n"
+           << "COUNT 1 1 1 1 1\n"
+           << "WIDTH " << count << "\n"
+           << "HEIGHT 1\n"
+           << "VIEWPOINT 0 0 0 1 0 0 0\n"
+           << "POINTS " << count << "\n"
+           << "DATA binary\n";
+    appendString(buffer, header.str());
+    appendPackedPoints(buffer, scan);
+}
+
+/// LAS 1.2, point data format 0, the layer goes to the user data byte
+static void serializeLas(LidarScan const& scan, vector<char>& buffer)
+{
+    size_t const count = pointCount(scan);
+    double minX = DBL_MAX, minY = DBL_MAX, minZ = DBL_MAX;
+    double maxX = -DBL_MAX, maxY = -DBL_MAX, maxZ = -DBL_MAX;
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            minX = min(minX, static_cast<double>(point.x));
+            minY = min(minY, static_cast<double>(point.y));
+            minZ = min(minZ, static_cast<double>(point.z));
+            maxX = max(maxX, static_cast<double>(point.x));
+            maxY = max(maxY, static_cast<double>(point.y));
+            maxZ = max(maxZ, static_cast<double>(point.z));
+        }
+    }
+    if (count == 0) {
+        minX = minY = minZ = maxX = maxY = maxZ = 0;
+    }
+
+    // public header block
+    appendString(buffer, "LASF");
+    append(buffer, static_cast<unsigned short>(0));     // file source ID
+    append(buffer, static_cast<unsigned short>(0));     // global encoding
+    buffer.insert(buffer.end(), 16, '\0');              // project GUID
+    append(buffer, static_cast<unsigned char>(1));      // version major
+    append(buffer, static_cast<unsigned char>(2));      // version minor
+    appendField(buffer, "PACPUS", 32);                  // system identifier
+    appendField(buffer, "LidarViewer", 32);             // generating software
+    append(buffer, static_cast<unsigned short>(0));     // creation day of year
+    append(buffer, static_cast<unsigned short>(0));     // creation year
+    append(buffer, kLasHeaderSize);
+    append(buffer, static_cast<unsigned int>(kLasHeaderSize)); // offset to point data
+    append(buffer, static_cast<unsigned int>(0));       // number of variable length records
+    append(buffer, static_cast<unsigned char>(0));      // point data format
+    append(buffer, kLasPointRecordLength);
+    append(buffer, static_cast<unsigned int>(count));
+    append(buffer, static_cast<unsigned int>(count));   // points by return: all first returns
+    for (int i = 1; i < 5; ++i) {
+        append(buffer, static_cast<unsigned int>(0));
+    }
+    append(buffer, kLasScale);
+    append(buffer, kLasScale);
+    append(buffer, kLasScale);
+    append(buffer, 0.0);                                // offsets
+    append(buffer, 0.0);
+    append(buffer, 0.0);
+    append(buffer, maxX);
+    append(buffer, minX);
+    append(buffer, maxY);
+    append(buffer, minY);
+    append(buffer, maxZ);
+    append(buffer, minZ);
+
+    // point records
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        unsigned char const layerId = static_cast<unsigned char>(layer.id);
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            append(buffer, static_cast<int>(floor(point.x / kLasScale + 0.5)));
+            append(buffer, static_cast<int>(floor(point.y / kLasScale + 0.5)));
+            append(buffer, static_cast<int>(floor(point.z / kLasScale + 0.5)));
+            append(buffer, static_cast<unsigned short>(point.intensity));
+            append(buffer, static_cast<unsigned char>(0x09));  // return 1 of 1
+            append(buffer, static_cast<unsigned char>(0));     // classification
+            append(buffer, static_cast<signed char>(0));       // scan angle rank
+            append(buffer, layerId);                           // user data
+            append(buffer, static_cast<unsigned short>(0));    // point source ID
+        }
+    }
+}
+
+static char const* extension(ExportFormat format)
+{
+    switch (format) {
+    case EF_Pcd:
+        return "pcd";
+    case EF_Las:
+        return "las";
+    case EF_Ply:
+    default:
+        return "ply";
+    }
+}
+
+bool pacpus::parseExportFormat(string const& name, ExportFormat& format)
+{
+    if (name == "ply") {
+        format = EF_Ply;
+    } else if (name == "pcd") {
+        format = EF_Pcd;
+    } else if (name == "las") {
+        format = EF_Las;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+class PointCloudExporter::WriterThread
+    : public QThread
+{
+public:
+    WriterThread(PointCloudExporter* exporter)
+        : mExporter(exporter)
+    {
+        setObjectName("LidarViewer export");
+    }
+
+protected:
+    void run() /* override */
+    {
+        mExporter->writeLoop();
+    }
+
+private:
+    PointCloudExporter* mExporter;
+};
+
+//////////////////////////////////////////////////////////////////////////
+PointCloudExporter::PointCloudExporter()
+    : mDirectory(".")
+    , mFormat(EF_Ply)
+    , mQueue(4, QOP_DropNewest)
+    , mFileIndex(0)
+    , mWritten(0)
+    , mBytes(0)
+{
+    mThread.reset(new WriterThread(this));
+}
+
+PointCloudExporter::~PointCloudExporter()
+{
+    stop();
+}
+
+void PointCloudExporter::configure(QString const& directory, ExportFormat format, std::size_t queueCapacity)
+{
+    mDirectory = directory;
+    mFormat = format;
+    mQueue.configure(queueCapacity, QOP_DropNewest);
+}
+
+void PointCloudExporter::start()
+{
+    if (!QDir().mkpath(mDirectory)) {
+        LOG_WARN("cannot create export directory '" << mDirectory << "'");
+    }
+    // continue the numbering of the previous runs
+    mFileIndex = 0;
+    QStringList const previous = QDir(mDirectory).entryList(QStringList(QString(kFilePrefix) + "*"), QDir::Files);
+    BOOST_FOREACH(QString const& name, previous) {
+        QString const number = name.mid(static_cast<int>(strlen(kFilePrefix))).section('.', 0, 0);
+        bool ok = false;
+        unsigned long const index = number.toULong(&ok);
+        if (ok && (index >= mFileIndex)) {
+            mFileIndex = index + 1;
+        }
+    }
+    {
+        QMutexLocker lock(&mStatisticsMutex);
+        mTimer.start();
+    }
+    mQueue.reopen();
+    mThread->start();
+}
+
+void PointCloudExporter::stop()
+{
+    mQueue.close();
+    mThread->wait();
+}
+
+bool PointCloudExporter::enqueue(LidarSweepPtr const& sweep)
+{
+    return mQueue.push(sweep);
+}
+
+void PointCloudExporter::writeLoop()
+{
+    LidarSweepPtr sweep;
+    while (mQueue.pop(sweep)) {
+        LIDAR_TRACE_SCOPE("PointCloudExporter::write");
+        mBuffer.clear();
+        serialize(sweep->scan, mFormat, mBuffer);
+        // retire the sweep before the slow part
+        sweep.clear();
+
+        QString const path = nextPath();
+        if (!writeFile(path)) {
+            continue;
+        }
+
+        QMutexLocker lock(&mStatisticsMutex);
+        ++mWritten;
+        mBytes += static_cast<qint64>(mBuffer.size());
+    }
+}
+
+QString PointCloudExporter::nextPath()
+{
+    QDir const directory(mDirectory);
+    QString path;
+    do {
+        QString const name = QString(kFilePrefix) + QString("%1.%2").arg(mFileIndex++, 6, 10, QChar('0'))
+                                                       .arg(extension(mFormat));
+        path = directory.filePath(name);
+    } while (QFile::exists(path));
+    return path;
+}
+
+bool PointCloudExporter::writeFile(QString const& path)
+{
+    QFile file(path);
+    // nextPath() made sure that nothing is overwritten
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_ERROR("cannot open export file '" << path << "'");
+        return false;
+    }
+    qint64 const size = static_cast<qint64>(mBuffer.size());
+    if (file.write(mBuffer.empty() ? NULL : &mBuffer[0], size) != size) {
+        LOG_ERROR("cannot write export file '" << path << "'");
+        return false;
+    }
+    return true;
+}
+
+void PointCloudExporter::serialize(LidarScan const& scan, ExportFormat format, vector<char>& buffer)
+{
+    switch (format) {
+    case EF_Pcd:
+        serializePcd(scan, buffer);
+        break;
+    case EF_Las:
+        serializeLas(scan, buffer);
+        break;
+    case EF_Ply:
+    default:
+        serializePly(scan, buffer);
+        break;
+    }
+}
+
+PointCloudExporter::Statistics PointCloudExporter::statistics() const
+{
+    Statistics statistics;
+    statistics.dropped = mQueue.dropCount();
+
+    QMutexLocker lock(&mStatisticsMutex);
+    statistics.written = mWritten;
+    statistics.bytes = mBytes;
+    qint64 const elapsed = mTimer.isValid() ? mTimer.elapsed() : 0;
+    statistics.bytesPerSecond = (elapsed > 0) ? mBytes * 1000.0 / elapsed : 0.0;
+    return statistics;
+}
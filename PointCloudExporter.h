@@ -0,0 +1,99 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Writes displayed sweeps to binary PLY, PCD or LAS files.
+///
+/// Sweeps are queued without copy and written by a background thread, one
+/// file per sweep. Each file is serialized into a reused staging buffer and
+/// written with a single large sequential write. The queue drops the newest
+/// sweep when the disk does not keep up, so producers never wait.
+///
+/// Files are numbered lidar-NNNNNN, continuing after the highest number
+/// already in the directory, whatever its format. An existing file is
+/// never overwritten: its number is skipped.
+
+#ifndef POINTCLOUDEXPORTER_H
+#define POINTCLOUDEXPORTER_H
+
+#include "BoundedQueue.h"
+#include "LidarSweep.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+
+#include <boost/scoped_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace pacpus
+{
+
+enum ExportFormat {
+    EF_Ply,
+    EF_Pcd,
+    EF_Las
+};
+
+/// Parses "ply", "pcd" or "las".
+bool parseExportFormat(std::string const& name, ExportFormat& format);
+
+class PointCloudExporter
+{
+public:
+    PointCloudExporter();
+    ~PointCloudExporter();
+
+    void configure(QString const& directory, ExportFormat format, std::size_t queueCapacity);
+
+    void start();
+    /// Writes the queued sweeps and stops the writer thread.
+    void stop();
+
+    /// Queues a sweep for writing, never blocks.
+    /// @returns false if the sweep was dropped
+    bool enqueue(LidarSweepPtr const& sweep);
+
+    struct Statistics
+    {
+        unsigned long written;
+        unsigned long dropped;
+        qint64 bytes;
+        /// mean throughput since start [B/s]
+        double bytesPerSecond;
+    };
+    Statistics statistics() const;
+
+    /// Serializes a scan in the given format.
+    static void serialize(LidarScan const& scan, ExportFormat format, std::vector<char>& buffer);
+
+private:
+    class WriterThread;
+
+    void writeLoop();
+    /// @returns the path of the next file, not existing yet
+    QString nextPath();
+    bool writeFile(QString const& path);
+
+    QString mDirectory;
+    ExportFormat mFormat;
+    BoundedQueue<LidarSweepPtr> mQueue;
+    boost::scoped_ptr<WriterThread> mThread;
+
+    /// staging buffer, only used by the writer thread
+    std::vector<char> mBuffer;
+    /// number of the next file, set by start() and then only used by the
+    /// writer thread
+    unsigned long mFileIndex;
+
+    mutable QMutex mStatisticsMutex;
+    unsigned long mWritten;
+    qint64 mBytes;
+    QElapsedTimer mTimer;
+};
+
+} // namespace pacpus
+
+#endif // POINTCLOUDEXPORTER_H
@@ -0,0 +1,110 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "PointPicker.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QRunnable>
+
+using namespace pacpus;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.PointPicker");
+
+/// Grid cell size [m]
+static const float kCellSize = 0.5f;
+/// Smallest picking radius [m], for points very close to the camera
+static const float kMinTolerance = 0.05f;
+
+class PointPicker::BuildTask
+    : public QRunnable
+{
+public:
+    BuildTask(PointPicker* picker)
+        : mPicker(picker)
+    {
+    }
+
+    void run() /* override */
+    {
+        mPicker->rebuild();
+    }
+
+private:
+    PointPicker* mPicker;
+};
+
+PointPicker::PointPicker()
+    : mBuilding(false)
+{
+    mPool.setMaxThreadCount(1);
+}
+
+PointPicker::~PointPicker()
+{
+    {
+        QMutexLocker lock(&mMutex);
+        mPendingSweep.clear();
+    }
+    mPool.waitForDone();
+}
+
+void PointPicker::setSweep(LidarSweepPtr const& sweep)
+{
+    QMutexLocker lock(&mMutex);
+    mPendingSweep = sweep;
+    if (!mBuilding) {
+        mBuilding = true;
+        mPool.start(new BuildTask(this));
+    }
+}
+
+void PointPicker::rebuild()
+{
+    for (;;) {
+        LidarSweepPtr sweep;
+        {
+            QMutexLocker lock(&mMutex);
+            sweep.swap(mPendingSweep);
+            if (!sweep) {
+                mBuilding = false;
+                return;
+            }
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QSharedPointer<PickingGrid> grid(new PickingGrid);
+        grid->build(sweep->scan, kCellSize);
+        LOG_DEBUG("picking grid built: " << grid->size() << " points in " << timer.elapsed() << " ms");
+
+        QMutexLocker lock(&mMutex);
+        mGrid = grid;
+    }
+}
+
+bool PointPicker::pick(QVector3D const& origin, QVector3D const& direction, float tanTolerance, PickResult& result) const
+{
+    QSharedPointer<PickingGrid const> grid;
+    {
+        QMutexLocker lock(&mMutex);
+        grid = mGrid;
+    }
+    if (!grid) {
+        return false;
+    }
+
+    QVector3D const unitDirection = direction.normalized();
+    float const o[3] = { static_cast<float>(origin.x()), static_cast<float>(origin.y()), static_cast<float>(origin.z()) };
+    float const d[3] = { static_cast<float>(unitDirection.x()), static_cast<float>(unitDirection.y()), static_cast<float>(unitDirection.z()) };
+
+    QElapsedTimer timer;
+    timer.start();
+    bool const found = grid->pick(o, d, tanTolerance, kMinTolerance, result);
+    LOG_DEBUG("pick in " << timer.nsecsElapsed() / 1000 << " us over " << grid->size() << " points");
+    return found;
+}
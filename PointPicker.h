@@ -0,0 +1,58 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Picks scan points under the cursor.
+///
+/// The picking grid is rebuilt on a background thread whenever a new scan
+/// is set. Until the new grid is ready, picks are answered from the previous
+/// one, so the render thread never waits for a rebuild. Scans arriving while
+/// a rebuild is running are coalesced, only the latest one is indexed.
+
+#ifndef POINTPICKER_H
+#define POINTPICKER_H
+
+#include "PickingGrid.h"
+
+#include "LidarSweep.h"
+
+#include <QMutex>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector3D>
+
+namespace pacpus
+{
+
+class PointPicker
+{
+public:
+    PointPicker();
+    ~PointPicker();
+
+    /// Schedules a rebuild of the index, returns immediately.
+    /// The sweep is shared, not copied.
+    void setSweep(LidarSweepPtr const& sweep);
+
+    /// Picks the point closest to the ray.
+    /// @param tanTolerance tangent of the picking cone half-angle
+    bool pick(QVector3D const& origin, QVector3D const& direction, float tanTolerance, PickResult& result) const;
+
+private:
+    class BuildTask;
+    friend class BuildTask;
+
+    void rebuild();
+
+    QThreadPool mPool;
+
+    mutable QMutex mMutex;
+    QSharedPointer<PickingGrid const> mGrid;
+    LidarSweepPtr mPendingSweep;
+    bool mBuilding;
+};
+
+} // namespace pacpus
+
+#endif // POINTPICKER_H
@@ -0,0 +1,224 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "SweepClusterer.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+
+using namespace pacpus;
+using namespace std;
+
+static const float kDefaultTolerance = 0.5f;
+static const float kDefaultMinZ = -1.5f;
+static const int kDefaultMinPoints = 10;
+/// Thinner strips leave too many borders to join
+static const int kMinRowsPerWorker = 4;
+
+namespace
+{
+
+/// Orders the image rows by elevation
+class RowAngleLess
+{
+public:
+    explicit RowAngleLess(VelodyneRangeImage const& image)
+        : mImage(image)
+    {
+    }
+
+    bool operator()(int rowA, int rowB) const
+    {
+        return mImage.rowAngle(rowA) < mImage.rowAngle(rowB);
+    }
+
+private:
+    VelodyneRangeImage const& mImage;
+};
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+/// Labels the rows [first, last) of mRowOrder, the trees stay within them
+class SweepClusterer::StripTask
+{
+public:
+    StripTask(SweepClusterer& clusterer, VelodyneRangeImage const& image)
+        : mClusterer(clusterer)
+        , mImage(image)
+    {
+    }
+
+    void operator()(int first, int last, int /*worker*/)
+    {
+        vector<int>& parent = mClusterer.mParent;
+        float const minZ = mClusterer.mMinZ;
+        for (int i = first; i < last; ++i) {
+            int const row = mClusterer.mRowOrder[i];
+            int const start = mImage.index(row, 0);
+            unsigned char const* valid = mImage.validRow(row);
+            float const* z = mImage.zRow(row);
+            for (int col = 0; col < mImage.cols(); ++col) {
+                parent[start + col] = (valid[col] && (z[col] >= minZ)) ? start + col : -1;
+            }
+        }
+        for (int i = first; i < last; ++i) {
+            mClusterer.linkRow(mImage, mClusterer.mRowOrder[i]);
+            if (i + 1 < last) {
+                mClusterer.linkRows(mImage, mClusterer.mRowOrder[i], mClusterer.mRowOrder[i + 1]);
+            }
+        }
+    }
+
+private:
+    SweepClusterer& mClusterer;
+    VelodyneRangeImage const& mImage;
+};
+
+//////////////////////////////////////////////////////////////////////////
+SweepClusterer::SweepClusterer()
+    : mSquaredTolerance(kDefaultTolerance * kDefaultTolerance)
+    , mMinZ(kDefaultMinZ)
+    , mMinPoints(kDefaultMinPoints)
+{
+}
+
+void SweepClusterer::configure(float tolerance, float minZ, int minPoints)
+{
+    mSquaredTolerance = tolerance * tolerance;
+    mMinZ = minZ;
+    mMinPoints = minPoints;
+}
+
+void SweepClusterer::cluster(VelodyneRangeImage const& image, std::vector<ClusterBox>& boxes)
+{
+    boxes.clear();
+    int const rows = image.rows();
+    if ((rows == 0) || (image.cols() == 0)) {
+        return;
+    }
+
+    mRowOrder.resize(rows);
+    for (int row = 0; row < rows; ++row) {
+        mRowOrder[row] = row;
+    }
+    sort(mRowOrder.begin(), mRowOrder.end(), RowAngleLess(image));
+    mParent.resize(image.size());
+
+    // strips are labeled separately, then joined along their borders
+    int const workerCount = parallelWorkerCount(rows, kMinRowsPerWorker);
+    StripTask strips(*this, image);
+    parallelFor(0, rows, workerCount, strips);
+    // same chunks as parallelFor
+    int const chunk = (rows + workerCount - 1) / workerCount;
+    for (int border = chunk; border < rows; border += chunk) {
+        linkRows(image, mRowOrder[border - 1], mRowOrder[border]);
+    }
+
+    mBoxOf.assign(image.size(), -1);
+    for (int row = 0; row < rows; ++row) {
+        float const* x = image.xRow(row);
+        float const* y = image.yRow(row);
+        float const* z = image.zRow(row);
+        int const start = image.index(row, 0);
+        for (int col = 0; col < image.cols(); ++col) {
+            if (mParent[start + col] < 0) {
+                continue;
+            }
+            int const root = find(start + col);
+            if (mBoxOf[root] < 0) {
+                mBoxOf[root] = static_cast<int>(boxes.size());
+                ClusterBox const box = { x[col], y[col], z[col], x[col], y[col], z[col], 0 };
+                boxes.push_back(box);
+            }
+            ClusterBox& box = boxes[mBoxOf[root]];
+            box.minX = min(box.minX, x[col]);
+            box.minY = min(box.minY, y[col]);
+            box.minZ = min(box.minZ, z[col]);
+            box.maxX = max(box.maxX, x[col]);
+            box.maxY = max(box.maxY, y[col]);
+            box.maxZ = max(box.maxZ, z[col]);
+            ++box.pointCount;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (boxes[i].pointCount >= mMinPoints) {
+            boxes[kept++] = boxes[i];
+        }
+    }
+    boxes.resize(kept);
+}
+
+void SweepClusterer::linkRow(VelodyneRangeImage const& image, int row)
+{
+    int const start = image.index(row, 0);
+    for (int col = 0; col < image.cols(); ++col) {
+        if (mParent[start + col] < 0) {
+            continue;
+        }
+        // the second column bridges a single missing return
+        int const next = image.nextColumn(col);
+        int const afterNext = image.nextColumn(next);
+        if (close(image, start + col, start + next)) {
+            unite(start + col, start + next);
+        }
+        if (close(image, start + col, start + afterNext)) {
+            unite(start + col, start + afterNext);
+        }
+    }
+}
+
+void SweepClusterer::linkRows(VelodyneRangeImage const& image, int lower, int upper)
+{
+    int const lowerStart = image.index(lower, 0);
+    int const upperStart = image.index(upper, 0);
+    for (int col = 0; col < image.cols(); ++col) {
+        if (mParent[lowerStart + col] < 0) {
+            continue;
+        }
+        // the lasers of a block do not share the exact same azimuth
+        int const neighbours[] = { image.previousColumn(col), col, image.nextColumn(col) };
+        for (int i = 0; i < 3; ++i) {
+            if (close(image, lowerStart + col, upperStart + neighbours[i])) {
+                unite(lowerStart + col, upperStart + neighbours[i]);
+            }
+        }
+    }
+}
+
+bool SweepClusterer::close(VelodyneRangeImage const& image, int cellA, int cellB) const
+{
+    if (mParent[cellB] < 0) {
+        return false;
+    }
+    float const dx = image.x()[cellA] - image.x()[cellB];
+    float const dy = image.y()[cellA] - image.y()[cellB];
+    float const dz = image.z()[cellA] - image.z()[cellB];
+    return dx * dx + dy * dy + dz * dz <= mSquaredTolerance;
+}
+
+int SweepClusterer::find(int cell)
+{
+    // path halving
+    while (mParent[cell] != cell) {
+        mParent[cell] = mParent[mParent[cell]];
+        cell = mParent[cell];
+    }
+    return cell;
+}
+
+void SweepClusterer::unite(int cellA, int cellB)
+{
+    int const rootA = find(cellA);
+    int const rootB = find(cellB);
+    // the smallest index is the root, whichever order the cells come in
+    if (rootA < rootB) {
+        mParent[rootB] = rootA;
+    } else if (rootB < rootA) {
+        mParent[rootA] = rootB;
+    }
+}
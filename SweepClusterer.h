@@ -0,0 +1,68 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Euclidean clustering of a range image into obstacle boxes.
+///
+/// Neighbours are looked up in the image instead of in space: a return is
+/// connected to the next two columns of its laser and to the three closest
+/// columns of the laser just above, when closer than the tolerance. Lasers
+/// are taken by elevation, not in their firing order. Returns below the
+/// ground height are left out, so that the ground does not join every
+/// obstacle.
+///
+/// The lasers are cut into strips of consecutive elevations, each labeled
+/// by its own worker with a union-find confined to the strip. The strips
+/// are then joined along their borders and the boxes gathered in one pass.
+
+#ifndef SWEEPCLUSTERER_H
+#define SWEEPCLUSTERER_H
+
+#include "LidarSweep.h"
+#include "VelodyneRangeImage.h"
+
+#include <vector>
+
+namespace pacpus
+{
+
+class SweepClusterer
+{
+public:
+    SweepClusterer();
+
+    /// @param tolerance largest distance between two neighbours of a cluster [m]
+    /// @param minZ returns below this height are ground [m]
+    /// @param minPoints smaller clusters are dropped
+    void configure(float tolerance, float minZ, int minPoints);
+
+    /// @param boxes cleared, then receives one box per cluster
+    void cluster(VelodyneRangeImage const& image, std::vector<ClusterBox>& boxes);
+
+private:
+    class StripTask;
+    friend class StripTask;
+
+    /// Connects the cells of two rows, given in elevation order
+    void linkRows(VelodyneRangeImage const& image, int lower, int upper);
+    void linkRow(VelodyneRangeImage const& image, int row);
+    bool close(VelodyneRangeImage const& image, int cellA, int cellB) const;
+    int find(int cell);
+    void unite(int cellA, int cellB);
+
+    float mSquaredTolerance;
+    float mMinZ;
+    int mMinPoints;
+
+    /// image rows by increasing elevation
+    std::vector<int> mRowOrder;
+    /// union-find forest over the image cells, -1 outside of any cluster
+    std::vector<int> mParent;
+    /// box of each root, -1 until its first point
+    std::vector<int> mBoxOf;
+};
+
+} // namespace pacpus
+
+#endif // SWEEPCLUSTERER_H
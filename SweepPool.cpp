@@ -0,0 +1,115 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "SweepPool.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <vector>
+
+using namespace pacpus;
+
+class SweepPool::State
+{
+public:
+    State(int maxFree)
+        : maxFree(maxFree)
+    {
+        statistics.acquired = 0;
+        statistics.allocated = 0;
+        statistics.layerReallocations = 0;
+        statistics.acquireTime = 0;
+    }
+
+    ~State()
+    {
+        for (size_t i = 0; i < free.size(); ++i) {
+            delete free[i];
+        }
+    }
+
+    void release(LidarSweep* sweep)
+    {
+        {
+            QMutexLocker lock(&mutex);
+            if (static_cast<int>(free.size()) < maxFree) {
+                free.push_back(sweep);
+                return;
+            }
+        }
+        delete sweep;
+    }
+
+    QMutex mutex;
+    int maxFree;
+    std::vector<LidarSweep*> free;
+    Statistics statistics;
+};
+
+/// Deleter of the pooled sweeps, keeps the pool state alive
+struct SweepPool::Recycler
+{
+    QSharedPointer<SweepPool::State> state;
+
+    void operator()(LidarSweep* sweep) const
+    {
+        state->release(sweep);
+    }
+};
+
+SweepPool::SweepPool(int maxFree)
+    : mState(new State(maxFree))
+{
+}
+
+SweepPool::~SweepPool()
+{
+}
+
+QSharedPointer<LidarSweep> SweepPool::acquire()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    LidarSweep* sweep = NULL;
+    bool allocated = false;
+    {
+        QMutexLocker lock(&mState->mutex);
+        if (!mState->free.empty()) {
+            sweep = mState->free.back();
+            mState->free.pop_back();
+        }
+    }
+    if (!sweep) {
+        sweep = new LidarSweep;
+        allocated = true;
+    }
+
+    Recycler recycler;
+    recycler.state = mState;
+    QSharedPointer<LidarSweep> pooled(sweep, recycler);
+
+    QMutexLocker lock(&mState->mutex);
+    ++mState->statistics.acquired;
+    if (allocated) {
+        ++mState->statistics.allocated;
+    }
+    mState->statistics.acquireTime += timer.nsecsElapsed();
+    return pooled;
+}
+
+void SweepPool::addLayerReallocations(int count)
+{
+    QMutexLocker lock(&mState->mutex);
+    mState->statistics.layerReallocations += count;
+}
+
+SweepPool::Statistics SweepPool::statistics() const
+{
+    QMutexLocker lock(&mState->mutex);
+    return mState->statistics;
+}
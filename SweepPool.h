@@ -0,0 +1,60 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Recycles whole sweeps instead of reallocating their storage.
+///
+/// LidarLayer::points is a plain std::vector, so layers cannot draw from a
+/// custom arena. Instead, a sweep is recycled as a whole: when the last
+/// reference to a sweep is dropped, i.e. when every stage has retired it,
+/// it goes back to the pool with its range image planes and layer vectors
+/// still allocated. Filling it again only clears them, so in steady state a
+/// sweep costs no heap allocation.
+
+#ifndef SWEEPPOOL_H
+#define SWEEPPOOL_H
+
+#include "LidarSweep.h"
+
+#include <QSharedPointer>
+
+namespace pacpus
+{
+
+class SweepPool
+{
+public:
+    /// @param maxFree number of retired sweeps kept for reuse
+    explicit SweepPool(int maxFree = 8);
+    ~SweepPool();
+
+    /// Returns a retired sweep, or a new one if none is free.
+    /// The content of a recycled sweep is stale and must be overwritten.
+    QSharedPointer<LidarSweep> acquire();
+
+    /// Records the layer reallocations that happened while filling a sweep.
+    void addLayerReallocations(int count);
+
+    struct Statistics
+    {
+        unsigned long acquired;
+        /// sweeps allocated on the heap, the rest were recycled
+        unsigned long allocated;
+        /// layer vectors that had to grow while filling a sweep
+        unsigned long layerReallocations;
+        /// total time spent in acquire() [ns]
+        qint64 acquireTime;
+    };
+    Statistics statistics() const;
+
+private:
+    class State;
+    struct Recycler;
+
+    QSharedPointer<State> mState;
+};
+
+} // namespace pacpus
+
+#endif // SWEEPPOOL_H
@@ -0,0 +1,473 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "SweepRegistration.h"
+#include "LidarTrace.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QElapsedTimer>
+
+using namespace pacpus;
+using namespace std;
+
+static const double kTwoPi = 6.28318530717958647692;
+
+static const int kDefaultColumnStep = 4;
+static const float kDefaultMaxDistance = 1.0f;
+static const int kDefaultMaxIterations = 20;
+/// under a third of a revolution at 10 Hz
+static const qint64 kDefaultBudget = 30 * 1000 * 1000;
+
+/// Neighbours further apart than this fraction of the range are not on the
+/// same surface, no normal is estimated across them
+static const float kMaxNormalSpan = 0.15f;
+/// cells searched on each side of the projected one
+static const int kSearchColumns = 2;
+static const int kSearchRows = 1;
+/// fewer correspondences do not constrain the six degrees of freedom
+static const int kMinCorrespondences = 100;
+/// updates below these are converged [rad, m]
+static const double kMinRotationUpdate = 1e-4;
+static const double kMinTranslationUpdate = 1e-3;
+
+static const int kMinPointsPerWorker = 2048;
+static const int kMinRowsPerWorker = 4;
+
+/// Solves a x = b for a symmetric positive definite 6x6 matrix, in place.
+/// @returns false when the matrix is not positive definite
+static bool solveCholesky(double a[36], double b[6])
+{
+    // a = L L^T, L in the lower triangle of a
+    for (int j = 0; j < 6; ++j) {
+        double diagonal = a[j * 6 + j];
+        for (int k = 0; k < j; ++k) {
+            diagonal -= a[j * 6 + k] * a[j * 6 + k];
+        }
+        if (diagonal <= 1e-12) {
+            return false;
+        }
+        a[j * 6 + j] = sqrt(diagonal);
+        for (int i = j + 1; i < 6; ++i) {
+            double value = a[i * 6 + j];
+            for (int k = 0; k < j; ++k) {
+                value -= a[i * 6 + k] * a[j * 6 + k];
+            }
+            a[i * 6 + j] = value / a[j * 6 + j];
+        }
+    }
+    // L y = b, then L^T x = y
+    for (int i = 0; i < 6; ++i) {
+        for (int k = 0; k < i; ++k) {
+            b[i] -= a[i * 6 + k] * b[k];
+        }
+        b[i] /= a[i * 6 + i];
+    }
+    for (int i = 5; i >= 0; --i) {
+        for (int k = i + 1; k < 6; ++k) {
+            b[i] -= a[k * 6 + i] * b[k];
+        }
+        b[i] /= a[i * 6 + i];
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// Estimates the normals of the rows [first, last) of mRowOrder
+class SweepRegistration::NormalTask
+{
+public:
+    NormalTask(SweepRegistration& registration, VelodyneRangeImage const& image)
+        : mRegistration(registration)
+        , mImage(image)
+    {
+    }
+
+    void operator()(int first, int last, int /*worker*/)
+    {
+        SweepRegistration& r = mRegistration;
+        unsigned char const* valid = mImage.valid();
+        float const* range = mImage.range();
+        for (int i = first; i < last; ++i) {
+            int const row = r.mRowOrder[i];
+            int const below = (i > 0) ? r.mRowOrder[i - 1] : row;
+            int const above = (i + 1 < mImage.rows()) ? r.mRowOrder[i + 1] : row;
+            for (int col = 0; col < mImage.cols(); ++col) {
+                int const cell = mImage.index(row, col);
+                r.mNormalX[cell] = r.mNormalY[cell] = r.mNormalZ[cell] = 0;
+                if (!valid[cell]) {
+                    continue;
+                }
+                // a missing neighbour is replaced by the cell itself
+                int left = mImage.index(row, mImage.previousColumn(col));
+                int right = mImage.index(row, mImage.nextColumn(col));
+                int down = mImage.index(below, col);
+                int up = mImage.index(above, col);
+                left = valid[left] ? left : cell;
+                right = valid[right] ? right : cell;
+                down = valid[down] ? down : cell;
+                up = valid[up] ? up : cell;
+                if ((left == right) || (down == up)) {
+                    continue;
+                }
+                float const hx = r.mTargetX[right] - r.mTargetX[left];
+                float const hy = r.mTargetY[right] - r.mTargetY[left];
+                float const hz = r.mTargetZ[right] - r.mTargetZ[left];
+                float const vx = r.mTargetX[up] - r.mTargetX[down];
+                float const vy = r.mTargetY[up] - r.mTargetY[down];
+                float const vz = r.mTargetZ[up] - r.mTargetZ[down];
+                float const maxSpan = kMaxNormalSpan * range[cell];
+                if ((hx * hx + hy * hy + hz * hz > maxSpan * maxSpan)
+                    || (vx * vx + vy * vy + vz * vz > maxSpan * maxSpan)) {
+                    continue;
+                }
+                float const nx = hy * vz - hz * vy;
+                float const ny = hz * vx - hx * vz;
+                float const nz = hx * vy - hy * vx;
+                float const norm = sqrt(nx * nx + ny * ny + nz * nz);
+                if (norm < 1e-9f) {
+                    continue;
+                }
+                r.mNormalX[cell] = nx / norm;
+                r.mNormalY[cell] = ny / norm;
+                r.mNormalZ[cell] = nz / norm;
+            }
+        }
+    }
+
+private:
+    SweepRegistration& mRegistration;
+    VelodyneRangeImage const& mImage;
+};
+
+/// Matches the source points [first, last) and sums their normal equations
+class SweepRegistration::MatchTask
+{
+public:
+    explicit MatchTask(SweepRegistration& registration)
+        : mRegistration(registration)
+    {
+    }
+
+    void operator()(int first, int last, int worker)
+    {
+        SweepRegistration const& r = mRegistration;
+        Partial& partial = mRegistration.mPartials[worker];
+        memset(&partial, 0, sizeof(partial));
+
+        double const* rot = r.mEstimate.r;
+        double const* t = r.mEstimate.t;
+        float const maxSquaredDistance = r.mMaxDistance * r.mMaxDistance;
+        for (int i = first; i < last; ++i) {
+            double const sx = r.mSourceX[i];
+            double const sy = r.mSourceY[i];
+            double const sz = r.mSourceZ[i];
+            float const qx = static_cast<float>(rot[0] * sx + rot[1] * sy + rot[2] * sz + t[0]);
+            float const qy = static_cast<float>(rot[3] * sx + rot[4] * sy + rot[5] * sz + t[1]);
+            float const qz = static_cast<float>(rot[6] * sx + rot[7] * sy + rot[8] * sz + t[2]);
+
+            // cell of the moved point in the previous image, as the converter bins it
+            double azimuth = atan2(qx, qy);
+            if (azimuth < 0) {
+                azimuth += kTwoPi;
+            }
+            int const col = min(r.mCols - 1, static_cast<int>(azimuth / kTwoPi * r.mCols));
+            int const sortedRow = r.closestRow(atan2(qz, sqrt(qx * qx + qy * qy)));
+
+            int best = -1;
+            float bestDistance = maxSquaredDistance;
+            int const firstRow = max(0, sortedRow - kSearchRows);
+            int const lastRow = min(r.mRows - 1, sortedRow + kSearchRows);
+            for (int s = firstRow; s <= lastRow; ++s) {
+                int const rowStart = r.mRowOrder[s] * r.mCols;
+                for (int dc = -kSearchColumns; dc <= kSearchColumns; ++dc) {
+                    int const cell = rowStart + (col + dc + r.mCols) % r.mCols;
+                    if ((r.mNormalX[cell] == 0) && (r.mNormalY[cell] == 0) && (r.mNormalZ[cell] == 0)) {
+                        continue;
+                    }
+                    float const dx = qx - r.mTargetX[cell];
+                    float const dy = qy - r.mTargetY[cell];
+                    float const dz = qz - r.mTargetZ[cell];
+                    float const distance = dx * dx + dy * dy + dz * dz;
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        best = cell;
+                    }
+                }
+            }
+            if (best < 0) {
+                continue;
+            }
+
+            // residual along the normal and its jacobian [q x n, n]
+            double const nx = r.mNormalX[best];
+            double const ny = r.mNormalY[best];
+            double const nz = r.mNormalZ[best];
+            double const e = nx * (qx - r.mTargetX[best]) + ny * (qy - r.mTargetY[best])
+                + nz * (qz - r.mTargetZ[best]);
+            double const j[6] = {
+                qy * nz - qz * ny, qz * nx - qx * nz, qx * ny - qy * nx, nx, ny, nz
+            };
+            double* ata = partial.ata;
+            for (int a = 0; a < 6; ++a) {
+                for (int b = a; b < 6; ++b) {
+                    *ata++ += j[a] * j[b];
+                }
+                partial.atb[a] += j[a] * e;
+            }
+            partial.squaredError += e * e;
+            ++partial.count;
+        }
+    }
+
+private:
+    SweepRegistration& mRegistration;
+};
+
+//////////////////////////////////////////////////////////////////////////
+SweepRegistration::SweepRegistration()
+    : mColumnStep(kDefaultColumnStep)
+    , mMaxDistance(kDefaultMaxDistance)
+    , mMaxIterations(kDefaultMaxIterations)
+    , mBudget(kDefaultBudget)
+    , mRows(0)
+    , mCols(0)
+    , mHasTarget(false)
+    , mTargetTime(0)
+{
+    reset();
+}
+
+void SweepRegistration::configure(int columnStep, float maxDistance, int maxIterations, qint64 budget)
+{
+    mColumnStep = columnStep;
+    mMaxDistance = maxDistance;
+    mMaxIterations = maxIterations;
+    mBudget = budget;
+    reset();
+}
+
+void SweepRegistration::reset()
+{
+    mHasTarget = false;
+    mMotion = identity();
+    mOdometry = identity();
+    mPose.setToIdentity();
+    mResult.converged = false;
+    mResult.iterations.clear();
+    mResult.time = 0;
+    mResult.motion.setToIdentity();
+}
+
+QMatrix4x4 const& SweepRegistration::process(VelodyneRangeImage const& image)
+{
+    QElapsedTimer timer;
+    timer.start();
+    mResult.converged = false;
+    mResult.iterations.clear();
+
+    if (mHasTarget && (image.cols() == mCols) && (image.rows() == mRows)) {
+        gatherSource(image);
+        int const sourceCount = static_cast<int>(mSourceX.size());
+        int const workerCount = parallelWorkerCount(sourceCount, kMinPointsPerWorker);
+        mPartials.resize(workerCount);
+        MatchTask match(*this);
+
+        // constant velocity: the last motion is the first guess
+        mEstimate = mMotion;
+        // too few points: the workers would not even run
+        bool degenerate = (sourceCount < kMinCorrespondences);
+        for (int iteration = 0; !degenerate && (iteration < mMaxIterations); ++iteration) {
+            LIDAR_TRACE_SCOPE("SweepRegistration::iteration");
+            qint64 const start = timer.nsecsElapsed();
+            parallelFor(0, sourceCount, workerCount, match);
+
+            Partial sum;
+            memset(&sum, 0, sizeof(sum));
+            for (int w = 0; w < workerCount; ++w) {
+                for (int k = 0; k < 21; ++k) {
+                    sum.ata[k] += mPartials[w].ata[k];
+                }
+                for (int k = 0; k < 6; ++k) {
+                    sum.atb[k] += mPartials[w].atb[k];
+                }
+                sum.squaredError += mPartials[w].squaredError;
+                sum.count += mPartials[w].count;
+            }
+
+            double a[36];
+            double x[6];
+            for (int row = 0, k = 0; row < 6; ++row) {
+                for (int col = row; col < 6; ++col, ++k) {
+                    a[row * 6 + col] = a[col * 6 + row] = sum.ata[k];
+                }
+                x[row] = -sum.atb[row];
+            }
+            degenerate = (sum.count < kMinCorrespondences) || !solveCholesky(a, x);
+            if (!degenerate) {
+                mEstimate = compose(exponential(x, x + 3), mEstimate);
+            }
+
+            qint64 const end = timer.nsecsElapsed();
+            Iteration const done = {
+                sum.count,
+                static_cast<float>(sqrt(sum.squaredError / max(1, sum.count))),
+                end - start
+            };
+            mResult.iterations.push_back(done);
+            if (degenerate) {
+                break;
+            }
+            if ((sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]) < kMinRotationUpdate)
+                && (sqrt(x[3] * x[3] + x[4] * x[4] + x[5] * x[5]) < kMinTranslationUpdate)) {
+                mResult.converged = true;
+                break;
+            }
+            // the next iteration takes about as long as this one, the
+            // normals as long as the last ones
+            if (end + done.time + mTargetTime > mBudget) {
+                break;
+            }
+        }
+        // a degenerate sweep keeps the constant velocity guess
+        if (!degenerate) {
+            mMotion = mEstimate;
+        }
+        mOdometry = compose(mOdometry, mMotion);
+    } else {
+        mMotion = identity();
+    }
+
+    qint64 const targetStart = timer.nsecsElapsed();
+    prepareTarget(image);
+    mTargetTime = timer.nsecsElapsed() - targetStart;
+    mResult.motion = toMatrix(mMotion);
+    mPose = toMatrix(mOdometry);
+    mResult.time = timer.nsecsElapsed();
+    return mPose;
+}
+
+void SweepRegistration::gatherSource(VelodyneRangeImage const& image)
+{
+    mSourceX.clear();
+    mSourceY.clear();
+    mSourceZ.clear();
+    for (int row = 0; row < image.rows(); ++row) {
+        unsigned char const* valid = image.validRow(row);
+        float const* x = image.xRow(row);
+        float const* y = image.yRow(row);
+        float const* z = image.zRow(row);
+        for (int col = 0; col < image.cols(); col += mColumnStep) {
+            if (valid[col]) {
+                mSourceX.push_back(x[col]);
+                mSourceY.push_back(y[col]);
+                mSourceZ.push_back(z[col]);
+            }
+        }
+    }
+}
+
+void SweepRegistration::prepareTarget(VelodyneRangeImage const& image)
+{
+    mRows = image.rows();
+    mCols = image.cols();
+    mHasTarget = (mRows > 0) && (mCols > 0);
+    if (!mHasTarget) {
+        return;
+    }
+    mTargetX.assign(image.x(), image.x() + image.size());
+    mTargetY.assign(image.y(), image.y() + image.size());
+    mTargetZ.assign(image.z(), image.z() + image.size());
+    mNormalX.resize(image.size());
+    mNormalY.resize(image.size());
+    mNormalZ.resize(image.size());
+
+    mRowOrder.resize(mRows);
+    for (int row = 0; row < mRows; ++row) {
+        mRowOrder[row] = row;
+    }
+    // insertion sort, the rows come almost sorted or interleaved in a few runs
+    for (int i = 1; i < mRows; ++i) {
+        int const row = mRowOrder[i];
+        int j = i;
+        for (; (j > 0) && (image.rowAngle(mRowOrder[j - 1]) > image.rowAngle(row)); --j) {
+            mRowOrder[j] = mRowOrder[j - 1];
+        }
+        mRowOrder[j] = row;
+    }
+    mSortedAngles.resize(mRows);
+    for (int i = 0; i < mRows; ++i) {
+        mSortedAngles[i] = image.rowAngle(mRowOrder[i]);
+    }
+
+    NormalTask normals(*this, image);
+    parallelFor(0, mRows, parallelWorkerCount(mRows, kMinRowsPerWorker), normals);
+}
+
+int SweepRegistration::closestRow(float elevation) const
+{
+    int const upper = static_cast<int>(lower_bound(mSortedAngles.begin(), mSortedAngles.end(), elevation)
+                                       - mSortedAngles.begin());
+    if (upper == 0) {
+        return 0;
+    }
+    if (upper == mRows) {
+        return mRows - 1;
+    }
+    return (elevation - mSortedAngles[upper - 1] < mSortedAngles[upper] - elevation) ? upper - 1 : upper;
+}
+
+SweepRegistration::Transform SweepRegistration::identity()
+{
+    Transform const transform = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0 } };
+    return transform;
+}
+
+SweepRegistration::Transform SweepRegistration::compose(Transform const& a, Transform const& b)
+{
+    Transform result;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            result.r[i * 3 + j] = a.r[i * 3] * b.r[j] + a.r[i * 3 + 1] * b.r[3 + j] + a.r[i * 3 + 2] * b.r[6 + j];
+        }
+        result.t[i] = a.r[i * 3] * b.t[0] + a.r[i * 3 + 1] * b.t[1] + a.r[i * 3 + 2] * b.t[2] + a.t[i];
+    }
+    return result;
+}
+
+SweepRegistration::Transform SweepRegistration::exponential(double const w[3], double const v[3])
+{
+    // Rodrigues, the translation is taken as is for these small updates
+    Transform result = identity();
+    double const angle = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+    if (angle > 1e-12) {
+        double const kx = w[0] / angle;
+        double const ky = w[1] / angle;
+        double const kz = w[2] / angle;
+        double const c = cos(angle);
+        double const s = sin(angle);
+        double const c1 = 1 - c;
+        double const r[9] = {
+            c + kx * kx * c1,      kx * ky * c1 - kz * s, kx * kz * c1 + ky * s,
+            ky * kx * c1 + kz * s, c + ky * ky * c1,      ky * kz * c1 - kx * s,
+            kz * kx * c1 - ky * s, kz * ky * c1 + kx * s, c + kz * kz * c1
+        };
+        copy(r, r + 9, result.r);
+    }
+    copy(v, v + 3, result.t);
+    return result;
+}
+
+QMatrix4x4 SweepRegistration::toMatrix(Transform const& transform)
+{
+    double const* r = transform.r;
+    double const* t = transform.t;
+    return QMatrix4x4(static_cast<float>(r[0]), static_cast<float>(r[1]), static_cast<float>(r[2]), static_cast<float>(t[0]),
+                      static_cast<float>(r[3]), static_cast<float>(r[4]), static_cast<float>(r[5]), static_cast<float>(t[1]),
+                      static_cast<float>(r[6]), static_cast<float>(r[7]), static_cast<float>(r[8]), static_cast<float>(t[2]),
+                      0, 0, 0, 1);
+}
@@ -0,0 +1,146 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Scan to scan odometry: point-to-plane ICP between the range
+/// images of consecutive sweeps.
+///
+/// The normals of the previous sweep are estimated from the image
+/// neighbourhood of each cell: the returns on both sides in the same laser
+/// and those of the lasers just above and below. One column out of
+/// `columnStep` of the new sweep is then matched against it.
+///
+/// Correspondences are found by projection, as the clusterer finds its
+/// neighbours: a moved point falls into the column of its azimuth and the
+/// laser of its elevation, the closest return with a normal is searched
+/// in a few cells around. The search and the normal equations are split
+/// over the workers, each summing its own 6x6 system.
+///
+/// The motion of the previous sweep is the first guess, and is kept when
+/// the new sweep has too few points to register. Iterations stop once the
+/// update is negligible, after `maxIterations` or when another one would
+/// exceed the time budget. The budget covers the whole process() call: the
+/// normals of the new sweep, estimated after the iterations, are expected
+/// to take as long as the previous ones.
+
+#ifndef SWEEPREGISTRATION_H
+#define SWEEPREGISTRATION_H
+
+#include "VelodyneRangeImage.h"
+
+#include <QMatrix4x4>
+#include <QtGlobal>
+#include <vector>
+
+namespace pacpus
+{
+
+class SweepRegistration
+{
+public:
+    struct Iteration
+    {
+        int correspondences;
+        /// root mean square point to plane distance [m]
+        float rmsError;
+        /// [ns]
+        qint64 time;
+    };
+
+    struct Result
+    {
+        /// false for the first sweep, a degenerate system or no convergence
+        bool converged;
+        std::vector<Iteration> iterations;
+        /// whole registration, normals included [ns]
+        qint64 time;
+        /// motion from the previous sweep, new sensor frame to previous one
+        QMatrix4x4 motion;
+    };
+
+    SweepRegistration();
+
+    /// @param columnStep one column out of columnStep of a sweep is matched
+    /// @param maxDistance correspondences farther apart are rejected [m]
+    /// @param maxIterations per sweep
+    /// @param budget time allowed per sweep [ns]
+    void configure(int columnStep, float maxDistance, int maxIterations, qint64 budget);
+
+    /// Forgets the previous sweep, the odometry starts again at the identity
+    void reset();
+
+    /// Registers the image onto the previous one, which it then replaces.
+    /// @returns the sensor to odometry frame transform of the image
+    QMatrix4x4 const& process(VelodyneRangeImage const& image);
+
+    QMatrix4x4 const& pose() const { return mPose; }
+    Result const& lastResult() const { return mResult; }
+
+private:
+    class NormalTask;
+    class MatchTask;
+    friend class NormalTask;
+    friend class MatchTask;
+
+    /// Rigid transform in double precision, row-major rotation
+    struct Transform
+    {
+        double r[9];
+        double t[3];
+    };
+
+    /// Normal equations of a worker, upper triangle of J^T J
+    struct Partial
+    {
+        double ata[21];
+        double atb[6];
+        double squaredError;
+        int count;
+    };
+
+    void prepareTarget(VelodyneRangeImage const& image);
+    void gatherSource(VelodyneRangeImage const& image);
+    /// @returns the row of the target closest to the elevation, in mRowOrder
+    int closestRow(float elevation) const;
+
+    static Transform identity();
+    static Transform compose(Transform const& a, Transform const& b);
+    /// exp of a twist: rotation vector w [rad] and translation v [m]
+    static Transform exponential(double const w[3], double const v[3]);
+    static QMatrix4x4 toMatrix(Transform const& transform);
+
+    int mColumnStep;
+    float mMaxDistance;
+    int mMaxIterations;
+    qint64 mBudget;
+
+    /// previous sweep: its points and normals as image planes, a zero normal
+    /// where none could be estimated
+    int mRows, mCols;
+    std::vector<float> mTargetX, mTargetY, mTargetZ;
+    std::vector<float> mNormalX, mNormalY, mNormalZ;
+    /// target rows by increasing elevation, and their elevations [rad]
+    std::vector<int> mRowOrder;
+    std::vector<float> mSortedAngles;
+    bool mHasTarget;
+    /// time of the last normal estimation [ns]
+    qint64 mTargetTime;
+
+    /// points of the new sweep being matched
+    std::vector<float> mSourceX, mSourceY, mSourceZ;
+
+    /// estimate of the current iteration, read by the workers
+    Transform mEstimate;
+    std::vector<Partial> mPartials;
+
+    /// motion of the last sweep, first guess for the next one
+    Transform mMotion;
+    Transform mOdometry;
+    QMatrix4x4 mPose;
+    Result mResult;
+};
+
+} // namespace pacpus
+
+#endif // SWEEPREGISTRATION_H
@@ -0,0 +1,257 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "SweepRing.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <QSharedMemory>
+
+using namespace pacpus;
+using namespace std;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.SweepRing");
+
+static const boost::uint32_t kMagic = 0x4c565352; // "LVSR"
+static const boost::uint32_t kVersion = 1;
+
+/// Only used as a full memory barrier, Qt 5.2 has no standalone fence
+static QBasicAtomicInt sBarrier = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+static void memoryBarrier()
+{
+    sBarrier.fetchAndAddOrdered(0);
+}
+
+/// slots start on cache lines, so that two of them never share one
+static std::size_t alignToCacheLine(std::size_t size)
+{
+    return (size + 63) / 64 * 64;
+}
+
+static std::size_t slotSize(int slotCapacity)
+{
+    return alignToCacheLine(sizeof(SweepRingSlot) + slotCapacity * sizeof(SweepRingPoint));
+}
+
+static std::size_t slotOffset(SweepRingHeader const* header, int generation)
+{
+    return alignToCacheLine(sizeof(SweepRingHeader)) + (generation % header->slotCount) * header->slotSize;
+}
+
+static SweepRingPoint* slotPoints(SweepRingSlot* slot)
+{
+    return reinterpret_cast<SweepRingPoint*>(slot + 1);
+}
+
+static SweepRingPoint const* slotPoints(SweepRingSlot const* slot)
+{
+    return reinterpret_cast<SweepRingPoint const*>(slot + 1);
+}
+
+boost::uint32_t pacpus::sweepRingChecksum(SweepRingPoint const* points, std::size_t count)
+{
+    boost::uint32_t const* words = reinterpret_cast<boost::uint32_t const*>(points);
+    std::size_t const wordCount = count * sizeof(SweepRingPoint) / sizeof(boost::uint32_t);
+    boost::uint32_t sum = 0;
+    for (std::size_t i = 0; i < wordCount; ++i) {
+        sum += words[i];
+    }
+    return sum;
+}
+
+//////////////////////////////////////////////////////////////////////////
+SweepRingWriter::SweepRingWriter()
+    : mHeader(NULL)
+    , mGeneration(0)
+{
+    memset(&mStatistics, 0, sizeof(mStatistics));
+}
+
+SweepRingWriter::~SweepRingWriter()
+{
+    close();
+}
+
+bool SweepRingWriter::create(QString const& key, int slotCount, int slotCapacity)
+{
+    close();
+    std::size_t const size = alignToCacheLine(sizeof(SweepRingHeader)) + slotCount * slotSize(slotCapacity);
+    mMemory.reset(new QSharedMemory(key));
+    if (!mMemory->create(static_cast<int>(size))) {
+        if (mMemory->error() == QSharedMemory::AlreadyExists) {
+            // on Unix the segment of a crashed writer outlives it, the last detach removes it
+            mMemory->attach();
+            mMemory->detach();
+            mMemory->create(static_cast<int>(size));
+        }
+        if (!mMemory->isAttached()) {
+            LOG_ERROR("cannot create the shared memory '" << key << "': " << mMemory->errorString());
+            mMemory.reset();
+            return false;
+        }
+    }
+
+    mHeader = static_cast<SweepRingHeader*>(mMemory->data());
+    memset(mHeader, 0, size);
+    mHeader->magic = kMagic;
+    mHeader->version = kVersion;
+    mHeader->slotCount = slotCount;
+    mHeader->slotCapacity = slotCapacity;
+    mHeader->slotSize = static_cast<boost::uint32_t>(slotSize(slotCapacity));
+    mHeader->latest.storeRelease(0);
+    mGeneration = 0;
+    LOG_INFO("sharing the sweeps in '" << key << "': " << slotCount << " slots of "
+        << slotCapacity << " points, " << size / 1024 << " KiB");
+    return true;
+}
+
+void SweepRingWriter::close()
+{
+    mHeader = NULL;
+    mMemory.reset();
+}
+
+bool SweepRingWriter::isOpen() const
+{
+    return mHeader != NULL;
+}
+
+SweepRingSlot* SweepRingWriter::slot(int generation) const
+{
+    return reinterpret_cast<SweepRingSlot*>(reinterpret_cast<char*>(mHeader) + slotOffset(mHeader, generation));
+}
+
+void SweepRingWriter::write(LidarScan const& scan)
+{
+    if (!isOpen()) {
+        return;
+    }
+    ++mGeneration;
+    SweepRingSlot* const target = slot(mGeneration);
+
+    // readers still on the previous sweep of this slot fail validation from here
+    target->sequence.fetchAndStoreOrdered(2 * mGeneration - 1);
+
+    SweepRingPoint* const points = slotPoints(target);
+    boost::uint32_t const capacity = mHeader->slotCapacity;
+    boost::uint32_t count = 0, dropped = 0;
+    boost::uint32_t const layerCount = static_cast<boost::uint32_t>(
+        min<std::size_t>(scan.layers.size(), SweepRingSlot::kMaxLayers));
+    for (boost::uint32_t i = 0; i < layerCount; ++i) {
+        std::vector<LidarPoint> const& layer = scan.layers[i].points;
+        boost::uint32_t const size = static_cast<boost::uint32_t>(layer.size());
+        boost::uint32_t const kept = min(size, capacity - count);
+        for (boost::uint32_t j = 0; j < kept; ++j) {
+            SweepRingPoint& point = points[count + j];
+            point.x = layer[j].x;
+            point.y = layer[j].y;
+            point.z = layer[j].z;
+            point.intensity = layer[j].intensity;
+        }
+        count += kept;
+        dropped += size - kept;
+        target->layerEnd[i] = count;
+    }
+    target->pointCount = count;
+    target->layerCount = layerCount;
+    target->droppedCount = dropped;
+    target->checksum = sweepRingChecksum(points, count);
+
+    target->sequence.storeRelease(2 * mGeneration);
+    mHeader->latest.storeRelease(mGeneration);
+
+    ++mStatistics.written;
+    if (dropped > 0) {
+        ++mStatistics.truncated;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+SweepRingReader::SweepRingReader()
+    : mHeader(NULL)
+{
+}
+
+SweepRingReader::~SweepRingReader()
+{
+    detach();
+}
+
+bool SweepRingReader::attach(QString const& key)
+{
+    detach();
+    mMemory.reset(new QSharedMemory(key));
+    if (!mMemory->attach(QSharedMemory::ReadOnly)) {
+        mMemory.reset();
+        return false;
+    }
+    SweepRingHeader const* header = static_cast<SweepRingHeader const*>(mMemory->constData());
+    if ((static_cast<std::size_t>(mMemory->size()) < sizeof(SweepRingHeader))
+        || (header->magic != kMagic) || (header->version != kVersion) || (header->slotCount == 0)
+        || (header->slotSize != slotSize(header->slotCapacity))
+        || (static_cast<std::size_t>(mMemory->size()) < slotOffset(header, header->slotCount - 1) + header->slotSize)) {
+        LOG_WARN("'" << key << "' is not a sweep ring");
+        mMemory.reset();
+        return false;
+    }
+    mHeader = header;
+    return true;
+}
+
+void SweepRingReader::detach()
+{
+    mHeader = NULL;
+    mMemory.reset();
+}
+
+bool SweepRingReader::isAttached() const
+{
+    return mHeader != NULL;
+}
+
+int SweepRingReader::latestGeneration() const
+{
+    return isAttached() ? mHeader->latest.loadAcquire() : 0;
+}
+
+bool SweepRingReader::acquire(Snapshot& snapshot) const
+{
+    // the writer may lap a reader preempted between reading `latest` and the slot
+    static const int kAttempts = 4;
+    for (int attempt = 0; attempt < kAttempts; ++attempt) {
+        int const generation = latestGeneration();
+        if (generation == 0) {
+            return false;
+        }
+        SweepRingSlot const* slot = reinterpret_cast<SweepRingSlot const*>(
+            reinterpret_cast<char const*>(mHeader) + slotOffset(mHeader, generation));
+        int const sequence = slot->sequence.loadAcquire();
+        if (sequence != 2 * generation) {
+            continue;
+        }
+        snapshot.generation = generation;
+        // bounded, a torn read must not send the caller out of the slot
+        snapshot.pointCount = min(slot->pointCount, mHeader->slotCapacity);
+        snapshot.layerCount = min<boost::uint32_t>(slot->layerCount, SweepRingSlot::kMaxLayers);
+        snapshot.droppedCount = slot->droppedCount;
+        snapshot.checksum = slot->checksum;
+        snapshot.layerEnd = slot->layerEnd;
+        snapshot.points = slotPoints(slot);
+        snapshot.slot = slot;
+        snapshot.sequence = sequence;
+        return true;
+    }
+    return false;
+}
+
+bool SweepRingReader::validate(Snapshot const& snapshot) const
+{
+    // the reads of the points must not move after the sequence check
+    memoryBarrier();
+    return snapshot.slot->sequence.loadAcquire() == snapshot.sequence;
+}
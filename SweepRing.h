@@ -0,0 +1,152 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Converted sweeps shared with other local processes through a ring
+/// of shared memory slots.
+///
+/// One writer fills fixed-size slots in turn. Each slot has a sequence
+/// counter, odd while the slot is being written and equal to twice the
+/// generation of its sweep once complete; the header holds the generation
+/// of the newest complete sweep. Readers never lock nor write: they read
+/// the points in place and check afterwards that the sequence did not
+/// change, as with a seqlock. A reader slower than slotCount sweeps sees
+/// its reads fail validation and simply takes the newest sweep again.
+///
+/// Points are stored layer after layer as SweepRingPoint, layerEnd[i] is
+/// the index following the last point of layer i.
+
+#ifndef SWEEPRING_H
+#define SWEEPRING_H
+
+#include <structure/GenericLidar.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <QAtomicInt>
+#include <QString>
+
+class QSharedMemory;
+
+namespace pacpus
+{
+
+struct SweepRingPoint
+{
+    float x, y, z, intensity;
+};
+
+/// Shared memory layout, followed by the slots
+struct SweepRingHeader
+{
+    boost::uint32_t magic;
+    boost::uint32_t version;
+    boost::uint32_t slotCount;
+    /// points per slot
+    boost::uint32_t slotCapacity;
+    /// bytes between two slots
+    boost::uint32_t slotSize;
+    /// generation of the newest complete sweep, 0 before the first one
+    QBasicAtomicInt latest;
+};
+
+/// Slot header, followed by slotCapacity points
+struct SweepRingSlot
+{
+    static const int kMaxLayers = 64;
+
+    /// odd while written, 2 * generation once complete
+    QBasicAtomicInt sequence;
+    boost::uint32_t pointCount;
+    boost::uint32_t layerCount;
+    /// points that did not fit into the slot
+    boost::uint32_t droppedCount;
+    /// sum of the 32-bit words of the points, for consistency checks
+    boost::uint32_t checksum;
+    boost::uint32_t layerEnd[kMaxLayers];
+};
+
+/// Sum of the 32-bit words of the points, as stored in SweepRingSlot::checksum
+boost::uint32_t sweepRingChecksum(SweepRingPoint const* points, std::size_t count);
+
+class SweepRingWriter
+{
+public:
+    SweepRingWriter();
+    ~SweepRingWriter();
+
+    /// Creates the shared memory, replacing a segment left by a crashed writer.
+    /// @returns false if it cannot be created, e.g. while another writer uses the key
+    bool create(QString const& key, int slotCount, int slotCapacity);
+    void close();
+    bool isOpen() const;
+
+    /// Publishes a scan in the next slot, the points beyond the capacity are dropped
+    void write(LidarScan const& scan);
+
+    struct Statistics
+    {
+        unsigned long written;
+        /// sweeps that did not fit into a slot
+        unsigned long truncated;
+    };
+    Statistics statistics() const { return mStatistics; }
+
+private:
+    SweepRingSlot* slot(int generation) const;
+
+    boost::scoped_ptr<QSharedMemory> mMemory;
+    SweepRingHeader* mHeader;
+    int mGeneration;
+    Statistics mStatistics;
+};
+
+class SweepRingReader
+{
+public:
+    /// Points of one sweep, read in place in the shared memory
+    struct Snapshot
+    {
+        int generation;
+        boost::uint32_t pointCount;
+        boost::uint32_t layerCount;
+        boost::uint32_t droppedCount;
+        boost::uint32_t checksum;
+        boost::uint32_t const* layerEnd;
+        SweepRingPoint const* points;
+
+    private:
+        friend class SweepRingReader;
+        SweepRingSlot const* slot;
+        int sequence;
+    };
+
+    SweepRingReader();
+    ~SweepRingReader();
+
+    /// Attaches read-only to the memory of a writer
+    /// @returns false if there is no writer or the layout is not understood
+    bool attach(QString const& key);
+    void detach();
+    bool isAttached() const;
+
+    /// Generation of the newest complete sweep, 0 if none yet
+    int latestGeneration() const;
+
+    /// Points to the newest complete sweep.
+    /// @returns false if there is none or the writer keeps overwriting it
+    bool acquire(Snapshot& snapshot) const;
+
+    /// @returns true if the writer did not touch the slot since acquire(),
+    /// the data read in between is then consistent
+    bool validate(Snapshot const& snapshot) const;
+
+private:
+    boost::scoped_ptr<QSharedMemory> mMemory;
+    SweepRingHeader const* mHeader;
+};
+
+} // namespace pacpus
+
+#endif // SWEEPRING_H
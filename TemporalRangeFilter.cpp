@@ -0,0 +1,140 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "TemporalRangeFilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#   define LIDARVIEWER_SSE
+#   include <xmmintrin.h>
+#endif
+
+using namespace pacpus;
+using namespace std;
+
+/// Range stored for a beam without return, far from any real range
+static const float kNoReturn = 1e9f;
+
+static const int kDefaultDepth = 4;
+static const int kDefaultMinSupport = 1;
+static const float kDefaultTolerance = 0.5f;
+
+/// 1 if the closest of the three history ranges is within the tolerance
+static inline float supports(float left, float centre, float right, float range, float tolerance)
+{
+    float const difference = min(fabs(centre - range), min(fabs(left - range), fabs(right - range)));
+    return (difference <= tolerance) ? 1.0f : 0.0f;
+}
+
+TemporalRangeFilter::TemporalRangeFilter()
+    : mDepth(kDefaultDepth)
+    , mMinSupport(kDefaultMinSupport)
+    , mTolerance(kDefaultTolerance)
+    , mRows(0)
+    , mCols(0)
+    , mNext(0)
+    , mFilled(0)
+{
+}
+
+void TemporalRangeFilter::configure(int depth, int minSupport, float tolerance)
+{
+    mDepth = (depth < 1) ? 1 : ((depth > kMaxDepth) ? kMaxDepth : depth);
+    mMinSupport = max(1, min(mDepth, minSupport));
+    mTolerance = tolerance;
+    reset();
+}
+
+void TemporalRangeFilter::reset()
+{
+    mRows = 0;
+    mCols = 0;
+    mNext = 0;
+    mFilled = 0;
+}
+
+int TemporalRangeFilter::process(VelodyneRangeImage& image)
+{
+    if ((image.rows() != mRows) || (image.cols() != mCols)) {
+        mRows = image.rows();
+        mCols = image.cols();
+        mHistory.assign(static_cast<std::size_t>(mDepth) * image.size(), kNoReturn);
+        mSupport.resize(mCols);
+        mNext = 0;
+        mFilled = 0;
+    }
+    if (image.size() == 0) {
+        return 0;
+    }
+
+    bool const filtering = (mFilled >= mMinSupport);
+    float const minSupport = static_cast<float>(mMinSupport);
+    float* next = &mHistory[static_cast<std::size_t>(mNext) * image.size()];
+    int rejected = 0;
+    for (int row = 0; row < mRows; ++row) {
+        float const* range = image.rangeRow(row);
+        unsigned char* valid = image.valid() + image.index(row, 0);
+        float* support = &mSupport[0];
+        if (filtering) {
+            // empty slots hold kNoReturn and support nothing
+            fill(support, support + mCols, 0.0f);
+            for (int s = 0; s < mDepth; ++s) {
+                countSupport(&mHistory[static_cast<std::size_t>(s) * image.size() + image.index(row, 0)],
+                             range, support);
+            }
+        }
+
+        // all the returns go into the history, kept or not
+        float* history = next + image.index(row, 0);
+        for (int col = 0; col < mCols; ++col) {
+            history[col] = valid[col] ? range[col] : kNoReturn;
+        }
+
+        if (filtering) {
+            for (int col = 0; col < mCols; ++col) {
+                unsigned char const keep = valid[col] & (support[col] >= minSupport);
+                rejected += valid[col] - keep;
+                valid[col] = keep;
+            }
+        }
+    }
+
+    mNext = (mNext + 1) % mDepth;
+    mFilled = min(mDepth, mFilled + 1);
+    return rejected;
+}
+
+void TemporalRangeFilter::countSupport(float const* history, float const* range, float* support) const
+{
+    int const last = mCols - 1;
+    if (last < 1) {
+        support[0] += supports(history[0], history[0], history[0], range[0], mTolerance);
+        return;
+    }
+    // the columns wrap around at 0
+    support[0] += supports(history[last], history[0], history[1], range[0], mTolerance);
+    support[last] += supports(history[last - 1], history[last], history[0], range[last], mTolerance);
+
+    int col = 1;
+#ifdef LIDARVIEWER_SSE
+    __m128 const tolerance = _mm_set1_ps(mTolerance);
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const signBit = _mm_set1_ps(-0.0f);
+    for (; col + 4 <= last; col += 4) {
+        __m128 const r = _mm_loadu_ps(range + col);
+        __m128 const left = _mm_andnot_ps(signBit, _mm_sub_ps(_mm_loadu_ps(history + col - 1), r));
+        __m128 const centre = _mm_andnot_ps(signBit, _mm_sub_ps(_mm_loadu_ps(history + col), r));
+        __m128 const right = _mm_andnot_ps(signBit, _mm_sub_ps(_mm_loadu_ps(history + col + 1), r));
+        __m128 const difference = _mm_min_ps(centre, _mm_min_ps(left, right));
+        __m128 const confirmed = _mm_and_ps(_mm_cmple_ps(difference, tolerance), one);
+        _mm_storeu_ps(support + col, _mm_add_ps(_mm_loadu_ps(support + col), confirmed));
+    }
+#endif
+    for (; col < last; ++col) {
+        support[col] += supports(history[col - 1], history[col], history[col + 1], range[col], mTolerance);
+    }
+}
@@ -0,0 +1,78 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Drops the returns of a range image that no recent sweep confirms:
+/// rain, spray, dust and other isolated flickering returns.
+///
+/// The ranges of the last `depth` sweeps are kept per beam, in a ring of
+/// range images indexed like the image itself (laser row, azimuth column).
+/// A return is supported by a previous sweep when that sweep had a return
+/// within `tolerance` of its range in the same column or one of the two
+/// neighbouring ones, i.e. when the min over these three cells of the range
+/// difference is small enough. It is kept when at least `minSupport` of the
+/// previous sweeps support it: 1 is a min-of-k test, depth / 2 + 1 a median
+/// one.
+///
+/// The test runs along each laser row, four azimuth columns at a time with
+/// SSE where available. Every return is added to the history, kept or not,
+/// so a new obstacle is only delayed by `minSupport` sweeps. The history is
+/// sized once for the image, a change of image size restarts it.
+///
+/// Sweeps are compared in the sensor frame: the tolerance must cover the
+/// motion of the sensor between `depth` sweeps.
+
+#ifndef TEMPORALRANGEFILTER_H
+#define TEMPORALRANGEFILTER_H
+
+#include "VelodyneRangeImage.h"
+
+#include <vector>
+
+namespace pacpus
+{
+
+class TemporalRangeFilter
+{
+public:
+    static const int kMaxDepth = 8;
+
+    TemporalRangeFilter();
+
+    /// @param depth previous sweeps kept per beam, 1 to kMaxDepth
+    /// @param minSupport previous sweeps that must confirm a return, 1 to depth
+    /// @param tolerance largest range difference of a confirming return [m]
+    void configure(int depth, int minSupport, float tolerance);
+
+    /// Forgets the history, the next sweeps pass unfiltered until it is
+    /// deep enough
+    void reset();
+
+    /// Clears the valid flag of the unsupported returns of the image, then
+    /// adds all its returns to the history.
+    /// @returns the number of returns rejected
+    int process(VelodyneRangeImage& image);
+
+private:
+    /// Adds 1 to support[c] for every column c of the row a history row confirms
+    void countSupport(float const* history, float const* range, float* support) const;
+
+    int mDepth;
+    int mMinSupport;
+    float mTolerance;
+
+    int mRows, mCols;
+    /// mDepth range images, kNoReturn where a sweep had no return
+    std::vector<float> mHistory;
+    /// image of the history overwritten by the next sweep
+    int mNext;
+    /// sweeps in the history
+    int mFilled;
+    /// confirming sweeps of each column of the current row
+    std::vector<float> mSupport;
+};
+
+} // namespace pacpus
+
+#endif // TEMPORALRANGEFILTER_H
@@ -0,0 +1,354 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "TileCache.h"
+#include "LidarTrace.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <boost/foreach.hpp>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector4D>
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <utility>
+
+using namespace pacpus;
+using namespace std;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.TileCache");
+
+static const qint64 kDefaultMemoryBudget = 256 * 1024 * 1024;
+/// Larger tiles are decimated when loaded
+static const int kMaxTilePoints = 256 * 1024;
+/// Uploads per frame, the rest waits for the next frames
+static const int kMaxUploadsPerFrame = 4;
+/// Outstanding load requests, nearest tiles first
+static const std::size_t kMaxRequests = 16;
+/// Reload a resident tile once the map holds this many times more points
+static const float kStaleRatio = 1.25f;
+
+static bool intersectsFrustum(QMatrix4x4 const& viewProjection,
+                              float x0, float y0, float z0, float x1, float y1, float z1)
+{
+    // the box is culled when all its corners are outside of the same clip plane
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int corner = 0; corner < 8; ++corner) {
+        QVector4D const p = viewProjection * QVector4D((corner & 1) ? x1 : x0,
+                                                       (corner & 2) ? y1 : y0,
+                                                       (corner & 4) ? z1 : z0, 1);
+        outside[0] += (p.x() < -p.w());
+        outside[1] += (p.x() > p.w());
+        outside[2] += (p.y() < -p.w());
+        outside[3] += (p.y() > p.w());
+        outside[4] += (p.z() < -p.w());
+        outside[5] += (p.z() > p.w());
+    }
+    for (int plane = 0; plane < 6; ++plane) {
+        if (outside[plane] == 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+class TileCache::LoaderThread
+    : public QThread
+{
+public:
+    LoaderThread(TileCache* cache)
+        : mCache(cache)
+    {
+        setObjectName("LidarViewer tile loader");
+    }
+
+protected:
+    void run() /* override */
+    {
+        mCache->loadLoop();
+    }
+
+private:
+    TileCache* mCache;
+};
+
+//////////////////////////////////////////////////////////////////////////
+TileCache::TileCache(QObject* parent)
+    : QObject(parent)
+    , mMap(NULL)
+    , mBudget(kDefaultMemoryBudget)
+    , mFrame(0)
+    , mResidentBytes(0)
+    , mEvictions(0)
+    , mStopping(false)
+    , mLoads(0)
+{
+    mLoading.x = mLoading.y = INT_MIN;
+    mThread.reset(new LoaderThread(this));
+}
+
+TileCache::~TileCache()
+{
+    stopLoader();
+}
+
+void TileCache::setMap(TiledMap* map)
+{
+    stopLoader();
+    mMap = map;
+    mResident.clear();
+    mResidentBytes = 0;
+    if (mMap) {
+        QMutexLocker lock(&mMutex);
+        mStopping = false;
+        mRequests.clear();
+        mReady.clear();
+        lock.unlock();
+        mThread->start();
+    }
+}
+
+void TileCache::setMemoryBudget(qint64 budget)
+{
+    mBudget = budget;
+}
+
+void TileCache::stopLoader()
+{
+    {
+        QMutexLocker lock(&mMutex);
+        mStopping = true;
+        mWake.wakeAll();
+    }
+    mThread->wait();
+}
+
+void TileCache::update(QMatrix4x4 const& viewProjection, QVector3D const& eye)
+{
+    if (!mMap) {
+        return;
+    }
+    LIDAR_TRACE_SCOPE("TileCache::update");
+    ++mFrame;
+
+    // tiles in the frustum, nearest first
+    float const tileSize = mMap->tileSize();
+    // shared snapshot, taken without waiting for the map writer
+    TiledMap::TileList const snapshot = mMap->tiles();
+    vector<TiledMap::TileInfo> const& tiles = *snapshot;
+    vector<pair<float, size_t> > candidates;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        TiledMap::TileInfo const& tile = tiles[i];
+        float const x0 = tile.key.x * tileSize;
+        float const y0 = tile.key.y * tileSize;
+        if (!intersectsFrustum(viewProjection, x0, y0, tile.minZ, x0 + tileSize, y0 + tileSize, tile.maxZ)) {
+            continue;
+        }
+        QVector3D const center(x0 + tileSize / 2, y0 + tileSize / 2, (tile.minZ + tile.maxZ) / 2);
+        candidates.push_back(make_pair((center - eye).lengthSquared(), i));
+    }
+    sort(candidates.begin(), candidates.end());
+
+    // wanted tiles, until the budget is spent
+    QHash<TileKey, int> wanted;
+    vector<size_t> wantedOrder;
+    qint64 wantedBytes = 0;
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        TiledMap::TileInfo const& tile = tiles[candidates[c].second];
+        int const stride = max(1, (tile.pointCount + kMaxTilePoints - 1) / kMaxTilePoints);
+        qint64 const bytes = static_cast<qint64>(tile.pointCount / stride + 1) * sizeof(MapVertex);
+        if (wantedBytes + bytes > mBudget) {
+            break;
+        }
+        wantedBytes += bytes;
+        wanted.insert(tile.key, stride);
+        wantedOrder.push_back(candidates[c].second);
+    }
+
+    for (QHash<TileKey, ResidentTile>::iterator it = mResident.begin(); it != mResident.end(); ++it) {
+        it.value().visible = wanted.contains(it.key());
+        if (it.value().visible) {
+            it.value().lastUsed = mFrame;
+        }
+    }
+
+    // upload a few ready tiles, drop the ones not wanted any more
+    vector<QSharedPointer<LoadedTile> > uploads;
+    {
+        QMutexLocker lock(&mMutex);
+        QHash<TileKey, QSharedPointer<LoadedTile> >::iterator it = mReady.begin();
+        while (it != mReady.end()) {
+            if (!wanted.contains(it.key())) {
+                it = mReady.erase(it);
+            } else if (uploads.size() < static_cast<size_t>(kMaxUploadsPerFrame)) {
+                uploads.push_back(it.value());
+                it = mReady.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    BOOST_FOREACH(QSharedPointer<LoadedTile> const& tile, uploads) {
+        qint64 bytes = static_cast<qint64>(tile->vertices.size()) * sizeof(MapVertex);
+        QHash<TileKey, ResidentTile>::const_iterator resident = mResident.find(tile->key);
+        if (resident != mResident.end()) {
+            bytes -= static_cast<qint64>(resident.value().vertexCount) * sizeof(MapVertex);
+        }
+        if (makeRoom(bytes, wanted)) {
+            upload(*tile);
+        }
+    }
+
+    // request the missing and the stale tiles
+    QMutexLocker lock(&mMutex);
+    mRequests.clear();
+    BOOST_FOREACH(size_t index, wantedOrder) {
+        TiledMap::TileInfo const& tile = tiles[index];
+        QHash<TileKey, ResidentTile>::const_iterator resident = mResident.find(tile.key);
+        if ((resident != mResident.end())
+            && (resident.value().sourcePointCount * kStaleRatio >= tile.pointCount)) {
+            continue;
+        }
+        if ((tile.key == mLoading) || mReady.contains(tile.key)) {
+            continue;
+        }
+        TileRequest request;
+        request.key = tile.key;
+        request.stride = wanted.value(tile.key);
+        mRequests.push_back(request);
+        if (mRequests.size() >= kMaxRequests) {
+            break;
+        }
+    }
+    if (!mRequests.empty()) {
+        mWake.wakeOne();
+    }
+}
+
+bool TileCache::makeRoom(qint64 bytes, QHash<TileKey, int> const& wanted)
+{
+    while (mResidentBytes + bytes > mBudget) {
+        QHash<TileKey, ResidentTile>::iterator oldest = mResident.end();
+        for (QHash<TileKey, ResidentTile>::iterator it = mResident.begin(); it != mResident.end(); ++it) {
+            if (wanted.contains(it.key())) {
+                continue;
+            }
+            if ((oldest == mResident.end()) || (it.value().lastUsed < oldest.value().lastUsed)) {
+                oldest = it;
+            }
+        }
+        if (oldest == mResident.end()) {
+            return false;
+        }
+        oldest.value().buffer->destroy();
+        mResidentBytes -= static_cast<qint64>(oldest.value().vertexCount) * sizeof(MapVertex);
+        mResident.erase(oldest);
+        ++mEvictions;
+    }
+    return true;
+}
+
+void TileCache::upload(LoadedTile const& tile)
+{
+    ResidentTile& resident = mResident[tile.key];
+    if (!resident.buffer) {
+        resident.buffer = QSharedPointer<QOpenGLBuffer>(new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer));
+        resident.buffer->create();
+        resident.buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
+    } else {
+        mResidentBytes -= static_cast<qint64>(resident.vertexCount) * sizeof(MapVertex);
+    }
+    resident.buffer->bind();
+    resident.buffer->allocate(tile.vertices.empty() ? NULL : &tile.vertices[0],
+                              static_cast<int>(tile.vertices.size() * sizeof(MapVertex)));
+    resident.buffer->release();
+    resident.vertexCount = static_cast<int>(tile.vertices.size());
+    resident.sourcePointCount = tile.sourcePointCount;
+    resident.lastUsed = mFrame;
+    resident.visible = true;
+    mResidentBytes += static_cast<qint64>(resident.vertexCount) * sizeof(MapVertex);
+}
+
+int TileCache::draw()
+{
+    int pointsDrawn = 0;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    for (QHash<TileKey, ResidentTile>::const_iterator it = mResident.begin(); it != mResident.end(); ++it) {
+        ResidentTile const& tile = it.value();
+        if (!tile.visible || (tile.vertexCount == 0)) {
+            continue;
+        }
+        tile.buffer->bind();
+        glVertexPointer(3, GL_FLOAT, sizeof(MapVertex), reinterpret_cast<GLvoid const*>(offsetof(MapVertex, x)));
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(MapVertex), reinterpret_cast<GLvoid const*>(offsetof(MapVertex, r)));
+        glDrawArrays(GL_POINTS, 0, tile.vertexCount);
+        tile.buffer->release();
+        pointsDrawn += tile.vertexCount;
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    return pointsDrawn;
+}
+
+void TileCache::loadLoop()
+{
+    vector<MapPoint> points;
+    for (;;) {
+        TileRequest request;
+        {
+            QMutexLocker lock(&mMutex);
+            while (!mStopping && mRequests.empty()) {
+                mWake.wait(&mMutex);
+            }
+            if (mStopping) {
+                return;
+            }
+            request = mRequests.front();
+            mRequests.pop_front();
+            mLoading = request.key;
+        }
+
+        LIDAR_TRACE_SCOPE("TileCache::load");
+        QSharedPointer<LoadedTile> tile(new LoadedTile);
+        tile->key = request.key;
+        mMap->readTile(request.key, request.stride, points);
+        tile->sourcePointCount = static_cast<int>(points.size()) * request.stride;
+        tile->vertices.resize(points.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            MapVertex& vertex = tile->vertices[i];
+            vertex.x = points[i].x;
+            vertex.y = points[i].y;
+            vertex.z = points[i].z;
+            // grey by intensity, unlike the colored live scan
+            GLubyte const grey = static_cast<GLubyte>(64 + min(points[i].intensity, 255.0f) * 0.75f);
+            vertex.r = vertex.g = vertex.b = grey;
+            vertex.a = 255;
+        }
+
+        {
+            QMutexLocker lock(&mMutex);
+            mLoading.x = mLoading.y = INT_MIN;
+            mReady.insert(tile->key, tile);
+            ++mLoads;
+        }
+        Q_EMIT tileLoaded();
+    }
+}
+
+TileCache::Statistics TileCache::statistics() const
+{
+    Statistics statistics;
+    statistics.residentTiles = mResident.size();
+    statistics.residentBytes = mResidentBytes;
+    statistics.evictions = mEvictions;
+    QMutexLocker lock(&mMutex);
+    statistics.loads = mLoads;
+    return statistics;
+}
@@ -0,0 +1,134 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Resident tiles of a TiledMap, chosen from the camera.
+///
+/// Each frame, the tiles intersecting the view frustum are sorted by
+/// distance to the camera and kept until the memory budget is spent. The
+/// missing ones are requested from a loader thread, which copies them out
+/// of the map file and builds their vertices; the GUI thread only uploads
+/// a few ready tiles per frame, so navigation never waits for the disk.
+/// Tiles that are not wanted any more are evicted in least recently used
+/// order when the budget is exceeded.
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "TiledMap.h"
+
+#include <QHash>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QObject>
+#include <QOpenGLBuffer>
+#include <qopengl.h>
+#include <QSharedPointer>
+#include <QVector3D>
+#include <QWaitCondition>
+
+#include <boost/scoped_ptr.hpp>
+#include <deque>
+#include <vector>
+
+namespace pacpus
+{
+
+class TileCache
+    : public QObject
+{
+    Q_OBJECT
+
+public:
+    TileCache(QObject* parent = 0);
+    ~TileCache();
+
+    /// @param map NULL disables the cache
+    void setMap(TiledMap* map);
+    /// Memory for the resident tiles [B]
+    void setMemoryBudget(qint64 budget);
+
+    /// Chooses the resident tiles and uploads the loaded ones.
+    /// The GL context must be current.
+    void update(QMatrix4x4 const& viewProjection, QVector3D const& eye);
+    /// Draws the resident tiles in the frustum of the last update().
+    /// @returns the number of points drawn
+    int draw();
+
+    struct Statistics
+    {
+        int residentTiles;
+        qint64 residentBytes;
+        unsigned long loads;
+        unsigned long evictions;
+    };
+    Statistics statistics() const;
+
+Q_SIGNALS:
+    /// Emitted by the loader thread when a tile is ready for upload
+    void tileLoaded();
+
+private:
+    class LoaderThread;
+
+    struct MapVertex
+    {
+        GLfloat x, y, z;
+        GLubyte r, g, b, a;
+    };
+
+    struct TileRequest
+    {
+        TileKey key;
+        int stride;
+    };
+
+    struct LoadedTile
+    {
+        TileKey key;
+        /// points in the map when the tile was read
+        int sourcePointCount;
+        std::vector<MapVertex> vertices;
+    };
+
+    struct ResidentTile
+    {
+        QSharedPointer<QOpenGLBuffer> buffer;
+        int vertexCount;
+        int sourcePointCount;
+        unsigned long lastUsed;
+        bool visible;
+    };
+
+    void loadLoop();
+    void stopLoader();
+    void upload(LoadedTile const& tile);
+    /// Evicts unwanted tiles until `bytes` more fit in the budget.
+    bool makeRoom(qint64 bytes, QHash<TileKey, int> const& wanted);
+
+    TiledMap* mMap;
+    qint64 mBudget;
+    unsigned long mFrame;
+
+    // GUI thread
+    QHash<TileKey, ResidentTile> mResident;
+    qint64 mResidentBytes;
+    unsigned long mEvictions;
+
+    // shared with the loader thread
+    mutable QMutex mMutex;
+    QWaitCondition mWake;
+    bool mStopping;
+    std::deque<TileRequest> mRequests;
+    /// tile being read, x = INT_MIN if none
+    TileKey mLoading;
+    QHash<TileKey, QSharedPointer<LoadedTile> > mReady;
+    unsigned long mLoads;
+
+    boost::scoped_ptr<LoaderThread> mThread;
+};
+
+} // namespace pacpus
+
+#endif // TILECACHE_H
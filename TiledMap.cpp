@@ -0,0 +1,348 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "TiledMap.h"
+#include "LidarTrace.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <boost/foreach.hpp>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace pacpus;
+using namespace std;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.TiledMap");
+
+static const qint64 kSegmentSize = 64 * 1024 * 1024;
+static const int kChunkPoints = 1024;
+/// room for the file header before the first chunk
+static const qint64 kFileHeaderSize = 64;
+static const char kFileMagic[] = "LidarViewer tiled map 1";
+/// sweeps waiting to be written, older ones are dropped
+static const std::size_t kQueueCapacity = 4;
+/// tiles of the grouping buffer kept allocated between sweeps
+static const int kMaxPendingTiles = 1024;
+
+//////////////////////////////////////////////////////////////////////////
+class TiledMap::WriterThread
+    : public QThread
+{
+public:
+    WriterThread(TiledMap* map)
+        : mMap(map)
+    {
+        setObjectName("LidarViewer map");
+    }
+
+protected:
+    void run() /* override */
+    {
+        mMap->writeLoop();
+    }
+
+private:
+    TiledMap* mMap;
+};
+
+//////////////////////////////////////////////////////////////////////////
+TiledMap::TiledMap()
+    : mTileSize(1)
+    , mEnd(0)
+    , mPointCount(0)
+    , mTiles(new vector<TileInfo>)
+    , mQueue(kQueueCapacity, QOP_DropOldest)
+{
+    mThread.reset(new WriterThread(this));
+}
+
+TiledMap::~TiledMap()
+{
+    close();
+}
+
+bool TiledMap::open(QString const& path, float tileSize)
+{
+    close();
+
+    QMutexLocker lock(&mMutex);
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        LOG_ERROR("cannot create map file '" << path << "'");
+        return false;
+    }
+    mTileSize = tileSize;
+    mEnd = kFileHeaderSize;
+    mIndex.clear();
+    mPointCount = 0;
+
+    mFile.write(kFileMagic, sizeof(kFileMagic));
+    mFile.write(reinterpret_cast<char const*>(&mTileSize), sizeof(mTileSize));
+    lock.unlock();
+    publishTiles();
+
+    mQueue.reopen();
+    mThread->start();
+    return true;
+}
+
+void TiledMap::close()
+{
+    mQueue.close();
+    mThread->wait();
+
+    QMutexLocker lock(&mMutex);
+    BOOST_FOREACH(unsigned char* segment, mSegments) {
+        mFile.unmap(segment);
+    }
+    mSegments.clear();
+    mIndex.clear();
+    if (mFile.isOpen()) {
+        mFile.close();
+    }
+    lock.unlock();
+    publishTiles();
+}
+
+bool TiledMap::isOpen() const
+{
+    QMutexLocker lock(&mMutex);
+    return mFile.isOpen();
+}
+
+void TiledMap::enqueue(LidarSweepPtr const& sweep, QMatrix4x4 const& pose)
+{
+    mQueue.push(make_pair(sweep, pose));
+}
+
+void TiledMap::writeLoop()
+{
+    pair<LidarSweepPtr, QMatrix4x4> item;
+    while (mQueue.pop(item)) {
+        LIDAR_TRACE_SCOPE("TiledMap::append");
+        append(item.first->scan, item.second);
+        item.first.clear();
+    }
+}
+
+void TiledMap::append(LidarScan const& scan, QMatrix4x4 const& pose)
+{
+    // the file is only opened and closed with the writer stopped
+    if (!mFile.isOpen()) {
+        return;
+    }
+
+    // group the points by tile, outside of the lock
+    float const* m = pose.constData();    // column-major
+    float const inverseTileSize = 1 / mTileSize;
+    BOOST_FOREACH(LidarLayer const& layer, scan.layers) {
+        BOOST_FOREACH(LidarPoint const& point, layer.points) {
+            MapPoint world;
+            world.x = m[0] * point.x + m[4] * point.y + m[8] * point.z + m[12];
+            world.y = m[1] * point.x + m[5] * point.y + m[9] * point.z + m[13];
+            world.z = m[2] * point.x + m[6] * point.y + m[10] * point.z + m[14];
+            world.intensity = point.intensity;
+
+            TileKey key;
+            key.x = static_cast<int>(floor(world.x * inverseTileSize));
+            key.y = static_cast<int>(floor(world.y * inverseTileSize));
+            mPending[key].push_back(world);
+        }
+    }
+
+    // at most one partly filled chunk per tile, and one more if it is new
+    int chunkCount = 0;
+    for (QHash<TileKey, vector<MapPoint> >::const_iterator it = mPending.begin(); it != mPending.end(); ++it) {
+        if (!it.value().empty()) {
+            chunkCount += static_cast<int>((it.value().size() + kChunkPoints - 1) / kChunkPoints) + 1;
+        }
+    }
+    bool const reserved = reserveChunks(chunkCount);
+
+    {
+        QMutexLocker lock(&mMutex);
+        for (QHash<TileKey, vector<MapPoint> >::iterator it = mPending.begin(); it != mPending.end(); ++it) {
+            if (reserved && !it.value().empty()) {
+                appendToTile(it.key(), &it.value()[0], static_cast<int>(it.value().size()));
+            }
+            it.value().clear();
+        }
+    }
+    if (mPending.size() > kMaxPendingTiles) {
+        mPending.clear();
+    }
+    publishTiles();
+}
+
+void TiledMap::appendToTile(TileKey const& key, MapPoint const* points, int count)
+{
+    QHash<TileKey, TileEntry>::iterator entry = mIndex.find(key);
+    if (entry == mIndex.end()) {
+        qint64 const chunk = allocateChunk(key);
+        if (chunk < 0) {
+            return;
+        }
+        TileEntry newEntry;
+        newEntry.firstChunk = newEntry.lastChunk = chunk;
+        newEntry.pointCount = 0;
+        newEntry.minZ = points[0].z;
+        newEntry.maxZ = points[0].z;
+        entry = mIndex.insert(key, newEntry);
+    }
+
+    TileEntry& tile = entry.value();
+    for (int i = 0; i < count; ++i) {
+        tile.minZ = min(tile.minZ, points[i].z);
+        tile.maxZ = max(tile.maxZ, points[i].z);
+    }
+
+    while (count > 0) {
+        ChunkHeader* header = reinterpret_cast<ChunkHeader*>(address(tile.lastChunk));
+        if (header->count == kChunkPoints) {
+            qint64 const chunk = allocateChunk(key);
+            if (chunk < 0) {
+                return;
+            }
+            // the mapping may have grown, the header address is still valid
+            header->next = chunk;
+            tile.lastChunk = chunk;
+            header = reinterpret_cast<ChunkHeader*>(address(chunk));
+        }
+        int const n = min(count, kChunkPoints - header->count);
+        MapPoint* const data = reinterpret_cast<MapPoint*>(header + 1);
+        memcpy(data + header->count, points, n * sizeof(MapPoint));
+        header->count += n;
+        tile.pointCount += n;
+        mPointCount += n;
+        points += n;
+        count -= n;
+    }
+}
+
+/// Offset of the chunk following `end`, chunks never straddle two segments
+static qint64 chunkOffset(qint64 end, qint64 chunkSize)
+{
+    if ((end / kSegmentSize) != ((end + chunkSize - 1) / kSegmentSize)) {
+        return (end / kSegmentSize + 1) * kSegmentSize;
+    }
+    return end;
+}
+
+bool TiledMap::reserveChunks(int chunkCount)
+{
+    // only the writer thread changes mEnd and mSegments, it reads them unlocked
+    qint64 const chunkSize = sizeof(ChunkHeader) + kChunkPoints * sizeof(MapPoint);
+    qint64 end = mEnd;
+    for (int i = 0; i < chunkCount; ++i) {
+        end = chunkOffset(end, chunkSize) + chunkSize;
+    }
+    while (static_cast<qint64>(mSegments.size()) * kSegmentSize < end) {
+        qint64 const segmentCount = static_cast<qint64>(mSegments.size());
+        // disk I/O, outside of the lock
+        if (!mFile.resize((segmentCount + 1) * kSegmentSize)) {
+            LOG_ERROR("cannot grow map file: " << mFile.errorString());
+            return false;
+        }
+        unsigned char* segment = mFile.map(segmentCount * kSegmentSize, kSegmentSize);
+        if (!segment) {
+            LOG_ERROR("cannot map map file: " << mFile.errorString());
+            return false;
+        }
+        QMutexLocker lock(&mMutex);
+        mSegments.push_back(segment);
+    }
+    return true;
+}
+
+qint64 TiledMap::allocateChunk(TileKey const& key)
+{
+    qint64 const chunkSize = sizeof(ChunkHeader) + kChunkPoints * sizeof(MapPoint);
+    qint64 const offset = chunkOffset(mEnd, chunkSize);
+    if (offset + chunkSize > static_cast<qint64>(mSegments.size()) * kSegmentSize) {
+        LOG_ERROR("map chunk allocated beyond the reserved space");
+        return -1;
+    }
+
+    ChunkHeader* header = reinterpret_cast<ChunkHeader*>(address(offset));
+    header->tileX = key.x;
+    header->tileY = key.y;
+    header->count = 0;
+    header->reserved = 0;
+    header->next = 0;
+    mEnd = offset + chunkSize;
+    return offset;
+}
+
+unsigned char* TiledMap::address(qint64 offset) const
+{
+    return mSegments[static_cast<std::size_t>(offset / kSegmentSize)] + offset % kSegmentSize;
+}
+
+void TiledMap::publishTiles()
+{
+    // the index only changes in this thread, or with the writer stopped
+    QSharedPointer<vector<TileInfo> > infos(new vector<TileInfo>);
+    infos->reserve(mIndex.size());
+    for (QHash<TileKey, TileEntry>::const_iterator it = mIndex.begin(); it != mIndex.end(); ++it) {
+        TileInfo info;
+        info.key = it.key();
+        info.pointCount = it.value().pointCount;
+        info.minZ = it.value().minZ;
+        info.maxZ = it.value().maxZ;
+        infos->push_back(info);
+    }
+    QMutexLocker lock(&mTilesMutex);
+    mTiles = infos;
+}
+
+TiledMap::TileList TiledMap::tiles() const
+{
+    QMutexLocker lock(&mTilesMutex);
+    return mTiles;
+}
+
+bool TiledMap::readTile(TileKey const& key, int stride, vector<MapPoint>& points) const
+{
+    points.clear();
+    QMutexLocker lock(&mMutex);
+    QHash<TileKey, TileEntry>::const_iterator entry = mIndex.find(key);
+    if (entry == mIndex.end()) {
+        return false;
+    }
+    points.reserve(entry.value().pointCount / stride + 1);
+
+    int skip = 0;
+    for (qint64 chunk = entry.value().firstChunk; ; ) {
+        ChunkHeader const* header = reinterpret_cast<ChunkHeader const*>(address(chunk));
+        MapPoint const* const data = reinterpret_cast<MapPoint const*>(header + 1);
+        for (int i = skip; i < header->count; i += stride) {
+            points.push_back(data[i]);
+        }
+        // keep the stride across chunks
+        skip = (skip + stride - header->count % stride) % stride;
+        if (header->next == 0) {
+            break;
+        }
+        chunk = header->next;
+    }
+    return true;
+}
+
+TiledMap::Statistics TiledMap::statistics() const
+{
+    Statistics statistics;
+    statistics.droppedSweeps = mQueue.dropCount();
+
+    QMutexLocker lock(&mMutex);
+    statistics.tileCount = mIndex.size();
+    statistics.pointCount = mPointCount;
+    statistics.fileSize = static_cast<qint64>(mSegments.size()) * kSegmentSize;
+    return statistics;
+}
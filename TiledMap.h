@@ -0,0 +1,160 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief World-frame map of accumulated sweeps, stored on disk by tiles.
+///
+/// The XY plane is cut into square tiles. The points of a tile are appended
+/// to a chain of fixed-size chunks in a memory-mapped file, which grows by
+/// segments of 64 MiB. Only the per-tile index (first and last chunk, point
+/// count, height range) stays in memory, so the map can be much larger
+/// than the RAM.
+///
+/// Sweeps are queued and appended by a writer thread. The file is grown
+/// and mapped before the lock is taken, so readers copying tiles out under
+/// the lock never wait for the disk. After each sweep the writer publishes
+/// a snapshot of the index, which readers take without copying it.
+
+#ifndef TILEDMAP_H
+#define TILEDMAP_H
+
+#include "BoundedQueue.h"
+#include "LidarSweep.h"
+
+#include <QFile>
+#include <QHash>
+#include <QMatrix4x4>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+
+#include <boost/scoped_ptr.hpp>
+#include <utility>
+#include <vector>
+
+namespace pacpus
+{
+
+struct TileKey
+{
+    int x, y;
+
+    bool operator==(TileKey const& other) const
+    {
+        return (x == other.x) && (y == other.y);
+    }
+};
+
+inline uint qHash(TileKey const& key)
+{
+    return static_cast<uint>(key.x) * 73856093u ^ static_cast<uint>(key.y) * 19349663u;
+}
+
+/// Point as stored in the map file
+struct MapPoint
+{
+    float x, y, z;
+    float intensity;
+};
+
+class TiledMap
+{
+public:
+    struct TileInfo
+    {
+        TileKey key;
+        int pointCount;
+        float minZ, maxZ;
+    };
+    typedef QSharedPointer<std::vector<TileInfo> const> TileList;
+
+    TiledMap();
+    ~TiledMap();
+
+    /// Creates the map file, an existing file is overwritten.
+    /// @param tileSize side of a tile [m]
+    bool open(QString const& path, float tileSize);
+    void close();
+    bool isOpen() const;
+
+    float tileSize() const
+    {
+        return mTileSize;
+    }
+
+    /// Queues a sweep to be added to the map, never blocks.
+    /// @param pose sensor to world transform
+    void enqueue(LidarSweepPtr const& sweep, QMatrix4x4 const& pose);
+
+    /// Snapshot of the index as of the last sweep appended, never null
+    TileList tiles() const;
+
+    /// Copies the points of a tile, keeping one point out of `stride`.
+    /// @returns false if the tile does not exist
+    bool readTile(TileKey const& key, int stride, std::vector<MapPoint>& points) const;
+
+    struct Statistics
+    {
+        int tileCount;
+        qint64 pointCount;
+        qint64 fileSize;
+        unsigned long droppedSweeps;
+    };
+    Statistics statistics() const;
+
+private:
+    class WriterThread;
+
+    struct TileEntry
+    {
+        qint64 firstChunk, lastChunk;
+        int pointCount;
+        float minZ, maxZ;
+    };
+
+    struct ChunkHeader
+    {
+        qint32 tileX, tileY;
+        qint32 count;
+        qint32 reserved;
+        /// offset of the next chunk of the tile, 0 for the last one
+        qint64 next;
+    };
+
+    void writeLoop();
+    void append(LidarScan const& scan, QMatrix4x4 const& pose);
+    void appendToTile(TileKey const& key, MapPoint const* points, int count);
+    /// Grows and maps the file so that chunkCount more chunks fit, only
+    /// locking to add the new mappings
+    bool reserveChunks(int chunkCount);
+    /// Takes the next chunk of the reserved space
+    qint64 allocateChunk(TileKey const& key);
+    void publishTiles();
+    unsigned char* address(qint64 offset) const;
+
+    float mTileSize;
+
+    mutable QMutex mMutex;
+    QFile mFile;
+    /// one mapping per segment of the file
+    std::vector<unsigned char*> mSegments;
+    qint64 mEnd;
+    /// only changed by the writer thread, under the lock
+    QHash<TileKey, TileEntry> mIndex;
+    qint64 mPointCount;
+
+    /// guards mTiles only, held for a pointer copy
+    mutable QMutex mTilesMutex;
+    TileList mTiles;
+
+    BoundedQueue<std::pair<LidarSweepPtr, QMatrix4x4> > mQueue;
+    boost::scoped_ptr<WriterThread> mThread;
+
+    /// points of the current sweep grouped by tile, only used by the writer
+    QHash<TileKey, std::vector<MapPoint> > mPending;
+};
+
+} // namespace pacpus
+
+#endif // TILEDMAP_H
@@ -0,0 +1,135 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "VelodyneCalibration.h"
+
+#include <Pacpus/kernel/Log.h>
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+using namespace pacpus;
+using namespace std;
+
+DECLARE_STATIC_LOGGER("pacpus.LidarViewer.VelodyneCalibration");
+
+static const double kPi = 3.14159265358979323846;
+static const double kToRad = kPi / 180.0;
+
+// uncalibrated model: linear elevation ramp
+static const double kDefaultTopAngle = 10.67;       // [deg]
+static const double kDefaultAngleResolution = 1.33; // [deg]
+
+VelodyneCalibration::VelodyneCalibration()
+{
+    buildAzimuthTable();
+    setDefault(32);
+}
+
+void VelodyneCalibration::buildAzimuthTable()
+{
+    mCosAzimuth.resize(kAzimuthSteps);
+    mSinAzimuth.resize(kAzimuthSteps);
+    for (int i = 0; i < kAzimuthSteps; ++i) {
+        double const alpha = (i / 100.0) * kToRad;
+        mCosAzimuth[i] = static_cast<float>(cos(alpha));
+        mSinAzimuth[i] = static_cast<float>(sin(alpha));
+    }
+}
+
+void VelodyneCalibration::setDefault(int laserCount)
+{
+    vector<double> angles(laserCount);
+    double beta = kDefaultTopAngle - kDefaultAngleResolution * laserCount;
+    for (int j = 0; j < laserCount; ++j) {
+        angles[j] = beta;
+        beta += kDefaultAngleResolution;
+    }
+    setVerticalAngles(&angles[0], laserCount);
+}
+
+void VelodyneCalibration::setVerticalAngles(double const* angles, int laserCount)
+{
+    vector<LaserCorrection> corrections(laserCount);
+    for (int j = 0; j < laserCount; ++j) {
+        LaserCorrection& c = corrections[j];
+        c.vertCorrection = angles[j];
+        c.rotCorrection = 0.0;
+        c.distCorrection = 0.0;
+        c.vertOffsetCorrection = 0.0;
+        c.horizOffsetCorrection = 0.0;
+    }
+    buildTable(corrections);
+}
+
+bool VelodyneCalibration::load(string const& path)
+{
+    ifstream file(path.c_str());
+    if (!file) {
+        LOG_ERROR("cannot open Velodyne calibration file '" << path << "'");
+        return false;
+    }
+
+    vector<LaserCorrection> corrections;
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line)) {
+        ++lineNumber;
+        string::size_type const first = line.find_first_not_of(" \t\r");
+        if ((first == string::npos) || (line[first] == '#')) {
+            continue;
+        }
+
+        istringstream fields(line);
+        LaserCorrection c;
+        if (!(fields >> c.vertCorrection >> c.rotCorrection >> c.distCorrection
+                     >> c.vertOffsetCorrection >> c.horizOffsetCorrection)) {
+            LOG_ERROR("malformed Velodyne calibration '" << path << "' at line " << lineNumber);
+            return false;
+        }
+        corrections.push_back(c);
+    }
+
+    if (corrections.empty()) {
+        LOG_ERROR("Velodyne calibration file '" << path << "' contains no laser");
+        return false;
+    }
+
+    buildTable(corrections);
+    LOG_INFO("loaded Velodyne calibration for " << laserCount() << " lasers from '" << path << "'");
+    return true;
+}
+
+void VelodyneCalibration::buildTable(vector<LaserCorrection> const& corrections)
+{
+    size_t const n = corrections.size();
+    mVertAngle.resize(n);
+    mCosVert.resize(n);
+    mSinVert.resize(n);
+    mCosRot.resize(n);
+    mSinRot.resize(n);
+    mDistCorr.resize(n);
+    mVertOffsetSin.resize(n);
+    mVertOffsetCos.resize(n);
+    mHorizOffset.resize(n);
+
+    for (size_t j = 0; j < n; ++j) {
+        LaserCorrection const& c = corrections[j];
+        double const vert = c.vertCorrection * kToRad;
+        double const rot = c.rotCorrection * kToRad;
+        double const vertOffset = c.vertOffsetCorrection / 100.0;
+
+        mVertAngle[j] = static_cast<float>(vert);
+        mCosVert[j] = static_cast<float>(cos(vert));
+        mSinVert[j] = static_cast<float>(sin(vert));
+        mCosRot[j] = static_cast<float>(cos(rot));
+        mSinRot[j] = static_cast<float>(sin(rot));
+        mDistCorr[j] = static_cast<float>(c.distCorrection / 100.0);
+        mVertOffsetSin[j] = static_cast<float>(vertOffset * sin(vert));
+        mVertOffsetCos[j] = static_cast<float>(vertOffset * cos(vert));
+        mHorizOffset[j] = static_cast<float>(c.horizOffsetCorrection / 100.0);
+    }
+}
@@ -0,0 +1,112 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Per-laser Velodyne calibration folded into a precomputed table.
+///
+/// The calibration file is a plain text table with one laser per line:
+///
+///     vertCorrection rotCorrection distCorrection vertOffsetCorrection horizOffsetCorrection
+///
+/// Angles are in degrees, distances in centimetres (Velodyne conventions).
+/// Empty lines and lines starting with '#' are ignored. The line order gives
+/// the laser index in the raw block.
+///
+/// All trigonometry is evaluated once at load time: the conversion loop only
+/// uses the per-laser table and the azimuth look-up table.
+
+#ifndef VELODYNECALIBRATION_H
+#define VELODYNECALIBRATION_H
+
+#include <string>
+#include <vector>
+
+namespace pacpus
+{
+
+class VelodyneCalibration
+{
+public:
+    /// Number of azimuth steps in the raw data (angles in 1/100 degree).
+    static const int kAzimuthSteps = 36000;
+
+    VelodyneCalibration();
+
+    /// Resets to the uncalibrated linear elevation ramp used so far.
+    void setDefault(int laserCount);
+
+    /// Resets to an uncalibrated model with the given elevations [deg], one
+    /// per laser in the raw block order, e.g. the nominal ones of a model.
+    void setVerticalAngles(double const* angles, int laserCount);
+
+    /// Loads a calibration file.
+    /// @returns false and leaves the table untouched on error.
+    bool load(std::string const& path);
+
+    int laserCount() const
+    {
+        return static_cast<int>(mCosVert.size());
+    }
+
+    /// Raw distance unit in metres (2 mm increments).
+    static float rawDistanceUnit()
+    {
+        return 0.002f;
+    }
+
+    /// cos/sin of a raw azimuth given in 1/100 degree.
+    float cosAzimuth(unsigned int angle) const
+    {
+        return mCosAzimuth[angle % kAzimuthSteps];
+    }
+    float sinAzimuth(unsigned int angle) const
+    {
+        return mSinAzimuth[angle % kAzimuthSteps];
+    }
+
+    /// Elevation angle of a laser in radians.
+    float verticalAngle(int laser) const
+    {
+        return mVertAngle[laser];
+    }
+
+    // flat per-laser table, indexed by laser
+    float const* cosVert() const { return &mCosVert[0]; }
+    float const* sinVert() const { return &mSinVert[0]; }
+    float const* cosRotCorrection() const { return &mCosRot[0]; }
+    float const* sinRotCorrection() const { return &mSinRot[0]; }
+    float const* distCorrection() const { return &mDistCorr[0]; }
+    /// vertOffsetCorrection * sin(vertAngle), in metres
+    float const* vertOffsetSinVert() const { return &mVertOffsetSin[0]; }
+    /// vertOffsetCorrection * cos(vertAngle), in metres
+    float const* vertOffsetCosVert() const { return &mVertOffsetCos[0]; }
+    /// horizOffsetCorrection, in metres
+    float const* horizOffset() const { return &mHorizOffset[0]; }
+
+private:
+    struct LaserCorrection
+    {
+        double vertCorrection;          // [deg]
+        double rotCorrection;           // [deg]
+        double distCorrection;          // [cm]
+        double vertOffsetCorrection;    // [cm]
+        double horizOffsetCorrection;   // [cm]
+    };
+
+    void buildTable(std::vector<LaserCorrection> const& corrections);
+    void buildAzimuthTable();
+
+    std::vector<float> mCosAzimuth, mSinAzimuth;
+
+    std::vector<float> mVertAngle;
+    std::vector<float> mCosVert, mSinVert;
+    std::vector<float> mCosRot, mSinRot;
+    std::vector<float> mDistCorr;
+    std::vector<float> mVertOffsetSin, mVertOffsetCos;
+    std::vector<float> mHorizOffset;
+};
+
+} // namespace pacpus
+
+#endif // VELODYNECALIBRATION_H
@@ -0,0 +1,291 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "VelodyneConverter.h"
+#include "VelodyneModels.h"
+
+#include <boost/static_assert.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace pacpus;
+using namespace std;
+
+static const float kDefaultMinRange = 1.5f;
+/// [1/100 deg] azimuth between two firings when a single block is converted
+static const unsigned int kDefaultFiringStep = 20;
+
+static bool inAzimuthWindow(unsigned int angle, unsigned int minAzimuth, unsigned int maxAzimuth)
+{
+    unsigned int const azimuth = angle % VelodyneCalibration::kAzimuthSteps;
+    return (minAzimuth > maxAzimuth)
+        ? ((azimuth >= minAzimuth) || (azimuth <= maxAzimuth))
+        : ((azimuth >= minAzimuth) && (azimuth <= maxAzimuth));
+}
+
+VelodyneConverter::Crop::Crop()
+    : minRange(kDefaultMinRange)
+    , maxRange(numeric_limits<float>::max())
+    , minAzimuth(0)
+    , maxAzimuth(360)
+    , minZ(-numeric_limits<float>::max())
+    , maxZ(numeric_limits<float>::max())
+    , boxX(0)
+    , boxY(0)
+    , boxYaw(0)
+    , boxHalfLength(numeric_limits<float>::max())
+    , boxHalfWidth(numeric_limits<float>::max())
+{
+}
+
+VelodyneConverter::VelodyneConverter()
+    : mModel(modelTable())
+    , mColumnCount(kDefaultColumnCount)
+{
+    memset(&mCropStatistics, 0, sizeof(mCropStatistics));
+}
+
+VelodyneConverter::ModelEntry const* VelodyneConverter::modelTable()
+{
+    static const ModelEntry kModels[] = {
+        { Hdl32Model::name(), Hdl32Model::kLaserCount, &Hdl32Model::verticalAngles, &VelodyneConverter::decodeBlocks<Hdl32Model> },
+        { Vlp16Model::name(), Vlp16Model::kLaserCount, &Vlp16Model::verticalAngles, &VelodyneConverter::decodeBlocks<Vlp16Model> },
+        { Hdl64Model::name(), Hdl64Model::kLaserCount, &Hdl64Model::verticalAngles, &VelodyneConverter::decodeBlocks<Hdl64Model> },
+        { NULL, 0, NULL, NULL }
+    };
+    return kModels;
+}
+
+bool VelodyneConverter::setModel(string const& model)
+{
+    for (ModelEntry const* entry = modelTable(); entry->name; ++entry) {
+        if (model == entry->name) {
+            mModel = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+string VelodyneConverter::model() const
+{
+    return mModel->name;
+}
+
+vector<string> VelodyneConverter::models()
+{
+    vector<string> names;
+    for (ModelEntry const* entry = modelTable(); entry->name; ++entry) {
+        names.push_back(entry->name);
+    }
+    return names;
+}
+
+void VelodyneConverter::setDefaultCalibration()
+{
+    mCalibration.setVerticalAngles(mModel->verticalAngles(), mModel->laserCount);
+}
+
+void VelodyneConverter::convert(VelodynePolarData const& data, VelodyneRangeImage& image)
+{
+    beginRevolution(image);
+    convertBlocks(data, 0, static_cast<int>(data.range), image);
+}
+
+int VelodyneConverter::laserCount() const
+{
+    return min(mCalibration.laserCount(), mModel->laserCount);
+}
+
+void VelodyneConverter::beginRevolution(VelodyneRangeImage& image)
+{
+    int const rows = laserCount();
+    if ((image.rows() != rows) || (image.cols() != mColumnCount)) {
+        image.resize(rows, mColumnCount);
+    } else {
+        image.clear();
+    }
+    for (int j = 0; j < rows; ++j) {
+        image.setRowAngle(j, mCalibration.verticalAngle(j));
+    }
+}
+
+void VelodyneConverter::convertBlocks(VelodynePolarData const& data, int firstBlock, int blockCount,
+                                      VelodyneRangeImage& image)
+{
+    if (blockCount <= 0) {
+        return;
+    }
+    (this->*mModel->decode)(data, firstBlock, blockCount, image);
+}
+
+template <class Model>
+void VelodyneConverter::decodeBlocks(VelodynePolarData const& data, int firstBlock, int blockCount,
+                                     VelodyneRangeImage& image)
+{
+    static const int kLasersPerFiring = Model::kLasersPerFiring;
+    static const int kFiringsPerBlock = Model::kFiringsPerBlock;
+    static const int kBlocksPerFiring = Model::kBlocksPerFiring;
+    BOOST_STATIC_ASSERT(kLasersPerFiring * kFiringsPerBlock
+        <= sizeof(data.polarData[0].rawPoints) / sizeof(data.polarData[0].rawPoints[0]));
+    int const laserCount = min(image.rows(), static_cast<int>(Model::kLaserCount));
+
+    // azimuth of each firing, shared by the lasers fired together
+    int const firingCount = blockCount * kFiringsPerBlock;
+    mFiringCos.resize(firingCount);
+    mFiringSin.resize(firingCount);
+    mFiringColumn.resize(firingCount);
+    mFiringInAzimuth.resize(firingCount);
+    unsigned int const minAzimuth = static_cast<unsigned int>(mCrop.minAzimuth * 100);
+    unsigned int const maxAzimuth = static_cast<unsigned int>(mCrop.maxAzimuth * 100);
+    unsigned int firingStep = kDefaultFiringStep;
+    for (int i = 0; i < blockCount; ++i) {
+        unsigned int const angle = data.polarData[firstBlock + i].angle;
+        if (kFiringsPerBlock > 1) {
+            // the later firings of a block lie between its azimuth and the next block's
+            if (i + kBlocksPerFiring < blockCount) {
+                unsigned int const nextAngle = data.polarData[firstBlock + i + kBlocksPerFiring].angle;
+                firingStep = ((nextAngle + VelodyneCalibration::kAzimuthSteps - angle)
+                              % VelodyneCalibration::kAzimuthSteps) / kFiringsPerBlock;
+            }
+        }
+        for (int f = 0; f < kFiringsPerBlock; ++f) {
+            unsigned int const firingAngle = angle + f * firingStep;
+            int const k = i * kFiringsPerBlock + f;
+            mFiringCos[k] = mCalibration.cosAzimuth(firingAngle);
+            mFiringSin[k] = mCalibration.sinAzimuth(firingAngle);
+            mFiringColumn[k] = image.columnOf(firingAngle % VelodyneCalibration::kAzimuthSteps);
+            mFiringInAzimuth[k] = inAzimuthWindow(firingAngle, minAzimuth, maxAzimuth);
+        }
+    }
+
+    mRowRange.resize(firingCount);
+    mRowX.resize(firingCount);
+    mRowY.resize(firingCount);
+    mRowZ.resize(firingCount);
+    mRowKeep.resize(firingCount);
+    float* rowRange = &mRowRange[0];
+    float* rowX = &mRowX[0];
+    float* rowY = &mRowY[0];
+    float* rowZ = &mRowZ[0];
+    unsigned char* rowKeep = &mRowKeep[0];
+    unsigned char const* firingInAzimuth = &mFiringInAzimuth[0];
+    float const* firingCos = &mFiringCos[0];
+    float const* firingSin = &mFiringSin[0];
+    int const* firingColumn = &mFiringColumn[0];
+
+    float const distUnit = VelodyneCalibration::rawDistanceUnit();
+    float const* cosVert = mCalibration.cosVert();
+    float const* sinVert = mCalibration.sinVert();
+    float const* cosRotCorr = mCalibration.cosRotCorrection();
+    float const* sinRotCorr = mCalibration.sinRotCorrection();
+    float const* distCorr = mCalibration.distCorrection();
+    float const* vertOffsetSin = mCalibration.vertOffsetSinVert();
+    float const* vertOffsetCos = mCalibration.vertOffsetCosVert();
+    float const* horizOffset = mCalibration.horizOffset();
+
+    float const minRange = mCrop.minRange;
+    float const maxRange = mCrop.maxRange;
+    float const minZ = mCrop.minZ;
+    float const maxZ = mCrop.maxZ;
+    float const boxX = mCrop.boxX;
+    float const boxY = mCrop.boxY;
+    float const boxCos = cos(mCrop.boxYaw);
+    float const boxSin = sin(mCrop.boxYaw);
+    float const boxHalfLength = mCrop.boxHalfLength;
+    float const boxHalfWidth = mCrop.boxHalfWidth;
+
+    float* rangePlane = image.range();
+    float* xPlane = image.x();
+    float* yPlane = image.y();
+    float* zPlane = image.z();
+    float* intensityPlane = image.intensity();
+    unsigned char* validPlane = image.valid();
+
+    for (int j = 0; j < laserCount; ++j) {
+        int const rowStart = image.index(j, 0);
+        // the laser is in the blocks of its group, in the channel of its firing
+        int const group = j / kLasersPerFiring;
+        int const channel = j % kLasersPerFiring;
+        int const firstGroupBlock = (group + kBlocksPerFiring - firstBlock % kBlocksPerFiring) % kBlocksPerFiring;
+        if (firstGroupBlock >= blockCount) {
+            continue;
+        }
+        int const rowLength = (blockCount - firstGroupBlock + kBlocksPerFiring - 1) / kBlocksPerFiring * kFiringsPerBlock;
+
+        // conversion and filters of the whole row, no branches
+        int rangeRejected = 0, azimuthRejected = 0, heightRejected = 0, boxRejected = 0;
+        for (int n = 0; n < rowLength; ++n) {
+            int const i = firstGroupBlock + n / kFiringsPerBlock * kBlocksPerFiring;
+            int const f = n % kFiringsPerBlock;
+            int const k = i * kFiringsPerBlock + f;
+            float const rawDistance = data.polarData[firstBlock + i].rawPoints[f * kLasersPerFiring + channel].distance * distUnit;
+            float const d = rawDistance + distCorr[j];
+
+            // Application des corrections du LIDAR (cf. doc velodyne)
+            // cos/sin(alpha - rotCorrection) from the precomputed tables
+            float const cosRotAngle = firingCos[k] * cosRotCorr[j] + firingSin[k] * sinRotCorr[j];
+            float const sinRotAngle = firingSin[k] * cosRotCorr[j] - firingCos[k] * sinRotCorr[j];
+
+            float const dxy = d * cosVert[j] - vertOffsetSin[j];
+            float const x = dxy * sinRotAngle - horizOffset[j] * cosRotAngle;
+            float const y = dxy * cosRotAngle + horizOffset[j] * sinRotAngle;
+            float const z = d * sinVert[j] + vertOffsetCos[j];
+            rowRange[n] = d;
+            rowX[n] = x;
+            rowY[n] = y;
+            rowZ[n] = z;
+
+            // a null distance is no return, it is neither kept nor counted
+            int const isReturn = rawDistance > 0;
+            int const inRange = (d >= minRange) & (d <= maxRange);
+            int const inAzimuth = firingInAzimuth[k];
+            int const inHeight = (z >= minZ) & (z <= maxZ);
+            float const alongBox = (x - boxX) * boxCos + (y - boxY) * boxSin;
+            float const acrossBox = (y - boxY) * boxCos - (x - boxX) * boxSin;
+            int const inBox = (fabs(alongBox) <= boxHalfLength) & (fabs(acrossBox) <= boxHalfWidth);
+
+            rangeRejected += isReturn & (1 - inRange);
+            azimuthRejected += isReturn & inRange & (1 - inAzimuth);
+            heightRejected += isReturn & inRange & inAzimuth & (1 - inHeight);
+            boxRejected += isReturn & inRange & inAzimuth & inHeight & (1 - inBox);
+            rowKeep[n] = static_cast<unsigned char>(isReturn & inRange & inAzimuth & inHeight & inBox);
+        }
+        mCropStatistics.rejected[CF_Range] += rangeRejected;
+        mCropStatistics.rejected[CF_Azimuth] += azimuthRejected;
+        mCropStatistics.rejected[CF_Height] += heightRejected;
+        mCropStatistics.rejected[CF_Box] += boxRejected;
+
+        // only the kept returns are written, the nearest one of a cell wins
+        int kept = 0, collisions = 0;
+        for (int n = 0; n < rowLength; ++n) {
+            if (!rowKeep[n]) {
+                continue;
+            }
+            int const i = firstGroupBlock + n / kFiringsPerBlock * kBlocksPerFiring;
+            int const f = n % kFiringsPerBlock;
+            int const cell = rowStart + firingColumn[i * kFiringsPerBlock + f];
+            if (validPlane[cell]) {
+                ++collisions;
+                if (rangePlane[cell] <= rowRange[n]) {
+                    continue;
+                }
+            } else {
+                ++kept;
+            }
+            rangePlane[cell] = rowRange[n];
+            xPlane[cell] = rowX[n];
+            yPlane[cell] = rowY[n];
+            zPlane[cell] = rowZ[n];
+            intensityPlane[cell] = data.polarData[firstBlock + i].rawPoints[f * kLasersPerFiring + channel].intensity;
+            validPlane[cell] = 1;
+        }
+        mCropStatistics.kept += kept;
+        mCropStatistics.collisions += collisions;
+    }
+}
@@ -0,0 +1,156 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Polar to Cartesian conversion of Velodyne revolutions.
+///
+/// Converts a VelodynePolarData revolution into a VelodyneRangeImage using
+/// the precomputed calibration tables. Each block is binned into the range
+/// image column of its azimuth. Returns of a laser falling into the same
+/// cell, when a revolution has more blocks than columns (5 Hz, dual
+/// return), keep the nearest one and are counted as collisions.
+///
+/// Returns outside the region of interest (Crop) are dropped by the
+/// conversion itself: they are never written to the image and never reach
+/// the later stages. The filters are evaluated without branches over each
+/// laser row, the kept returns are then written in a second pass.
+///
+/// The block layout depends on the sensor model (VelodyneModels.h). Each
+/// model has its own instance of the conversion kernel, picked by name from
+/// a registry, so that the layout is known at compile time in the loops.
+
+#ifndef VELODYNECONVERTER_H
+#define VELODYNECONVERTER_H
+
+#include "VelodyneCalibration.h"
+#include "VelodyneRangeImage.h"
+
+#include "structure/structure_velodyne.h"
+
+#include <string>
+#include <vector>
+
+namespace pacpus
+{
+
+class VelodyneConverter
+{
+public:
+    /// Default number of azimuth bins: 1/6 degree, about one HDL-32 firing at 10 Hz
+    static const int kDefaultColumnCount = 2160;
+    /// One column per raw azimuth step of 1/100 degree
+    static const int kMaxColumnCount = 36000;
+
+    /// Region of interest, in the sensor frame which is the vehicle frame here.
+    /// The default one keeps every return beyond 1.5 m.
+    struct Crop
+    {
+        Crop();
+
+        /// corrected distance [m]
+        float minRange, maxRange;
+        /// raw azimuth window [deg], from minAzimuth to maxAzimuth in the
+        /// direction of rotation, wraps through 0 when minAzimuth > maxAzimuth
+        float minAzimuth, maxAzimuth;
+        /// height band [m]
+        float minZ, maxZ;
+        /// oriented box in the XY plane: center [m], yaw [rad] of its length
+        /// axis from X, half length and half width [m]
+        float boxX, boxY, boxYaw;
+        float boxHalfLength, boxHalfWidth;
+    };
+
+    /// Filters of the crop, a rejected return is counted by the first one it fails
+    enum CropFilter {
+        CF_Range,
+        CF_Azimuth,
+        CF_Height,
+        CF_Box,
+        CF_Count
+    };
+
+    struct CropStatistics
+    {
+        /// returns written to the image
+        unsigned long long kept;
+        unsigned long long rejected[CF_Count];
+        /// returns that passed the crop but lost their cell to a nearer one
+        unsigned long long collisions;
+    };
+
+    VelodyneConverter();
+
+    /// Selects the decoder of a sensor model, hdl32 by default.
+    /// @returns false for an unknown model, the selection is then unchanged
+    bool setModel(std::string const& model);
+    std::string model() const;
+    /// Names accepted by setModel()
+    static std::vector<std::string> models();
+
+    /// Resets the calibration to the nominal elevations of the model
+    void setDefaultCalibration();
+
+    VelodyneCalibration& calibration() { return mCalibration; }
+    VelodyneCalibration const& calibration() const { return mCalibration; }
+
+    void setColumnCount(int columnCount) { mColumnCount = columnCount; }
+    int columnCount() const { return mColumnCount; }
+
+    void setCrop(Crop const& crop) { mCrop = crop; }
+    Crop const& crop() const { return mCrop; }
+
+    /// Counts since construction, only consistent while no conversion runs
+    CropStatistics const& cropStatistics() const { return mCropStatistics; }
+
+    /// Converts a whole revolution, the image is resized if needed.
+    void convert(VelodynePolarData const& data, VelodyneRangeImage& image);
+
+    /// Sizes and clears the image for a new revolution.
+    void beginRevolution(VelodyneRangeImage& image);
+    /// Converts the given blocks into an image prepared by beginRevolution(),
+    /// other columns are left untouched.
+    void convertBlocks(VelodynePolarData const& data, int firstBlock, int blockCount,
+                       VelodyneRangeImage& image);
+
+    /// Number of lasers converted, i.e. rows of the range image
+    int laserCount() const;
+
+private:
+    typedef void (VelodyneConverter::*DecodeFunction)(VelodynePolarData const& data, int firstBlock,
+                                                      int blockCount, VelodyneRangeImage& image);
+
+    struct ModelEntry
+    {
+        char const* name;
+        int laserCount;
+        double const* (*verticalAngles)();
+        DecodeFunction decode;
+    };
+
+    /// Registry of the models, ended by a NULL name
+    static ModelEntry const* modelTable();
+
+    /// Conversion kernel of a model of VelodyneModels.h
+    template <class Model>
+    void decodeBlocks(VelodynePolarData const& data, int firstBlock, int blockCount,
+                      VelodyneRangeImage& image);
+
+    ModelEntry const* mModel;
+    VelodyneCalibration mCalibration;
+    int mColumnCount;
+    Crop mCrop;
+    CropStatistics mCropStatistics;
+
+    /// cos/sin, column and azimuth filter of each firing of the current blocks
+    std::vector<float> mFiringCos, mFiringSin;
+    std::vector<int> mFiringColumn;
+    std::vector<unsigned char> mFiringInAzimuth;
+    /// one laser row of the current blocks, before the kept returns are written
+    std::vector<float> mRowRange, mRowX, mRowY, mRowZ;
+    std::vector<unsigned char> mRowKeep;
+};
+
+} // namespace pacpus
+
+#endif // VELODYNECONVERTER_H
@@ -0,0 +1,100 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Packet layout and nominal elevations of the Velodyne models.
+///
+/// Each model is a traits class given to the conversion kernel as a template
+/// parameter (VelodyneConverter::decodeBlocks), so that its laser count and
+/// block layout are constants of the loops:
+///
+/// - kLasersPerFiring: channels of one firing in a block,
+/// - kFiringsPerBlock: firings stored one after the other in a block, the
+///   later ones at an azimuth interpolated towards the next block,
+/// - kBlocksPerFiring: consecutive blocks sharing one azimuth, each with its
+///   own group of lasers.
+///
+/// The elevations are the nominal ones of the data sheets, in the laser
+/// order of the raw block. They are used when no calibration file is given.
+
+#ifndef VELODYNEMODELS_H
+#define VELODYNEMODELS_H
+
+namespace pacpus
+{
+
+/// HDL-32E: 32 lasers fired together, one firing per block
+struct Hdl32Model
+{
+    static const int kLasersPerFiring = 32;
+    static const int kFiringsPerBlock = 1;
+    static const int kBlocksPerFiring = 1;
+    static const int kLaserCount = kLasersPerFiring * kBlocksPerFiring;
+
+    static char const* name() { return "hdl32"; }
+
+    /// [deg] the linear ramp the viewer always assumed, lowest laser first
+    static double const* verticalAngles()
+    {
+        static const double kAngles[kLaserCount] = {
+            -31.89, -30.56, -29.23, -27.90, -26.57, -25.24, -23.91, -22.58,
+            -21.25, -19.92, -18.59, -17.26, -15.93, -14.60, -13.27, -11.94,
+            -10.61,  -9.28,  -7.95,  -6.62,  -5.29,  -3.96,  -2.63,  -1.30,
+              0.03,   1.36,   2.69,   4.02,   5.35,   6.68,   8.01,   9.34
+        };
+        return kAngles;
+    }
+};
+
+/// VLP-16: 16 lasers, two firings per block
+struct Vlp16Model
+{
+    static const int kLasersPerFiring = 16;
+    static const int kFiringsPerBlock = 2;
+    static const int kBlocksPerFiring = 1;
+    static const int kLaserCount = kLasersPerFiring * kBlocksPerFiring;
+
+    static char const* name() { return "vlp16"; }
+
+    /// [deg] interleaved firing order of the data sheet
+    static double const* verticalAngles()
+    {
+        static const double kAngles[kLaserCount] = {
+            -15, 1, -13, 3, -11, 5, -9, 7, -7, 9, -5, 11, -3, 13, -1, 15
+        };
+        return kAngles;
+    }
+};
+
+/// HDL-64E: upper and lower groups of 32 lasers in two blocks at one azimuth,
+/// the upper block first
+struct Hdl64Model
+{
+    static const int kLasersPerFiring = 32;
+    static const int kFiringsPerBlock = 1;
+    static const int kBlocksPerFiring = 2;
+    static const int kLaserCount = kLasersPerFiring * kBlocksPerFiring;
+
+    static char const* name() { return "hdl64"; }
+
+    /// [deg] upper lasers every 1/3 degree, lower ones every 1/2 degree
+    static double const* verticalAngles()
+    {
+        static const double kAngles[kLaserCount] = {
+              2.00,   1.67,   1.33,   1.00,   0.67,   0.33,   0.00,  -0.33,
+             -0.67,  -1.00,  -1.33,  -1.67,  -2.00,  -2.33,  -2.67,  -3.00,
+             -3.33,  -3.67,  -4.00,  -4.33,  -4.67,  -5.00,  -5.33,  -5.67,
+             -6.00,  -6.33,  -6.67,  -7.00,  -7.33,  -7.67,  -8.00,  -8.33,
+             -8.83,  -9.33,  -9.83, -10.33, -10.83, -11.33, -11.83, -12.33,
+            -12.83, -13.33, -13.83, -14.33, -14.83, -15.33, -15.83, -16.33,
+            -16.83, -17.33, -17.83, -18.33, -18.83, -19.33, -19.83, -20.33,
+            -20.83, -21.33, -21.83, -22.33, -22.83, -23.33, -23.83, -24.33
+        };
+        return kAngles;
+    }
+};
+
+} // namespace pacpus
+
+#endif // VELODYNEMODELS_H
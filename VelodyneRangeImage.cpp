@@ -0,0 +1,88 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "VelodyneRangeImage.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace pacpus;
+using namespace std;
+
+static const float kTwoPi = 6.28318531f;
+
+VelodyneRangeImage::VelodyneRangeImage()
+    : mRows(0)
+    , mCols(0)
+{
+}
+
+void VelodyneRangeImage::resize(int rows, int cols)
+{
+    mRows = rows;
+    mCols = cols;
+
+    size_t const n = static_cast<size_t>(rows) * cols;
+    mRange.resize(n);
+    mX.resize(n);
+    mY.resize(n);
+    mZ.resize(n);
+    mIntensity.resize(n);
+    mValid.assign(n, 0);
+    mRowAngle.resize(rows, 0.0f);
+}
+
+void VelodyneRangeImage::clear()
+{
+    if (!mValid.empty()) {
+        memset(&mValid[0], 0, mValid.size());
+    }
+}
+
+float VelodyneRangeImage::azimuth(int col) const
+{
+    return (col + 0.5f) * kTwoPi / mCols;
+}
+
+int VelodyneRangeImage::validCount() const
+{
+    return static_cast<int>(mValid.size() - count(mValid.begin(), mValid.end(), 0));
+}
+
+int VelodyneRangeImage::toScan(LidarScan& scan) const
+{
+    int reallocations = 0;
+    scan.layers.resize(mRows);
+    for (int row = 0; row < mRows; ++row) {
+        LidarLayer& layer = scan.layers[row];
+        layer.id = row;
+        layer.angle = mRowAngle[row];
+
+        float const* x = xRow(row);
+        float const* y = yRow(row);
+        float const* z = zRow(row);
+        float const* intensity = intensityRow(row);
+        unsigned char const* valid = validRow(row);
+
+        size_t const pointCount = count(valid, valid + mCols, 1);
+        if (layer.points.capacity() < pointCount) {
+            ++reallocations;
+        }
+        layer.points.clear();
+        layer.points.reserve(pointCount);
+        for (int col = 0; col < mCols; ++col) {
+            if (!valid[col]) {
+                continue;
+            }
+            LidarPoint point;
+            point.x = x[col];
+            point.y = y[col];
+            point.z = z[col];
+            point.intensity = intensity[col];
+            layer.points.push_back(point);
+        }
+    }
+    return reallocations;
+}
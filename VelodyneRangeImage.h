@@ -0,0 +1,108 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Organized range image of one Velodyne revolution.
+///
+/// Structure of arrays: one float plane per channel (range, x, y, z,
+/// intensity) and a validity mask. Rows are lasers, columns are azimuth bins,
+/// planes are stored row by row, so the neighbours of a cell are at fixed
+/// offsets and a row scan is a linear memory scan. Columns wrap around.
+
+#ifndef VELODYNERANGEIMAGE_H
+#define VELODYNERANGEIMAGE_H
+
+#include <structure/GenericLidar.h>
+
+#include <vector>
+
+namespace pacpus
+{
+
+class VelodyneRangeImage
+{
+public:
+    VelodyneRangeImage();
+
+    /// Allocates the planes, all cells are invalid afterwards.
+    void resize(int rows, int cols);
+    /// Invalidates all cells, keeps the storage.
+    void clear();
+
+    int rows() const { return mRows; }
+    int cols() const { return mCols; }
+    int size() const { return mRows * mCols; }
+
+    int index(int row, int col) const
+    {
+        return row * mCols + col;
+    }
+    /// Column of a raw azimuth given in 1/100 degree.
+    int columnOf(unsigned int angle) const
+    {
+        return static_cast<int>(static_cast<unsigned long long>(angle % 36000) * mCols / 36000);
+    }
+    /// Azimuth of the column centre [rad].
+    float azimuth(int col) const;
+
+    int nextColumn(int col) const
+    {
+        return (col + 1 == mCols) ? 0 : col + 1;
+    }
+    int previousColumn(int col) const
+    {
+        return (col == 0) ? mCols - 1 : col - 1;
+    }
+
+    /// Elevation angle of a row [rad].
+    float rowAngle(int row) const { return mRowAngle[row]; }
+    void setRowAngle(int row, float angle) { mRowAngle[row] = angle; }
+
+    bool isValid(int row, int col) const
+    {
+        return mValid[index(row, col)] != 0;
+    }
+    int validCount() const;
+
+    // whole planes
+    float* range() { return &mRange[0]; }
+    float* x() { return &mX[0]; }
+    float* y() { return &mY[0]; }
+    float* z() { return &mZ[0]; }
+    float* intensity() { return &mIntensity[0]; }
+    unsigned char* valid() { return &mValid[0]; }
+    float const* range() const { return &mRange[0]; }
+    float const* x() const { return &mX[0]; }
+    float const* y() const { return &mY[0]; }
+    float const* z() const { return &mZ[0]; }
+    float const* intensity() const { return &mIntensity[0]; }
+    unsigned char const* valid() const { return &mValid[0]; }
+
+    // rows of the planes
+    float const* rangeRow(int row) const { return &mRange[index(row, 0)]; }
+    float const* xRow(int row) const { return &mX[index(row, 0)]; }
+    float const* yRow(int row) const { return &mY[index(row, 0)]; }
+    float const* zRow(int row) const { return &mZ[index(row, 0)]; }
+    float const* intensityRow(int row) const { return &mIntensity[index(row, 0)]; }
+    unsigned char const* validRow(int row) const { return &mValid[index(row, 0)]; }
+
+    /// Fills a scan with the valid cells, one layer per row.
+    /// Layer vectors are cleared and reserved to their exact size, so a
+    /// recycled scan keeps its storage.
+    /// @returns the number of layer vectors that had to grow
+    int toScan(LidarScan& scan) const;
+
+private:
+    int mRows, mCols;
+
+    std::vector<float> mRange;
+    std::vector<float> mX, mY, mZ;
+    std::vector<float> mIntensity;
+    std::vector<unsigned char> mValid;
+    std::vector<float> mRowAngle;
+};
+
+} // namespace pacpus
+
+#endif // VELODYNERANGEIMAGE_H
@@ -0,0 +1,480 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+
+#include "VelodyneSweepCodec.h"
+
+#include <algorithm>
+#include <boost/scoped_ptr.hpp>
+#include <cstring>
+
+using namespace pacpus;
+using namespace std;
+using boost::int32_t;
+using boost::uint32_t;
+using boost::uint64_t;
+
+/// "VSC2", little-endian
+static const uint32_t kMagic = 0x32435356;
+
+/// Residual streams of a revolution, each with its own models
+enum Section
+{
+    kAzimuthSection,
+    kDistanceSection,
+    kIntensitySection,
+    kSectionCount
+};
+
+static const int kMaxBitLength = 32;
+/// Bit lengths are coded with a binary tree of this depth
+static const int kLengthTreeDepth = 6;
+/// Contexts of a bit length: the mean length of its neighbours, clamped
+static const int kLengthContexts = 16;
+/// Bits below the leading one coded with a model, the others are raw
+static const int kModelledBits = 2;
+
+// Binary range coder with adaptive probabilities, as in LZMA
+static const int kProbabilityBits = 11;
+static const int kAdaptationShift = 5;
+static const uint32_t kTopValue = 1u << 24;
+static const boost::uint16_t kInitialProbability = 1 << (kProbabilityBits - 1);
+
+static int blockCapacity()
+{
+    return sizeof(VelodynePolarData().polarData) / sizeof(VelodynePolarData().polarData[0]);
+}
+
+static int rawLaserCount()
+{
+    return sizeof(VelodynePolarData().polarData[0].rawPoints) / sizeof(VelodynePolarData().polarData[0].rawPoints[0]);
+}
+
+static uint32_t zigZag(int32_t value)
+{
+    return (value < 0) ? ~(static_cast<uint32_t>(value) << 1) : (static_cast<uint32_t>(value) << 1);
+}
+
+static int32_t unZigZag(uint32_t value)
+{
+    return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+static int bitLength(uint32_t value)
+{
+    int length = 0;
+    while (value) {
+        ++length;
+        value >>= 1;
+    }
+    return length;
+}
+
+static void putUInt32(vector<unsigned char>& buffer, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        buffer.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+}
+
+static bool getUInt32(unsigned char const*& in, unsigned char const* end, uint32_t& value)
+{
+    if (end - in < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(*in++) << (8 * i);
+    }
+    return true;
+}
+
+namespace
+{
+
+/// Adaptive probabilities of one revolution. Every revolution starts from
+/// flat models, so that it decodes on its own.
+struct Models
+{
+    Models()
+    {
+        fill(&length[0][0][0], &length[0][0][0] + sizeof(length) / sizeof(length[0][0][0]), kInitialProbability);
+        fill(&mantissa[0][0][0], &mantissa[0][0][0] + sizeof(mantissa) / sizeof(mantissa[0][0][0]),
+             kInitialProbability);
+    }
+
+    boost::uint16_t length[kSectionCount][kLengthContexts][1 << kLengthTreeDepth];
+    boost::uint16_t mantissa[kSectionCount][kMaxBitLength + 1][1 << kModelledBits];
+};
+
+/// Context of the bit length of values[k]: the mean length of the previous
+/// value of the same sequence and of the value `stride` before it
+int lengthContext(uint32_t const* values, size_t k, size_t first, size_t stride)
+{
+    if (k == first) {
+        return 0;
+    }
+    bool const newSequence = (stride > 0) && ((k - first) % stride == 0);
+    int const previous = newSequence ? 0 : bitLength(values[k - 1]);
+    int const neighbour = ((stride > 0) && (k - first >= stride)) ? bitLength(values[k - stride]) : previous;
+    int const context = (previous + neighbour + 1) / 2;
+    return (context < kLengthContexts) ? context : (kLengthContexts - 1);
+}
+
+class RangeEncoder
+{
+public:
+    explicit RangeEncoder(vector<unsigned char>& buffer)
+        : mBuffer(buffer)
+        , mLow(0)
+        , mRange(0xFFFFFFFFu)
+        , mCache(0)
+        , mCacheSize(1)
+    {
+    }
+
+    void encodeBit(boost::uint16_t& probability, int bit)
+    {
+        uint32_t const bound = (mRange >> kProbabilityBits) * probability;
+        if (bit == 0) {
+            mRange = bound;
+            probability += ((1 << kProbabilityBits) - probability) >> kAdaptationShift;
+        } else {
+            mLow += bound;
+            mRange -= bound;
+            probability -= probability >> kAdaptationShift;
+        }
+        normalize();
+    }
+
+    void encodeDirectBits(uint32_t value, int count)
+    {
+        while (count-- > 0) {
+            mRange >>= 1;
+            if ((value >> count) & 1) {
+                mLow += mRange;
+            }
+            normalize();
+        }
+    }
+
+    /// Encodes the `depth` low bits of value, most significant first
+    void encodeTree(boost::uint16_t* probabilities, int depth, uint32_t value)
+    {
+        uint32_t node = 1;
+        while (depth-- > 0) {
+            int const bit = (value >> depth) & 1;
+            encodeBit(probabilities[node], bit);
+            node = (node << 1) | bit;
+        }
+    }
+
+    void flush()
+    {
+        for (int i = 0; i < 5; ++i) {
+            shiftLow();
+        }
+    }
+
+private:
+    void normalize()
+    {
+        while (mRange < kTopValue) {
+            mRange <<= 8;
+            shiftLow();
+        }
+    }
+
+    void shiftLow()
+    {
+        if ((static_cast<uint32_t>(mLow) < 0xFF000000u) || ((mLow >> 32) != 0)) {
+            unsigned char const carry = static_cast<unsigned char>(mLow >> 32);
+            unsigned char pending = mCache;
+            do {
+                mBuffer.push_back(static_cast<unsigned char>(pending + carry));
+                pending = 0xFF;
+            } while (--mCacheSize != 0);
+            mCache = static_cast<unsigned char>(mLow >> 24);
+        }
+        ++mCacheSize;
+        mLow = (mLow & 0x00FFFFFFu) << 8;
+    }
+
+    vector<unsigned char>& mBuffer;
+    uint64_t mLow;
+    uint32_t mRange;
+    unsigned char mCache;
+    uint64_t mCacheSize;
+};
+
+class RangeDecoder
+{
+public:
+    RangeDecoder(unsigned char const* in, unsigned char const* end)
+        : mIn(in)
+        , mEnd(end)
+        , mRange(0xFFFFFFFFu)
+        , mCode(0)
+        , mOverrun(false)
+    {
+        for (int i = 0; i < 5; ++i) {
+            mCode = (mCode << 8) | nextByte();
+        }
+    }
+
+    int decodeBit(boost::uint16_t& probability)
+    {
+        uint32_t const bound = (mRange >> kProbabilityBits) * probability;
+        int bit;
+        if (mCode < bound) {
+            mRange = bound;
+            probability += ((1 << kProbabilityBits) - probability) >> kAdaptationShift;
+            bit = 0;
+        } else {
+            mCode -= bound;
+            mRange -= bound;
+            probability -= probability >> kAdaptationShift;
+            bit = 1;
+        }
+        normalize();
+        return bit;
+    }
+
+    uint32_t decodeDirectBits(int count)
+    {
+        uint32_t value = 0;
+        while (count-- > 0) {
+            mRange >>= 1;
+            uint32_t const bit = (mCode >= mRange) ? 1 : 0;
+            mCode -= mRange & (0u - bit);
+            value = (value << 1) | bit;
+            normalize();
+        }
+        return value;
+    }
+
+    uint32_t decodeTree(boost::uint16_t* probabilities, int depth)
+    {
+        uint32_t node = 1;
+        for (int i = 0; i < depth; ++i) {
+            node = (node << 1) | decodeBit(probabilities[node]);
+        }
+        return node - (1u << depth);
+    }
+
+    /// true if the input ended before the values did
+    bool overrun() const { return mOverrun; }
+    unsigned char const* position() const { return mIn; }
+
+private:
+    void normalize()
+    {
+        while (mRange < kTopValue) {
+            mRange <<= 8;
+            mCode = (mCode << 8) | nextByte();
+        }
+    }
+
+    uint32_t nextByte()
+    {
+        if (mIn == mEnd) {
+            mOverrun = true;
+            return 0;
+        }
+        return *mIn++;
+    }
+
+    unsigned char const* mIn;
+    unsigned char const* mEnd;
+    uint32_t mRange;
+    uint32_t mCode;
+    bool mOverrun;
+};
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////////
+VelodyneSweepCodec::VelodyneSweepCodec()
+{
+}
+
+void VelodyneSweepCodec::encode(VelodynePolarData const& data, vector<unsigned char>& buffer)
+{
+    int const laserCount = rawLaserCount();
+    int const blockCount = min(static_cast<int>(data.range), blockCapacity());
+
+    putUInt32(buffer, kMagic);
+    putUInt32(buffer, static_cast<uint32_t>(data.range));
+    buffer.push_back(static_cast<unsigned char>(laserCount));
+
+    mValues.clear();
+    mValues.reserve(blockCount * (1 + 2 * laserCount));
+
+    // azimuth: residual to the previous increment
+    int32_t previousAngle = 0, previousIncrement = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        int32_t const angle = data.polarData[i].angle;
+        int32_t const increment = angle - previousAngle;
+        mValues.push_back(zigZag(increment - previousIncrement));
+        previousAngle = angle;
+        previousIncrement = increment;
+    }
+
+    // distances then intensities, laser by laser along azimuth. Missing
+    // returns get their own symbol and do not reset the prediction.
+    for (int j = 0; j < laserCount; ++j) {
+        int32_t previous = 0;
+        for (int i = 0; i < blockCount; ++i) {
+            int32_t const distance = data.polarData[i].rawPoints[j].distance;
+            if (distance == 0) {
+                mValues.push_back(0);
+            } else {
+                mValues.push_back(zigZag(distance - previous) + 1);
+                previous = distance;
+            }
+        }
+    }
+    for (int j = 0; j < laserCount; ++j) {
+        int32_t previous = 0;
+        for (int i = 0; i < blockCount; ++i) {
+            int32_t const intensity = data.polarData[i].rawPoints[j].intensity;
+            if (data.polarData[i].rawPoints[j].distance == 0) {
+                mValues.push_back(zigZag(intensity));
+            } else {
+                mValues.push_back(zigZag(intensity - previous));
+                previous = intensity;
+            }
+        }
+    }
+
+    encodeValues(blockCount, buffer);
+}
+
+bool VelodyneSweepCodec::decode(unsigned char const* encoded, size_t size, VelodynePolarData& data,
+                                size_t* consumed)
+{
+    unsigned char const* in = encoded;
+    unsigned char const* const end = encoded + size;
+
+    uint32_t magic, range;
+    if (!getUInt32(in, end, magic) || (magic != kMagic) || !getUInt32(in, end, range) || (in == end)) {
+        return false;
+    }
+    int const laserCount = *in++;
+    if (laserCount != rawLaserCount()) {
+        return false;
+    }
+    int const blockCount = min(static_cast<int>(range), blockCapacity());
+    if (!decodeValues(blockCount, in, end)) {
+        return false;
+    }
+
+    memset(&data, 0, sizeof(data));
+    data.range = range;
+
+    vector<uint32_t>::const_iterator value = mValues.begin();
+    int32_t previousAngle = 0, previousIncrement = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        previousIncrement += unZigZag(*value++);
+        previousAngle += previousIncrement;
+        data.polarData[i].angle = static_cast<unsigned short>(previousAngle);
+    }
+    for (int j = 0; j < laserCount; ++j) {
+        int32_t previous = 0;
+        for (int i = 0; i < blockCount; ++i) {
+            uint32_t const symbol = *value++;
+            if (symbol != 0) {
+                previous += unZigZag(symbol - 1);
+                data.polarData[i].rawPoints[j].distance = static_cast<unsigned short>(previous);
+            }
+        }
+    }
+    for (int j = 0; j < laserCount; ++j) {
+        int32_t previous = 0;
+        for (int i = 0; i < blockCount; ++i) {
+            if (data.polarData[i].rawPoints[j].distance == 0) {
+                data.polarData[i].rawPoints[j].intensity = static_cast<unsigned char>(unZigZag(*value++));
+            } else {
+                previous += unZigZag(*value++);
+                data.polarData[i].rawPoints[j].intensity = static_cast<unsigned char>(previous);
+            }
+        }
+    }
+
+    if (consumed) {
+        *consumed = static_cast<size_t>(in - encoded);
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Each value: its bit length n (tree coded), then below the leading one its
+// kModelledBits high bits (tree coded in the context of n) and its n - 1 -
+// kModelledBits low bits (direct).
+void VelodyneSweepCodec::encodeValues(int blockCount, vector<unsigned char>& buffer)
+{
+    boost::scoped_ptr<Models> models(new Models);
+    RangeEncoder encoder(buffer);
+    size_t const blocks = static_cast<size_t>(blockCount);
+    size_t const laserValues = blocks * rawLaserCount();
+    size_t const sectionEnd[kSectionCount] = { blocks, blocks + laserValues, blocks + 2 * laserValues };
+    size_t const stride[kSectionCount] = { 0, blocks, blocks };
+    uint32_t const* const values = mValues.empty() ? NULL : &mValues[0];
+
+    size_t k = 0;
+    for (int section = 0; section < kSectionCount; ++section) {
+        size_t const first = k;
+        for (; k < sectionEnd[section]; ++k) {
+            uint32_t const value = values[k];
+            int const length = bitLength(value);
+            int const context = lengthContext(values, k, first, stride[section]);
+            encoder.encodeTree(models->length[section][context], kLengthTreeDepth, length);
+            if (length > 1) {
+                int const modelled = (length - 1 < kModelledBits) ? (length - 1) : kModelledBits;
+                int const raw = length - 1 - modelled;
+                uint32_t const mantissa = value & ((1u << (length - 1)) - 1);
+                encoder.encodeTree(models->mantissa[section][length], modelled, mantissa >> raw);
+                encoder.encodeDirectBits(mantissa, raw);
+            }
+        }
+    }
+    encoder.flush();
+}
+
+bool VelodyneSweepCodec::decodeValues(int blockCount, unsigned char const*& in, unsigned char const* end)
+{
+    boost::scoped_ptr<Models> models(new Models);
+    RangeDecoder decoder(in, end);
+    size_t const blocks = static_cast<size_t>(blockCount);
+    size_t const laserValues = blocks * rawLaserCount();
+    size_t const sectionEnd[kSectionCount] = { blocks, blocks + laserValues, blocks + 2 * laserValues };
+    size_t const stride[kSectionCount] = { 0, blocks, blocks };
+    mValues.resize(sectionEnd[kSectionCount - 1]);
+    uint32_t* const values = mValues.empty() ? NULL : &mValues[0];
+
+    size_t k = 0;
+    for (int section = 0; section < kSectionCount; ++section) {
+        size_t const first = k;
+        for (; k < sectionEnd[section]; ++k) {
+            int const context = lengthContext(values, k, first, stride[section]);
+            int const length = decoder.decodeTree(models->length[section][context], kLengthTreeDepth);
+            if (length > kMaxBitLength) {
+                return false;
+            }
+            uint32_t value = (length > 0) ? 1 : 0;
+            if (length > 1) {
+                int const modelled = (length - 1 < kModelledBits) ? (length - 1) : kModelledBits;
+                int const raw = length - 1 - modelled;
+                value = (value << modelled) | decoder.decodeTree(models->mantissa[section][length], modelled);
+                value = (value << raw) | decoder.decodeDirectBits(raw);
+            }
+            values[k] = value;
+        }
+        if (decoder.overrun()) {
+            return false;
+        }
+    }
+    in = decoder.position();
+    return true;
+}
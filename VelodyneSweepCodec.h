@@ -0,0 +1,66 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Lossless compression of raw Velodyne revolutions for archiving.
+///
+/// Every field read from a VelodynePolarData (block count, block azimuths,
+/// distances and intensities of the valid blocks) is turned into small
+/// residuals:
+///  - azimuths are predicted from the previous increment, so a constant
+///    rotation speed leaves zeros,
+///  - distances and intensities are delta coded along azimuth, laser by
+///    laser, where the surfaces are continuous.
+///
+/// Residuals are zig-zag mapped and range coded with adaptive binary models:
+/// the bit length of each value is coded in the context of the lengths of
+/// its neighbours, the previous value of the same laser and the value of the
+/// previous laser in the same block, then its two bits below the leading one
+/// in the context of that length, and the remaining low bits as they are.
+///
+/// Decoding restores these fields bit-exactly. The unused blocks after
+/// `range` are not stored and decode as zeros.
+///
+/// The compression ratio that counts is the one against these fields packed
+/// (2 bytes of azimuth and 3 bytes per return): 2.32 on a synthetic street
+/// scene, short of the 3x target. It is yet to be measured on a recorded
+/// drive with tools/VelodyneCodecCheck.
+
+#ifndef VELODYNESWEEPCODEC_H
+#define VELODYNESWEEPCODEC_H
+
+#include "structure/structure_velodyne.h"
+
+#include <boost/cstdint.hpp>
+#include <cstddef>
+#include <vector>
+
+namespace pacpus
+{
+
+class VelodyneSweepCodec
+{
+public:
+    VelodyneSweepCodec();
+
+    /// Appends one encoded revolution to the buffer.
+    void encode(VelodynePolarData const& data, std::vector<unsigned char>& buffer);
+
+    /// Decodes one revolution.
+    /// @param consumed if not NULL, receives the encoded size
+    /// @returns false on truncated or corrupted input
+    bool decode(unsigned char const* encoded, std::size_t size, VelodynePolarData& data,
+                std::size_t* consumed = NULL);
+
+private:
+    void encodeValues(int blockCount, std::vector<unsigned char>& buffer);
+    bool decodeValues(int blockCount, unsigned char const*& in, unsigned char const* end);
+
+    /// residuals of the current revolution, in stream order
+    std::vector<boost::uint32_t> mValues;
+};
+
+} // namespace pacpus
+
+#endif // VELODYNESWEEPCODEC_H
@@ -0,0 +1,116 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Times the conversion of each Velodyne model on its own.
+///
+/// Usage:
+///     DecoderBenchmark [model] [revolutions]
+///
+/// Converts a synthetic 10 Hz revolution of the model, or of every model of
+/// VelodyneConverter::models() when none is given, with the nominal
+/// elevations and the default crop. Prints the time per revolution and the
+/// returns converted per second.
+
+#include "../VelodyneConverter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <QElapsedTimer>
+
+using namespace pacpus;
+using namespace std;
+
+static const int kDefaultRevolutions = 200;
+
+static int usage()
+{
+    fprintf(stderr, "usage: DecoderBenchmark [model] [revolutions]\n");
+    return 2;
+}
+
+/// [1/100 deg] azimuth between two blocks of a 10 Hz revolution
+static unsigned int blockStep(string const& model)
+{
+    if (model == "vlp16") {
+        return 40;
+    }
+    if (model == "hdl64") {
+        return 17;
+    }
+    return 16;
+}
+
+/// Fills a revolution with returns between 2 and 60 m, the blocks of a
+/// multi-block firing sharing their azimuth
+static void makeRevolution(VelodyneConverter const& converter, VelodynePolarData& data)
+{
+    int const capacity = sizeof(data.polarData) / sizeof(data.polarData[0]);
+    int const channelCount = sizeof(data.polarData[0].rawPoints) / sizeof(data.polarData[0].rawPoints[0]);
+    int const blocksPerFiring = (converter.model() == "hdl64") ? 2 : 1;
+    unsigned int const step = blockStep(converter.model());
+    int const blockCount = min<int>(capacity, VelodyneCalibration::kAzimuthSteps / step * blocksPerFiring);
+
+    unsigned int seed = 12345;
+    for (int i = 0; i < blockCount; ++i) {
+        data.polarData[i].angle = static_cast<unsigned short>(i / blocksPerFiring * step);
+        for (int j = 0; j < channelCount; ++j) {
+            seed = seed * 1103515245 + 12345;
+            data.polarData[i].rawPoints[j].distance = static_cast<unsigned short>(1000 + (seed >> 16) % 29000);
+            data.polarData[i].rawPoints[j].intensity = static_cast<unsigned char>(seed >> 8);
+        }
+    }
+    data.range = blockCount;
+}
+
+static bool run(string const& model, int revolutions)
+{
+    VelodyneConverter converter;
+    if (!converter.setModel(model)) {
+        fprintf(stderr, "unknown model '%s'\n", model.c_str());
+        return false;
+    }
+    converter.setDefaultCalibration();
+
+    // too large for the stack
+    vector<VelodynePolarData> data(1);
+    makeRevolution(converter, data[0]);
+    VelodyneRangeImage image;
+    converter.convert(data[0], image);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int r = 0; r < revolutions; ++r) {
+        converter.convert(data[0], image);
+    }
+    double const seconds = timer.nsecsElapsed() * 1e-9;
+    unsigned long long const returns = converter.cropStatistics().kept / (revolutions + 1);
+    printf("%-6s lasers=%2d blocks=%4lu returns=%6llu %7.3f ms/revolution %7.2f Mreturns/s\n",
+           model.c_str(), converter.laserCount(), static_cast<unsigned long>(data[0].range), returns,
+           1e3 * seconds / revolutions, returns * revolutions / seconds * 1e-6);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    int const revolutions = (argc > 2) ? atoi(argv[2]) : kDefaultRevolutions;
+    if (revolutions <= 0) {
+        return usage();
+    }
+    vector<string> models;
+    if (argc > 1) {
+        models.push_back(argv[1]);
+    } else {
+        models = VelodyneConverter::models();
+    }
+    for (size_t i = 0; i < models.size(); ++i) {
+        if (!run(models[i], revolutions)) {
+            return usage();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Checks the consistency of the sweeps read from a SweepRing.
+///
+/// Usage:
+///     SweepRingCheck read <key> [seconds]
+///     SweepRingCheck write <key> [seconds] [rate]
+///
+/// `read` polls the newest sweep of a ring, LidarViewer's (shm-name) or one
+/// written by `write`, and checks every sweep in place: the checksum of the
+/// points and the layer table must match whenever the slot validates. It
+/// exits with 1 on an inconsistent read. `write` publishes synthetic sweeps
+/// of varying size, at 20 Hz by default.
+
+#include "../SweepRing.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <QElapsedTimer>
+#include <QString>
+#include <QThread>
+
+using namespace pacpus;
+
+static const int kSlotCount = 4;
+static const int kLayerCount = 32;
+static const int kMaxPointsPerLayer = 2160;
+
+static int usage()
+{
+    fprintf(stderr, "usage: SweepRingCheck read <key> [seconds]\n"
+                    "       SweepRingCheck write <key> [seconds] [rate]\n");
+    return 2;
+}
+
+static void makeSweep(int generation, LidarScan& scan)
+{
+    scan.layers.resize(kLayerCount);
+    for (int i = 0; i < kLayerCount; ++i) {
+        LidarLayer& layer = scan.layers[i];
+        layer.id = i;
+        layer.points.resize(kMaxPointsPerLayer / 2 + (generation * 7919 + i * 104729) % (kMaxPointsPerLayer / 2));
+        for (size_t j = 0; j < layer.points.size(); ++j) {
+            LidarPoint& point = layer.points[j];
+            point.x = static_cast<float>(generation);
+            point.y = static_cast<float>(i);
+            point.z = static_cast<float>(j);
+            point.intensity = static_cast<float>((generation + j) % 256);
+        }
+    }
+}
+
+static int write(QString const& key, int seconds, double rate)
+{
+    SweepRingWriter writer;
+    if (!writer.create(key, kSlotCount, kLayerCount * kMaxPointsPerLayer)) {
+        return 1;
+    }
+    LidarScan scan(kLayerCount);
+    qint64 const period = static_cast<qint64>(1e9 / rate);
+    QElapsedTimer timer;
+    timer.start();
+    for (int generation = 1; timer.elapsed() < seconds * 1000; ++generation) {
+        makeSweep(generation, scan);
+        writer.write(scan);
+        qint64 const wait = generation * period - timer.nsecsElapsed();
+        if (wait > 0) {
+            QThread::usleep(static_cast<unsigned long>(wait / 1000));
+        }
+    }
+    printf("written=%lu\n", writer.statistics().written);
+    return 0;
+}
+
+/// Reads the whole sweep in place, as a consumer would
+static bool consistent(SweepRingReader::Snapshot const& snapshot)
+{
+    boost::uint32_t previousEnd = 0;
+    for (boost::uint32_t i = 0; i < snapshot.layerCount; ++i) {
+        if ((snapshot.layerEnd[i] < previousEnd) || (snapshot.layerEnd[i] > snapshot.pointCount)) {
+            return false;
+        }
+        previousEnd = snapshot.layerEnd[i];
+    }
+    return (previousEnd == snapshot.pointCount)
+        && (sweepRingChecksum(snapshot.points, snapshot.pointCount) == snapshot.checksum);
+}
+
+static int read(QString const& key, int seconds)
+{
+    SweepRingReader reader;
+    if (!reader.attach(key)) {
+        fprintf(stderr, "no sweep ring '%s'\n", qPrintable(key));
+        return 1;
+    }
+    unsigned long checked = 0, overwritten = 0, missed = 0, inconsistent = 0;
+    int lastGeneration = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < seconds * 1000) {
+        SweepRingReader::Snapshot snapshot;
+        if (!reader.acquire(snapshot) || (snapshot.generation == lastGeneration)) {
+            QThread::msleep(1);
+            continue;
+        }
+        bool const ok = consistent(snapshot);
+        if (!reader.validate(snapshot)) {
+            // the writer reused the slot meanwhile, what was read is meaningless
+            ++overwritten;
+            continue;
+        }
+        if (!ok) {
+            ++inconsistent;
+            fprintf(stderr, "inconsistent sweep %d\n", snapshot.generation);
+        }
+        if ((lastGeneration != 0) && (snapshot.generation > lastGeneration + 1)) {
+            missed += snapshot.generation - lastGeneration - 1;
+        }
+        lastGeneration = snapshot.generation;
+        ++checked;
+    }
+    printf("checked=%lu overwritten=%lu missed=%lu inconsistent=%lu\n", checked, overwritten, missed, inconsistent);
+    return ((inconsistent > 0) || (checked == 0)) ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        return usage();
+    }
+    QString const mode = argv[1];
+    QString const key = argv[2];
+    int const seconds = (argc > 3) ? atoi(argv[3]) : 10;
+    if (mode == "read") {
+        return read(key, seconds);
+    }
+    if (mode == "write") {
+        double const rate = (argc > 4) ? atof(argv[4]) : 20;
+        if (rate <= 0) {
+            return usage();
+        }
+        return write(key, seconds, rate);
+    }
+    return usage();
+}
@@ -0,0 +1,369 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Converts a recorded Velodyne DBT file into Cartesian sweeps, on all
+/// cores.
+///
+/// Usage:
+///     VelodyneBatchConvert [-m model] [-c calibration.xml] [-b azimuth-bins]
+///                          [-j threads] <input.dbt> <output>
+///
+/// The input is the DBT recording replayed by the velodynedbtply player: a
+/// DbiteFile of VelodynePolarData records, each with its acquisition time.
+/// Each revolution goes through the conversion of the viewer
+/// (VelodyneConverter::convert, then AlignedScan::fromImage) with the
+/// default region of interest.
+///
+/// Three stages overlap, one batch of revolutions apart: a reader thread
+/// reads the next batch of records, the batch is converted with parallelFor,
+/// each worker with its own converter, and a writer thread appends the
+/// previous batch to the output through a large stdio buffer. The sweeps
+/// stay in recording order.
+///
+/// Output, native byte order:
+///  - file header: magic "VSWP", version (uint32),
+///  - per sweep: acquisition time (uint64, road_time_t [us]) and time range
+///    (int32, road_timerange_t [us]) of the record, point count and layer
+///    count (uint32), then per layer its id (int32), elevation [rad]
+///    (float32) and the index following its last point (uint32), then the
+///    x, y and z planes [m] (float32) and the intensity plane (uint8),
+///    13 bytes per point.
+
+#include "../AlignedScan.h"
+#include "../ParallelFor.h"
+#include "../VelodyneConverter.h"
+
+#include <Pacpus/kernel/DbiteFile.h>
+#include <Pacpus/kernel/road_time.h>
+
+#include <boost/cstdint.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <vector>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+
+using namespace pacpus;
+using namespace std;
+
+static const boost::uint32_t kMagic = 0x50575356; // "VSWP"
+static const boost::uint32_t kVersion = 2;
+/// Revolutions per worker in a batch, about 330 KiB of input each
+static const int kRevolutionsPerWorker = 8;
+static const size_t kOutputBufferSize = 16 * 1024 * 1024;
+
+static int usage()
+{
+    fprintf(stderr, "usage: VelodyneBatchConvert [-m model] [-c calibration.xml] [-b azimuth-bins]\n"
+                    "                            [-j threads] <input.dbt> <output>\n");
+    return 2;
+}
+
+/// Records of a batch and their converted sweeps, reused by every other batch.
+/// The reader fills the records while the writer may still write the sweeps.
+struct Batch
+{
+    int recordCount;
+    std::vector<VelodynePolarData> records;
+    std::vector<road_time_t> times;
+    std::vector<road_timerange_t> timeRanges;
+    int sweepCount;
+    std::vector<std::vector<unsigned char> > sweeps;
+};
+
+static void serialize(road_time_t time, road_timerange_t timeRange, AlignedScan const& points,
+                      std::vector<unsigned char>& out)
+{
+    std::vector<AlignedScan::Layer> const& layers = points.layers();
+    boost::uint64_t const sweepTime = time;
+    boost::int32_t const sweepTimeRange = timeRange;
+    boost::uint32_t const pointCount = static_cast<boost::uint32_t>(points.size());
+    boost::uint32_t const layerCount = static_cast<boost::uint32_t>(layers.size());
+    out.resize(sizeof(sweepTime) + sizeof(sweepTimeRange) + 2 * sizeof(boost::uint32_t)
+               + layerCount * 3 * sizeof(boost::uint32_t) + pointCount * (3 * sizeof(float) + 1));
+
+    unsigned char* o = &out[0];
+    memcpy(o, &sweepTime, sizeof(sweepTime));
+    o += sizeof(sweepTime);
+    memcpy(o, &sweepTimeRange, sizeof(sweepTimeRange));
+    o += sizeof(sweepTimeRange);
+    memcpy(o, &pointCount, sizeof(pointCount));
+    o += sizeof(pointCount);
+    memcpy(o, &layerCount, sizeof(layerCount));
+    o += sizeof(layerCount);
+    for (size_t l = 0; l < layers.size(); ++l) {
+        boost::int32_t const id = layers[l].id;
+        float const angle = layers[l].angle;
+        boost::uint32_t const end = static_cast<boost::uint32_t>(layers[l].end);
+        memcpy(o, &id, sizeof(id));
+        memcpy(o + 4, &angle, sizeof(angle));
+        memcpy(o + 8, &end, sizeof(end));
+        o += 12;
+    }
+    size_t const planeBytes = pointCount * sizeof(float);
+    if (pointCount > 0) {
+        memcpy(o, points.x(), planeBytes);
+        memcpy(o + planeBytes, points.y(), planeBytes);
+        memcpy(o + 2 * planeBytes, points.z(), planeBytes);
+    }
+    o += 3 * planeBytes;
+    float const* intensity = points.intensity();
+    for (boost::uint32_t i = 0; i < pointCount; ++i) {
+        o[i] = static_cast<unsigned char>(intensity[i]);
+    }
+}
+
+/// Converts the revolutions [first, last) of a batch
+class ConvertTask
+{
+public:
+    ConvertTask(VelodyneConverter const& converter, int workerCount)
+        : mConverters(workerCount, converter)
+        , mImages(workerCount)
+        , mPoints(workerCount)
+        , mBatch(NULL)
+    {
+    }
+
+    void setBatch(Batch* batch) { mBatch = batch; }
+
+    void operator()(int first, int last, int worker)
+    {
+        for (int i = first; i < last; ++i) {
+            mConverters[worker].convert(mBatch->records[i], mImages[worker]);
+            mPoints[worker].fromImage(mImages[worker]);
+            serialize(mBatch->times[i], mBatch->timeRanges[i], mPoints[worker], mBatch->sweeps[i]);
+        }
+    }
+
+    unsigned long long kept() const
+    {
+        unsigned long long kept = 0;
+        for (size_t w = 0; w < mConverters.size(); ++w) {
+            kept += mConverters[w].cropStatistics().kept;
+        }
+        return kept;
+    }
+
+private:
+    std::vector<VelodyneConverter> mConverters;
+    std::vector<VelodyneRangeImage> mImages;
+    std::vector<AlignedScan> mPoints;
+    Batch* mBatch;
+};
+
+/// Reads the next records of the recording into a batch
+class ReadThread
+    : public QThread
+{
+public:
+    explicit ReadThread(DbiteFile& file)
+        : mFile(file)
+        , mBatch(NULL)
+        , mFailed(false)
+    {
+    }
+
+    void setBatch(Batch* batch) { mBatch = batch; }
+    bool failed() const { return mFailed; }
+    std::string const& error() const { return mError; }
+
+protected:
+    void run() /* override */
+    {
+        mBatch->recordCount = 0;
+        try {
+            int const capacity = static_cast<int>(mBatch->records.size());
+            for (int& i = mBatch->recordCount; i < capacity; ++i) {
+                char* data = reinterpret_cast<char*>(&mBatch->records[i]);
+                if (!mFile.readRecord(mBatch->times[i], mBatch->timeRanges[i], data)) {
+                    break;
+                }
+            }
+        } catch (std::exception const& e) {
+            mFailed = true;
+            mError = e.what();
+        }
+    }
+
+private:
+    DbiteFile& mFile;
+    Batch* mBatch;
+    bool mFailed;
+    std::string mError;
+};
+
+/// Appends the converted sweeps of a batch to the output
+class WriteThread
+    : public QThread
+{
+public:
+    explicit WriteThread(FILE* file)
+        : mFile(file)
+        , mBatch(NULL)
+        , mBytes(0)
+        , mFailed(false)
+    {
+    }
+
+    void setBatch(Batch const* batch) { mBatch = batch; }
+    unsigned long long bytes() const { return mBytes; }
+    bool failed() const { return mFailed; }
+
+protected:
+    void run() /* override */
+    {
+        for (int i = 0; (i < mBatch->sweepCount) && !mFailed; ++i) {
+            std::vector<unsigned char> const& sweep = mBatch->sweeps[i];
+            mFailed = (fwrite(&sweep[0], 1, sweep.size(), mFile) != sweep.size());
+            mBytes += sweep.size();
+        }
+    }
+
+private:
+    FILE* mFile;
+    Batch const* mBatch;
+    unsigned long long mBytes;
+    bool mFailed;
+};
+
+int main(int argc, char** argv)
+{
+    string model = "hdl32";
+    string calibrationFile;
+    int azimuthBins = VelodyneConverter::kDefaultColumnCount;
+    int threads = QThread::idealThreadCount();
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i) {
+        string const arg = argv[i];
+        if ((arg.size() == 2) && (arg[0] == '-')) {
+            if (i + 1 >= argc) {
+                return usage();
+            }
+            char const* value = argv[++i];
+            switch (arg[1]) {
+            case 'm': model = value; break;
+            case 'c': calibrationFile = value; break;
+            case 'b': azimuthBins = atoi(value); break;
+            case 'j': threads = atoi(value); break;
+            default: return usage();
+            }
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if ((paths.size() != 2) || (azimuthBins <= 0) || (azimuthBins > VelodyneConverter::kMaxColumnCount)
+        || (threads <= 0)) {
+        return usage();
+    }
+
+    VelodyneConverter converter;
+    if (!converter.setModel(model)) {
+        fprintf(stderr, "unknown model '%s'\n", model.c_str());
+        return usage();
+    }
+    if (calibrationFile.empty()) {
+        converter.setDefaultCalibration();
+    } else if (!converter.calibration().load(calibrationFile)) {
+        fprintf(stderr, "cannot load calibration '%s'\n", calibrationFile.c_str());
+        return 1;
+    }
+    converter.setColumnCount(azimuthBins);
+
+    DbiteFile input;
+    try {
+        input.open(paths[0], DbiteFile::ReadMode);
+    } catch (std::exception const& e) {
+        fprintf(stderr, "cannot open '%s': %s\n", paths[0].c_str(), e.what());
+        return 1;
+    }
+    long long const recordSize = input.getRecordSize();
+    if (recordSize != static_cast<long long>(sizeof(VelodynePolarData))) {
+        fprintf(stderr, "'%s' holds records of %lld bytes, not VelodynePolarData (%lld bytes)\n",
+                paths[0].c_str(), recordSize, static_cast<long long>(sizeof(VelodynePolarData)));
+        return 1;
+    }
+
+    FILE* output = fopen(paths[1].c_str(), "wb");
+    if (!output) {
+        fprintf(stderr, "cannot create '%s'\n", paths[1].c_str());
+        return 1;
+    }
+    setvbuf(output, NULL, _IOFBF, kOutputBufferSize);
+    boost::uint32_t const header[2] = { kMagic, kVersion };
+    if (fwrite(header, sizeof(header), 1, output) != 1) {
+        fprintf(stderr, "cannot write '%s'\n", paths[1].c_str());
+        fclose(output);
+        return 1;
+    }
+
+    // the calling thread converts a chunk too
+    QThreadPool::globalInstance()->setMaxThreadCount(std::max(1, threads - 1));
+    int const batchSize = threads * kRevolutionsPerWorker;
+    Batch batches[2];
+    for (int b = 0; b < 2; ++b) {
+        batches[b].recordCount = 0;
+        batches[b].records.resize(batchSize);
+        batches[b].times.resize(batchSize);
+        batches[b].timeRanges.resize(batchSize);
+        batches[b].sweepCount = 0;
+        batches[b].sweeps.resize(batchSize);
+    }
+    ConvertTask task(converter, threads);
+    ReadThread reader(input);
+    WriteThread writer(output);
+
+    QElapsedTimer timer;
+    timer.start();
+    long long revolutions = 0;
+    int current = 0;
+    reader.setBatch(&batches[current]);
+    reader.start();
+    for (;;) {
+        reader.wait();
+        Batch& batch = batches[current];
+        if (reader.failed() || (batch.recordCount == 0)) {
+            break;
+        }
+        // the next batch is read and the previous one written while this one is converted
+        reader.setBatch(&batches[1 - current]);
+        reader.start();
+        task.setBatch(&batch);
+        parallelFor(0, batch.recordCount, threads, task);
+        batch.sweepCount = batch.recordCount;
+        revolutions += batch.recordCount;
+
+        writer.wait();
+        if (writer.failed()) {
+            break;
+        }
+        writer.setBatch(&batch);
+        writer.start();
+        current = 1 - current;
+    }
+    reader.wait();
+    writer.wait();
+    input.close();
+    if (writer.failed() || (fclose(output) != 0)) {
+        fprintf(stderr, "cannot write '%s'\n", paths[1].c_str());
+        return 1;
+    }
+    if (reader.failed()) {
+        fprintf(stderr, "cannot read '%s': %s\n", paths[0].c_str(), reader.error().c_str());
+        return 1;
+    }
+
+    double const seconds = timer.nsecsElapsed() * 1e-9;
+    double const inputMiB = revolutions * recordSize / (1024.0 * 1024.0);
+    printf("revolutions=%lld points=%llu input=%.1f MiB output=%.1f MiB\n", revolutions, task.kept(),
+           inputMiB, writer.bytes() / (1024.0 * 1024.0));
+    printf("%.2f s, %.1f revolutions/s, %.1f MiB/s read, %d threads\n", seconds, revolutions / seconds,
+           inputMiB / seconds, threads);
+    return 0;
+}
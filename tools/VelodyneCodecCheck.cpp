@@ -0,0 +1,144 @@
+// %pacpus:license{
+// This file is part of the PACPUS framework distributed under the
+// CECILL-C License, Version 1.0.
+// %pacpus:license}
+/// @file
+/// @brief Round-trips a recorded Velodyne DBT file through VelodyneSweepCodec.
+///
+/// Usage:
+///     VelodyneCodecCheck <input.dbt> [revolutions]
+///
+/// Every record, or the first `revolutions` ones, is encoded then decoded,
+/// and the block count and every azimuth, distance and intensity of its
+/// valid blocks must come back unchanged. Prints the compression ratio
+/// against the fields the codec keeps (2 bytes of azimuth and 3 bytes per
+/// return), the one that counts, then against the valid blocks with their
+/// padding and against the whole record, and the coding times. Exits with 1 on the first revolution that does not
+/// round-trip.
+
+#include "../VelodyneSweepCodec.h"
+
+#include <Pacpus/kernel/DbiteFile.h>
+#include <Pacpus/kernel/road_time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <vector>
+#include <QElapsedTimer>
+
+using namespace pacpus;
+using namespace std;
+
+static int usage()
+{
+    fprintf(stderr, "usage: VelodyneCodecCheck <input.dbt> [revolutions]\n");
+    return 2;
+}
+
+/// @returns the first block of the valid ones that differs, -1 if none does
+static int firstMismatch(VelodynePolarData const& expected, VelodynePolarData const& actual, int blockCount)
+{
+    int const laserCount = sizeof(expected.polarData[0].rawPoints) / sizeof(expected.polarData[0].rawPoints[0]);
+    for (int i = 0; i < blockCount; ++i) {
+        VelodynePolarBlock const& e = expected.polarData[i];
+        VelodynePolarBlock const& a = actual.polarData[i];
+        if (e.angle != a.angle) {
+            return i;
+        }
+        for (int j = 0; j < laserCount; ++j) {
+            if ((e.rawPoints[j].distance != a.rawPoints[j].distance)
+                    || (e.rawPoints[j].intensity != a.rawPoints[j].intensity)) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    if ((argc < 2) || (argc > 3)) {
+        return usage();
+    }
+    long long const maxRevolutions = (argc == 3) ? atoll(argv[2]) : -1;
+
+    DbiteFile input;
+    try {
+        input.open(argv[1], DbiteFile::ReadMode);
+    } catch (std::exception const& e) {
+        fprintf(stderr, "cannot open '%s': %s\n", argv[1], e.what());
+        return 1;
+    }
+    if (input.getRecordSize() != static_cast<long long>(sizeof(VelodynePolarData))) {
+        fprintf(stderr, "'%s' holds records of %lld bytes, not VelodynePolarData (%lld bytes)\n", argv[1],
+                static_cast<long long>(input.getRecordSize()), static_cast<long long>(sizeof(VelodynePolarData)));
+        return 1;
+    }
+
+    // both revolutions are too large for the stack
+    vector<VelodynePolarData> revolutions(2);
+    VelodynePolarData& original = revolutions[0];
+    VelodynePolarData& decoded = revolutions[1];
+    int const capacity = sizeof(original.polarData) / sizeof(original.polarData[0]);
+    int const laserCount = sizeof(original.polarData[0].rawPoints) / sizeof(original.polarData[0].rawPoints[0]);
+
+    VelodyneSweepCodec codec;
+    vector<unsigned char> encoded;
+    long long count = 0;
+    unsigned long long blocks = 0, encodedBytes = 0;
+    qint64 encodeTime = 0, decodeTime = 0;
+    QElapsedTimer timer;
+    try {
+        road_time_t time;
+        road_timerange_t timeRange;
+        while ((count != maxRevolutions)
+               && input.readRecord(time, timeRange, reinterpret_cast<char*>(&original))) {
+            int const blockCount = (original.range < static_cast<unsigned long>(capacity))
+                    ? static_cast<int>(original.range) : capacity;
+
+            encoded.clear();
+            timer.start();
+            codec.encode(original, encoded);
+            encodeTime += timer.nsecsElapsed();
+
+            size_t consumed = 0;
+            timer.start();
+            bool const ok = codec.decode(&encoded[0], encoded.size(), decoded, &consumed);
+            decodeTime += timer.nsecsElapsed();
+
+            int const block = ok ? firstMismatch(original, decoded, blockCount) : -1;
+            if (!ok || (consumed != encoded.size()) || (decoded.range != original.range) || (block >= 0)) {
+                fprintf(stderr, "revolution %lld (time %llu) does not round-trip", count,
+                        static_cast<unsigned long long>(time));
+                if (block >= 0) {
+                    fprintf(stderr, ": block %d differs", block);
+                }
+                fprintf(stderr, "\n");
+                return 1;
+            }
+            ++count;
+            blocks += blockCount;
+            encodedBytes += encoded.size();
+        }
+    } catch (std::exception const& e) {
+        fprintf(stderr, "cannot read '%s': %s\n", argv[1], e.what());
+        return 1;
+    }
+    input.close();
+
+    if ((count == 0) || (encodedBytes == 0)) {
+        printf("no revolution\n");
+        return 0;
+    }
+    double const validBytes = static_cast<double>(blocks) * sizeof(VelodynePolarBlock);
+    double const fieldBytes = static_cast<double>(blocks) * (2 + 3 * laserCount);
+    double const recordBytes = static_cast<double>(count) * sizeof(VelodynePolarData);
+    printf("revolutions=%lld blocks/revolution=%.0f encoded=%.1f KiB/revolution, all round-trip\n", count,
+           static_cast<double>(blocks) / count, encodedBytes / 1024.0 / count);
+    printf("ratio %.2f to the packed fields\n", fieldBytes / encodedBytes);
+    printf("(%.2f to the valid blocks, %.2f to the records)\n", validBytes / encodedBytes, recordBytes / encodedBytes);
+    printf("encode %.2f ms, decode %.2f ms per revolution\n", encodeTime * 1e-6 / count, decodeTime * 1e-6 / count);
+    return 0;
+}